@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include "growth_policy.h"
+#include "simple_vector.h"
+
+// Allocator whose buffers start on an Alignment boundary: 64 for cache lines
+// and AVX-512, 4096 for pages, 2 MiB for huge pages. SimpleVector allocates
+// every buffer through it, so the alignment survives Reserve, Resize and
+// growth, and move and swap only ever hand the buffer over. kAlignment tells
+// SimpleVector::Data() how far the pointer may be assumed aligned.
+template <typename Type, size_t Alignment = 64>
+class AlignedAllocator {
+public:
+    static_assert(Alignment >= alignof(Type) && (Alignment & (Alignment - 1)) == 0,
+                  "alignment must be a power of two no smaller than the element's");
+
+    using value_type = Type;
+
+    static constexpr size_t kAlignment = Alignment;
+
+    template <typename Other>
+    struct rebind {
+        using other = AlignedAllocator<Other, Alignment>;
+    };
+
+    AlignedAllocator() noexcept = default;
+
+    template <typename Other>
+    AlignedAllocator(const AlignedAllocator<Other, Alignment>&) noexcept {}
+
+    Type* allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(Type)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<Type*>(::operator new(n * sizeof(Type), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(Type* ptr, size_t n) noexcept {
+        ::operator delete(ptr, n * sizeof(Type), std::align_val_t(Alignment));
+    }
+
+    template <typename Other>
+    bool operator==(const AlignedAllocator<Other, Alignment>&) const noexcept {
+        return true;
+    }
+
+    template <typename Other>
+    bool operator!=(const AlignedAllocator<Other, Alignment>&) const noexcept {
+        return false;
+    }
+};
+
+template <typename Type, size_t Alignment = 64, typename Growth = DoublingGrowth>
+using AlignedSimpleVector = SimpleVector<Type, AlignedAllocator<Type, Alignment>, Growth>;
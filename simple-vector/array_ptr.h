@@ -1,44 +1,204 @@
+#pragma once
+
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
+#include "instrumentation.h"
+
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#include <sys/mman.h>
+#include <unistd.h>
+#define ARRAY_PTR_HAS_MADVISE 1
+#endif
+
+template <typename Alloc, typename Type, typename = void>
+struct AllocatorHasConstruct : std::false_type {};
+
+template <typename Alloc, typename Type>
+struct AllocatorHasConstruct<Alloc, Type, std::void_t<decltype(std::declval<Alloc&>().construct(
+                                              std::declval<Type*>(), std::declval<const Type&>()))>>
+    : std::true_type {};
+
+// Allocators may offer reallocate(ptr, old_size, new_size) that resizes a
+// buffer keeping its bytes (see MallocAllocator)
+template <typename Alloc, typename Type, typename = void>
+struct AllocatorHasReallocate : std::false_type {};
+
+template <typename Alloc, typename Type>
+struct AllocatorHasReallocate<Alloc, Type, std::void_t<decltype(std::declval<Alloc&>().reallocate(
+                                               std::declval<Type*>(), size_t{}, size_t{}))>>
+    : std::true_type {};
+
+// Types whose objects may be moved to a new address with memcpy, the old
+// bytes then simply dropped instead of destroyed. Trivially copyable types
+// are; specialize it for types that merely own heap memory or handles.
+// Types that point into themselves or hand out their own address are not,
+// e.g. libstdc++'s std::string, whose short strings point into the object.
+template <typename Type, typename = void>
+struct IsTriviallyRelocatable : std::is_trivially_copyable<Type> {};
 
 template <typename Type>
+struct IsTriviallyRelocatable<std::allocator<Type>> : std::true_type {};
+
+template <typename Type, typename Deleter>
+struct IsTriviallyRelocatable<std::unique_ptr<Type, Deleter>> : IsTriviallyRelocatable<Deleter> {};
+
+template <typename Type>
+struct IsTriviallyRelocatable<std::default_delete<Type>> : std::true_type {};
+
+template <typename Type>
+struct IsTriviallyRelocatable<std::shared_ptr<Type>> : std::true_type {};
+
+template <typename Type>
+struct IsTriviallyRelocatable<std::weak_ptr<Type>> : std::true_type {};
+
+// Alignment the allocator guarantees for its buffers: Alloc::kAlignment if it
+// declares one (see AlignedAllocator), otherwise just alignof(Type)
+template <typename Alloc, typename Type, typename = void>
+struct AllocatorAlignment : std::integral_constant<size_t, alignof(Type)> {};
+
+template <typename Alloc, typename Type>
+struct AllocatorAlignment<Alloc, Type, std::void_t<decltype(Alloc::kAlignment)>>
+    : std::integral_constant<size_t, Alloc::kAlignment> {};
+
+// ptr, promising the optimizer that it is a multiple of Alignment (which a
+// null pointer trivially is)
+template <size_t Alignment, typename Type>
+Type* AssumeAligned(Type* ptr) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<Type*>(__builtin_assume_aligned(ptr, Alignment));
+#elif defined(__cpp_lib_assume_aligned)
+    return ptr ? std::assume_aligned<Alignment>(ptr) : ptr;
+#else
+    return ptr;
+#endif
+}
+
+// Owns raw storage for `size` elements of Type obtained from Alloc. The
+// elements themselves are not constructed or destroyed automatically: the
+// owner (SimpleVector) constructs them in place through Construct() when they
+// become live and destroys them with Destroy() before the storage is freed.
+template <typename Type, typename Alloc = std::allocator<Type>>
 class ArrayPtr {
 public:
+    using AllocatorType = Alloc;
+    using AllocTraits = std::allocator_traits<Alloc>;
+
+    static_assert(std::is_same_v<typename AllocTraits::value_type, Type>,
+                  "Alloc::value_type must be the element type");
+    static_assert(std::is_same_v<typename AllocTraits::pointer, Type*>,
+                  "ArrayPtr requires an allocator with raw pointers");
+
+    // Element construction may bypass the allocator (memcpy) only when the
+    // allocator does not customize construct()
+    static constexpr bool kDefaultConstruct =
+        std::is_same_v<Alloc, std::allocator<Type>> || !AllocatorHasConstruct<Alloc, Type>::value;
+
+    // True when copying [first, last) of InputIt into raw storage may be done with memcpy
+    template <typename InputIt>
+    static constexpr bool kCopiesAsBytes =
+        kDefaultConstruct && std::is_trivially_copyable_v<Type> && std::is_trivially_copy_constructible_v<Type> &&
+        std::is_pointer_v<InputIt> && std::is_same_v<std::remove_cv_t<std::remove_pointer_t<InputIt>>, Type>;
+
+    // Elements may be moved around (and out of the way) with memcpy/memmove
+    static constexpr bool kMovesAsBytes =
+        kDefaultConstruct && std::is_trivially_copyable_v<Type> && std::is_trivially_move_constructible_v<Type>;
+
+    // Elements may be relocated with memcpy/memmove: moved to raw storage
+    // without running the move constructor or the destructor of the source
+    static constexpr bool kRelocatesAsBytes = kDefaultConstruct && IsTriviallyRelocatable<Type>::value;
+
+    // Moving elements between buffers copies them instead, as with
+    // std::move_if_noexcept: a move that throws halfway would leave elements
+    // behind in both buffers, while a failed copy leaves the source intact
+    static constexpr bool kMoveIfNoexceptCopies =
+        !std::is_nothrow_move_constructible_v<Type> && std::is_copy_constructible_v<Type>;
+
+    // Storage may grow through Alloc::reallocate instead of allocate + copy
+    static constexpr bool kCanRealloc = kRelocatesAsBytes && AllocatorHasReallocate<Alloc, Type>::value;
+
     ArrayPtr() = default;
 
-    explicit ArrayPtr(size_t size) {
-        raw_ptr_ = size ? new Type[size] : nullptr;
+    explicit ArrayPtr(const Alloc& alloc) noexcept : alloc_(alloc) {}
+
+    explicit ArrayPtr(size_t size, const Alloc& alloc = Alloc()) : alloc_(alloc) {
+        if (size) {
+            if (size > AllocTraits::max_size(alloc_)) {
+                throw std::length_error("ArrayPtr: size exceeds allocator max_size");
+            }
+            raw_ptr_ = AllocTraits::allocate(alloc_, size);
+            size_ = size;
+            SIMPLE_VECTOR_COUNT_ALLOCATION(size * sizeof(Type));
+        }
     }
 
-    explicit ArrayPtr(Type* raw_ptr) noexcept : raw_ptr_(raw_ptr) {}
+    // raw_ptr must have been allocated by alloc for exactly size elements
+    ArrayPtr(Type* raw_ptr, size_t size, const Alloc& alloc = Alloc()) noexcept
+        : alloc_(alloc), raw_ptr_(raw_ptr), size_(size) {}
 
     ArrayPtr(const ArrayPtr&) = delete;
 
-    ArrayPtr(ArrayPtr&& other) noexcept : raw_ptr_(other.raw_ptr_) {
-        other.raw_ptr_ = nullptr;
-    }
+    ArrayPtr(ArrayPtr&& other) noexcept
+        : alloc_(other.alloc_),
+          raw_ptr_(std::exchange(other.raw_ptr_, nullptr)),
+          size_(std::exchange(other.size_, 0)) {}
 
     ~ArrayPtr() {
-        delete[] raw_ptr_;
-        raw_ptr_ = nullptr;
+        Deallocate();
     }
 
     ArrayPtr& operator=(const ArrayPtr&) = delete;
 
+    // Takes over the allocator together with the storage; SimpleVector decides
+    // whether that is allowed by the allocator propagation traits.
     ArrayPtr& operator=(ArrayPtr&& other) noexcept {
         if (this != &other) {
-            delete[] raw_ptr_;
-            raw_ptr_ = other.raw_ptr_;
-            other.raw_ptr_ = nullptr;
+            Deallocate();
+            alloc_ = other.alloc_;
+            raw_ptr_ = std::exchange(other.raw_ptr_, nullptr);
+            size_ = std::exchange(other.size_, 0);
         }
         return *this;
     }
 
+    // Frees the storage, keeping the allocator
+    void Reset() noexcept {
+        Deallocate();
+    }
+
+    // Hands the whole pages inside [Get() + from, Get() + GetSize()) back to
+    // the OS without giving up the address range; they read as zeros when
+    // touched again. No element may live in that range. Returns the number
+    // of bytes released (0 where madvise is unavailable).
+    size_t ReleasePages(size_t from) noexcept {
+#ifdef ARRAY_PTR_HAS_MADVISE
+        if (!raw_ptr_ || from >= size_) {
+            return 0;
+        }
+        const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t first = reinterpret_cast<uintptr_t>(raw_ptr_ + from);
+        uintptr_t last = reinterpret_cast<uintptr_t>(raw_ptr_ + size_);
+        first = (first + page_size - 1) & ~(page_size - 1);
+        last &= ~(page_size - 1);
+        if (first >= last || madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED) != 0) {
+            return 0;
+        }
+        return last - first;
+#else
+        (void)from;
+        return 0;
+#endif
+    }
+
     [[nodiscard]] Type* Release() noexcept {
-        Type* ptr = raw_ptr_;
-        raw_ptr_ = nullptr;
-        return ptr;
+        size_ = 0;
+        return std::exchange(raw_ptr_, nullptr);
     }
 
     Type& operator[](size_t index) noexcept {
@@ -57,10 +217,161 @@ public:
         return raw_ptr_;
     }
 
+    size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    Alloc& GetAllocator() noexcept {
+        return alloc_;
+    }
+
+    const Alloc& GetAllocator() const noexcept {
+        return alloc_;
+    }
+
+    template <typename... Args>
+    void Construct(Type* ptr, Args&&... args) {
+        AllocTraits::construct(alloc_, ptr, std::forward<Args>(args)...);
+    }
+
+    void Destroy(Type* ptr) noexcept {
+        AllocTraits::destroy(alloc_, ptr);
+    }
+
+    void Destroy(Type* first, Type* last) noexcept {
+        for (; first != last; ++first) {
+            AllocTraits::destroy(alloc_, first);
+        }
+    }
+
+    // The Uninitialized* helpers construct into raw storage and destroy
+    // everything they have built if a constructor throws.
+    template <typename InputIt>
+    Type* UninitializedCopy(InputIt first, InputIt last, Type* dest) {
+        if constexpr (kCopiesAsBytes<InputIt>) {
+            size_t count = last - first;
+            if (count) {
+                std::memcpy(dest, first, count * sizeof(Type));
+            }
+            return dest + count;
+        }
+        Type* current = dest;
+        try {
+            for (; first != last; ++first, ++current) {
+                Construct(current, *first);
+            }
+        } catch (...) {
+            Destroy(dest, current);
+            throw;
+        }
+        return current;
+    }
+
+    Type* UninitializedMove(Type* first, Type* last, Type* dest) {
+        if constexpr (kMovesAsBytes) {
+            MoveBytes(dest, first, last - first);
+            return dest + (last - first);
+        }
+        return UninitializedCopy(std::make_move_iterator(first), std::make_move_iterator(last), dest);
+    }
+
+    // UninitializedMove, or UninitializedCopy when kMoveIfNoexceptCopies
+    Type* UninitializedMoveIfNoexcept(Type* first, Type* last, Type* dest) {
+        if constexpr (kMoveIfNoexceptCopies) {
+            return UninitializedCopy(static_cast<const Type*>(first), static_cast<const Type*>(last), dest);
+        }
+        return UninitializedMove(first, last, dest);
+    }
+
+    // Moves [first, last) into raw storage at dest and ends the lifetime of
+    // the source elements. If a constructor throws, the source is intact
+    // (unless Type can only be moved, and throwingly) and whatever was built
+    // at dest is destroyed.
+    Type* UninitializedRelocate(Type* first, Type* last, Type* dest) {
+        if constexpr (kRelocatesAsBytes) {
+            MoveBytes(dest, first, last - first);
+            return dest + (last - first);
+        }
+        Type* dest_end = UninitializedMoveIfNoexcept(first, last, dest);
+        Destroy(first, last);
+        return dest_end;
+    }
+
+    // memmove of `count` elements; ranges may overlap. Only for
+    // kRelocatesAsBytes: afterwards the source slots count as raw storage.
+    static void MoveBytes(Type* dest, const Type* src, size_t count) noexcept {
+        static_assert(kMovesAsBytes || kRelocatesAsBytes);
+        if (count) {
+            std::memmove(static_cast<void*>(dest), static_cast<const void*>(src), count * sizeof(Type));
+        }
+    }
+
+    // Resizes the storage keeping its bytes; the allocator may extend the
+    // buffer in place or remap it without copying. Only for kCanRealloc.
+    void Realloc(size_t new_size) {
+        static_assert(kCanRealloc);
+        if (new_size == 0) {
+            Deallocate();
+            return;
+        }
+        if (new_size > AllocTraits::max_size(alloc_)) {
+            throw std::length_error("ArrayPtr: size exceeds allocator max_size");
+        }
+        raw_ptr_ = raw_ptr_ ? alloc_.reallocate(raw_ptr_, size_, new_size) : AllocTraits::allocate(alloc_, new_size);
+        size_ = new_size;
+        SIMPLE_VECTOR_COUNT_ALLOCATION(new_size * sizeof(Type));
+    }
+
+    Type* UninitializedFill(Type* dest, size_t count, const Type& value) {
+        if constexpr (kDefaultConstruct && std::is_trivially_copy_constructible_v<Type>) {
+            return std::uninitialized_fill_n(dest, count, value);
+        }
+        Type* current = dest;
+        try {
+            for (; count > 0; --count, ++current) {
+                Construct(current, value);
+            }
+        } catch (...) {
+            Destroy(dest, current);
+            throw;
+        }
+        return current;
+    }
+
+    Type* UninitializedValueConstruct(Type* dest, size_t count) {
+        if constexpr (kDefaultConstruct && std::is_trivially_default_constructible_v<Type>) {
+            // lowers to memset for trivial types
+            return std::uninitialized_value_construct_n(dest, count);
+        }
+        Type* current = dest;
+        try {
+            for (; count > 0; --count, ++current) {
+                Construct(current);
+            }
+        } catch (...) {
+            Destroy(dest, current);
+            throw;
+        }
+        return current;
+    }
+
     void swap(ArrayPtr& other) noexcept {
-        std::swap(raw_ptr_, other.raw_ptr_);
+        using std::swap;
+        swap(alloc_, other.alloc_);
+        swap(raw_ptr_, other.raw_ptr_);
+        swap(size_, other.size_);
     }
 
 private:
+    void Deallocate() noexcept {
+        if (raw_ptr_) {
+            AllocTraits::deallocate(alloc_, raw_ptr_, size_);
+        }
+        raw_ptr_ = nullptr;
+        size_ = 0;
+    }
+
+    Alloc alloc_;
     Type* raw_ptr_ = nullptr;
-};
\ No newline at end of file
+    size_t size_ = 0;
+};
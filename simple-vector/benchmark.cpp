@@ -0,0 +1,824 @@
+// Benchmark suite: SimpleVector operations against std::vector as the baseline.
+// Build with optimizations and Google Benchmark:
+//     g++ -std=c++17 -O2 -DNDEBUG benchmark.cpp -lbenchmark -lpthread -o simple_vector_benchmark
+// JSON for regression tracking:
+//     ./simple_vector_benchmark --benchmark_out=results.json --benchmark_out_format=json
+
+#include "simple_vector.h"
+#include "malloc_allocator.h"
+#include "aligned_allocator.h"
+#include "concurrent_simple_vector.h"
+#include "chunked_simple_vector.h"
+#include "soa_simple_vector.h"
+#include "cow_simple_vector.h"
+#include "pool_allocator.h"
+#include "sorted_simple_vector.h"
+#include "channel.h"
+#include "vector_expression.h"
+
+#include <benchmark/benchmark.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Defining construct() makes ArrayPtr treat the allocator as customized, so
+// SimpleVector takes the generic element-wise paths even for trivial types
+template <typename Type>
+struct GenericPathAllocator : allocator<Type> {
+    template <typename Other>
+    struct rebind {
+        using other = GenericPathAllocator<Other>;
+    };
+
+    GenericPathAllocator() = default;
+    template <typename Other>
+    GenericPathAllocator(const GenericPathAllocator<Other>&) noexcept {
+    }
+
+    template <typename Other, typename... Args>
+    void construct(Other* ptr, Args&&... args) {
+        ::new (static_cast<void*>(ptr)) Other(forward<Args>(args)...);
+    }
+};
+
+struct Pod64 {
+    uint64_t fields[8];
+};
+
+inline bool operator==(const Pod64& lhs, const Pod64& rhs) {
+    return equal(begin(lhs.fields), end(lhs.fields), begin(rhs.fields));
+}
+
+inline bool operator<(const Pod64& lhs, const Pod64& rhs) {
+    return lexicographical_compare(begin(lhs.fields), end(lhs.fields), begin(rhs.fields), end(rhs.fields));
+}
+
+// The move-only type from the functional tests
+class X {
+public:
+    X()
+        : X(5) {
+    }
+    X(size_t num)
+        : x_(num) {
+    }
+    X(const X& other) = delete;
+    X& operator=(const X& other) = delete;
+    X(X&& other) {
+        x_ = exchange(other.x_, 0);
+    }
+    X& operator=(X&& other) {
+        x_ = exchange(other.x_, 0);
+        return *this;
+    }
+    size_t GetX() const {
+        return x_;
+    }
+
+private:
+    size_t x_;
+};
+
+// A heap string whose move constructor is not noexcept, so growth has to
+// copy it to keep the strong exception guarantee
+struct ThrowingMove {
+    explicit ThrowingMove(size_t i)
+        : value(32, 'a' + static_cast<char>(i % 26)) {}
+
+    ThrowingMove(const ThrowingMove&) = default;
+    ThrowingMove(ThrowingMove&& other) noexcept(false)
+        : value(std::move(other.value)) {}
+    ThrowingMove& operator=(const ThrowingMove&) = default;
+    ThrowingMove& operator=(ThrowingMove&&) = default;
+
+    string value;
+};
+
+template <typename Type>
+Type MakeValue(size_t i) {
+    if constexpr (is_same_v<Type, Pod64>) {
+        return Pod64{{i, i + 1, i + 2, i + 3, i + 4, i + 5, i + 6, i + 7}};
+    } else if constexpr (is_same_v<Type, string>) {
+        // long enough to live on the heap
+        return string(32, 'a' + static_cast<char>(i % 26));
+    } else if constexpr (is_same_v<Type, unique_ptr<size_t>>) {
+        return make_unique<size_t>(i);
+    } else {
+        return Type(i);
+    }
+}
+
+template <typename Type>
+size_t Touch(const Type& value) {
+    if constexpr (is_same_v<Type, Pod64>) {
+        return value.fields[0];
+    } else if constexpr (is_same_v<Type, string>) {
+        return value.size();
+    } else if constexpr (is_same_v<Type, X>) {
+        return value.GetX();
+    } else if constexpr (is_same_v<Type, unique_ptr<size_t>>) {
+        return *value;
+    } else if constexpr (is_same_v<Type, ThrowingMove>) {
+        return value.value.size();
+    } else {
+        return static_cast<size_t>(value);
+    }
+}
+
+template <typename Type, typename = void>
+struct IsComparable : false_type {};
+
+template <typename Type>
+struct IsComparable<Type, void_t<decltype(declval<const Type&>() == declval<const Type&>()),
+                                 decltype(declval<const Type&>() < declval<const Type&>())>> : true_type {};
+
+// Uniform access to SimpleVector and std::vector
+template <typename Vector>
+struct VectorOps;
+
+template <typename Type, typename Alloc, typename Growth>
+struct VectorOps<SimpleVector<Type, Alloc, Growth>> {
+    using Vector = SimpleVector<Type, Alloc, Growth>;
+    static void PushBack(Vector& v, Type value) {
+        v.PushBack(move(value));
+    }
+    static void Reserve(Vector& v, size_t n) {
+        v.Reserve(n);
+    }
+    static void Resize(Vector& v, size_t n) {
+        v.Resize(n);
+    }
+    static void Insert(Vector& v, size_t pos, Type value) {
+        v.Insert(v.begin() + pos, move(value));
+    }
+    static void Erase(Vector& v, size_t pos) {
+        v.Erase(v.begin() + pos);
+    }
+    template <typename Predicate>
+    static size_t EraseIf(Vector& v, Predicate pred) {
+        return ::EraseIf(v, pred);
+    }
+    static size_t Size(const Vector& v) {
+        return v.GetSize();
+    }
+};
+
+// Same surface as SimpleVector
+template <typename Type, typename Alloc, size_t BlockSize>
+struct VectorOps<ChunkedSimpleVector<Type, Alloc, BlockSize>> {
+    using Vector = ChunkedSimpleVector<Type, Alloc, BlockSize>;
+    static void PushBack(Vector& v, Type value) {
+        v.PushBack(move(value));
+    }
+    static void Reserve(Vector& v, size_t n) {
+        v.Reserve(n);
+    }
+    static void Resize(Vector& v, size_t n) {
+        v.Resize(n);
+    }
+    static void Insert(Vector& v, size_t pos, Type value) {
+        v.Insert(v.begin() + pos, move(value));
+    }
+    static void Erase(Vector& v, size_t pos) {
+        v.Erase(v.begin() + pos);
+    }
+    template <typename Predicate>
+    static size_t EraseIf(Vector& v, Predicate pred) {
+        return ::EraseIf(v, pred);
+    }
+    static size_t Size(const Vector& v) {
+        return v.GetSize();
+    }
+};
+
+template <typename Type, typename Alloc>
+struct VectorOps<vector<Type, Alloc>> {
+    using Vector = vector<Type, Alloc>;
+    static void PushBack(Vector& v, Type value) {
+        v.push_back(move(value));
+    }
+    static void Reserve(Vector& v, size_t n) {
+        v.reserve(n);
+    }
+    static void Resize(Vector& v, size_t n) {
+        v.resize(n);
+    }
+    static void Insert(Vector& v, size_t pos, Type value) {
+        v.insert(v.begin() + pos, move(value));
+    }
+    static void Erase(Vector& v, size_t pos) {
+        v.erase(v.begin() + pos);
+    }
+    template <typename Predicate>
+    static size_t EraseIf(Vector& v, Predicate pred) {
+        auto new_end = remove_if(v.begin(), v.end(), pred);
+        size_t removed = v.end() - new_end;
+        v.erase(new_end, v.end());
+        return removed;
+    }
+    static size_t Size(const Vector& v) {
+        return v.size();
+    }
+};
+
+template <typename Vector>
+using ValueOf = remove_cv_t<remove_reference_t<decltype(*declval<Vector&>().begin())>>;
+
+template <typename Vector>
+Vector MakeVector(size_t size) {
+    using Ops = VectorOps<Vector>;
+    Vector v;
+    Ops::Reserve(v, size);
+    for (size_t i = 0; i < size; ++i) {
+        Ops::PushBack(v, MakeValue<ValueOf<Vector>>(i));
+    }
+    return v;
+}
+
+template <typename Vector>
+void BM_PushBack(benchmark::State& state) {
+    using Ops = VectorOps<Vector>;
+    const size_t size = state.range(0);
+    for (auto _ : state) {
+        Vector v;
+        for (size_t i = 0; i < size; ++i) {
+            Ops::PushBack(v, MakeValue<ValueOf<Vector>>(i));
+        }
+        benchmark::DoNotOptimize(v.begin());
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+template <typename Vector>
+void BM_PushBackReserved(benchmark::State& state) {
+    using Ops = VectorOps<Vector>;
+    const size_t size = state.range(0);
+    for (auto _ : state) {
+        Vector v;
+        Ops::Reserve(v, size);
+        for (size_t i = 0; i < size; ++i) {
+            Ops::PushBack(v, MakeValue<ValueOf<Vector>>(i));
+        }
+        benchmark::DoNotOptimize(v.begin());
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+enum class Position { kFront, kMiddle, kBack };
+
+inline size_t PositionIndex(Position position, size_t size) {
+    switch (position) {
+        case Position::kFront:
+            return 0;
+        case Position::kMiddle:
+            return size / 2;
+        default:
+            return size;
+    }
+}
+
+// One insertion per iteration; the vector is rebuilt (untimed) every
+// `size` insertions, so its size stays within [size, 2 * size]
+template <typename Vector, Position position>
+void BM_Insert(benchmark::State& state) {
+    using Ops = VectorOps<Vector>;
+    const size_t size = state.range(0);
+    Vector v = MakeVector<Vector>(size);
+    size_t inserted = 0;
+    for (auto _ : state) {
+        Ops::Insert(v, PositionIndex(position, Ops::Size(v)), MakeValue<ValueOf<Vector>>(inserted));
+        if (++inserted == size) {
+            state.PauseTiming();
+            v = MakeVector<Vector>(size);
+            inserted = 0;
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// One erasure per iteration from a vector whose size stays within (size, 2 * size]
+template <typename Vector, Position position>
+void BM_Erase(benchmark::State& state) {
+    using Ops = VectorOps<Vector>;
+    const size_t size = state.range(0);
+    Vector v = MakeVector<Vector>(2 * size);
+    for (auto _ : state) {
+        size_t current = Ops::Size(v);
+        Ops::Erase(v, min(PositionIndex(position, current), current - 1));
+        if (current - 1 == size) {
+            state.PauseTiming();
+            v = MakeVector<Vector>(2 * size);
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Drops every other element of a fresh vector in one pass
+template <typename Vector>
+void BM_EraseIf(benchmark::State& state) {
+    using Ops = VectorOps<Vector>;
+    const size_t size = state.range(0);
+    for (auto _ : state) {
+        state.PauseTiming();
+        Vector v = MakeVector<Vector>(size);
+        state.ResumeTiming();
+        size_t removed = Ops::EraseIf(v, [](const auto& item) {
+            return Touch(item) % 2 == 0;
+        });
+        benchmark::DoNotOptimize(removed);
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+template <typename Vector>
+void BM_Resize(benchmark::State& state) {
+    using Ops = VectorOps<Vector>;
+    const size_t size = state.range(0);
+    for (auto _ : state) {
+        Vector v;
+        Ops::Resize(v, size / 2);
+        Ops::Resize(v, size);
+        benchmark::DoNotOptimize(v.begin());
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+// GenerateVector from the functional tests
+template <typename Vector>
+void BM_Generate(benchmark::State& state) {
+    const size_t size = state.range(0);
+    for (auto _ : state) {
+        Vector v(size);
+        iota(v.begin(), v.end(), 1);
+        benchmark::DoNotOptimize(v.begin());
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+template <typename Vector>
+void BM_CopyConstruct(benchmark::State& state) {
+    const Vector source = MakeVector<Vector>(state.range(0));
+    for (auto _ : state) {
+        Vector copy(source);
+        benchmark::DoNotOptimize(copy.begin());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename Vector>
+void BM_MoveConstruct(benchmark::State& state) {
+    Vector source = MakeVector<Vector>(state.range(0));
+    for (auto _ : state) {
+        Vector moved(move(source));
+        benchmark::DoNotOptimize(moved.begin());
+        source = move(moved);
+    }
+}
+
+template <typename Vector>
+void BM_Iterate(benchmark::State& state) {
+    const Vector v = MakeVector<Vector>(state.range(0));
+    for (auto _ : state) {
+        size_t sum = 0;
+        for (const auto& item : v) {
+            sum += Touch(item);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename Vector>
+void BM_Equal(benchmark::State& state) {
+    const Vector lhs = MakeVector<Vector>(state.range(0));
+    const Vector rhs = lhs;
+    for (auto _ : state) {
+        bool equal = lhs == rhs;
+        benchmark::DoNotOptimize(equal);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename Vector>
+void BM_Less(benchmark::State& state) {
+    const Vector lhs = MakeVector<Vector>(state.range(0));
+    const Vector rhs = lhs;
+    for (auto _ : state) {
+        bool less = lhs < rhs;
+        benchmark::DoNotOptimize(less);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+const vector<int64_t> kSizes = {16, 1024, 65536};
+
+// Many producers appending to one vector: a mutex around SimpleVector
+// against the lock-free ConcurrentSimpleVector
+struct LockedAppend {
+    void Append(int value) {
+        std::lock_guard lock(mutex);
+        items.PushBack(value);
+    }
+
+    std::mutex mutex;
+    SimpleVector<int> items;
+};
+
+struct ConcurrentAppend {
+    void Append(int value) {
+        items.PushBack(value);
+    }
+
+    ConcurrentSimpleVector<int> items;
+};
+
+template <typename Sink>
+void BM_ConcurrentAppend(benchmark::State& state) {
+    static Sink* sink = nullptr;
+    if (state.thread_index() == 0) {
+        sink = new Sink;
+    }
+    int value = 0;
+    for (auto _ : state) {
+        sink->Append(++value);
+    }
+    if (state.thread_index() == 0) {
+        delete sink;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// One read-mostly vector handed to 100 tasks that each read an element:
+// deep copies against copy-on-write sharing. The Mutate variant has every
+// task write to its copy, which makes the COW copies detach.
+template <typename Vector, bool Mutate>
+void BM_FanOut(benchmark::State& state) {
+    using Type = ValueOf<Vector>;
+    const Vector source(MakeVector<SimpleVector<Type>>(state.range(0)));
+    constexpr size_t kTasks = 100;
+    for (auto _ : state) {
+        vector<Vector> tasks(kTasks, source);
+        size_t sum = 0;
+        for (size_t task = 0; task < kTasks; ++task) {
+            if constexpr (Mutate) {
+                tasks[task][0] = MakeValue<Type>(task);
+            }
+            sum += Touch(as_const(tasks[task])[task % source.GetSize()]);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * kTasks);
+}
+
+// A request handler's temporary: a fresh vector filled with size elements
+// and dropped. "allocations" counts the buffers the vector asked its
+// allocator for, "global_allocations" those that reached operator new.
+template <typename Vector>
+void BM_ShortLived(benchmark::State& state) {
+    using Type = ValueOf<Vector>;
+    const size_t size = state.range(0);
+    BufferPool& pool = BufferPool::Local();
+    pool.ResetStats();
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        Vector v;
+        size_t capacity = 0;
+        for (size_t i = 0; i < size; ++i) {
+            v.PushBack(MakeValue<Type>(i));
+            if (v.GetCapacity() != capacity) {
+                capacity = v.GetCapacity();
+                ++allocations;
+            }
+        }
+        benchmark::DoNotOptimize(v.begin());
+    }
+    const bool pooled = is_same_v<typename Vector::AllocatorType, PoolAllocator<Type>>;
+    const double iterations = static_cast<double>(state.iterations());
+    state.counters["allocations"] = allocations / iterations;
+    state.counters["global_allocations"] = (pooled ? pool.GetStats().misses : allocations) / iterations;
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+// Lookups of random keys in a table of the even numbers below 2 * size,
+// with the plain binary search or the Eytzinger index
+template <bool Indexed>
+void BM_SortedLookup(benchmark::State& state) {
+    const size_t size = state.range(0);
+    SimpleVector<uint32_t> keys;
+    for (size_t i = 0; i < size; ++i) {
+        keys.PushBack(static_cast<uint32_t>(2 * i));
+    }
+    SortedSimpleVector<uint32_t> table(keys.begin(), keys.end());
+    if (Indexed) {
+        table.BuildSearchIndex();
+    }
+    uint32_t probe = 12345;
+    for (auto _ : state) {
+        probe = probe * 1664525 + 1013904223;
+        benchmark::DoNotOptimize(table.Contains(probe % (2 * size)));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Adding size / 4 random keys to a table of size keys: one InsertSorted per
+// key against a single MergeBulk
+template <bool Bulk>
+void BM_SortedAdd(benchmark::State& state) {
+    const size_t size = state.range(0);
+    SimpleVector<uint32_t> keys;
+    SimpleVector<uint32_t> batch;
+    uint32_t random = 1;
+    for (size_t i = 0; i < size + size / 4; ++i) {
+        random = random * 1664525 + 1013904223;
+        (i < size ? keys : batch).PushBack(random);
+    }
+    const SortedSimpleVector<uint32_t> source(keys.begin(), keys.end());
+    for (auto _ : state) {
+        state.PauseTiming();
+        SortedSimpleVector<uint32_t> table = source;
+        state.ResumeTiming();
+        if (Bulk) {
+            table.MergeBulk(batch.begin(), batch.end());
+        } else {
+            for (uint32_t key : batch) {
+                table.InsertSorted(key);
+            }
+        }
+        benchmark::DoNotOptimize(table.begin());
+    }
+    state.SetItemsProcessed(state.iterations() * batch.GetSize());
+}
+
+// A pipeline stage handing batches of size ints to the next stage on another
+// thread: a mutex + condition variable queue with a fresh batch per hand-off
+// against BatchChannel, which recycles the drained batches
+struct LockedBatchQueue {
+    SimpleVector<int> TakeBatch() {
+        return {};
+    }
+
+    void Push(SimpleVector<int>&& batch) {
+        std::unique_lock lock(mutex);
+        not_full.wait(lock, [this] { return batches.size() < kCapacity; });
+        batches.push_back(std::move(batch));
+        not_empty.notify_one();
+    }
+
+    void Pop(SimpleVector<int>& batch) {
+        std::unique_lock lock(mutex);
+        not_empty.wait(lock, [this] { return !batches.empty(); });
+        batch = std::move(batches.front());
+        batches.pop_front();
+        not_full.notify_one();
+    }
+
+    void Recycle(SimpleVector<int>&&) {}
+
+    static constexpr size_t kCapacity = 8;
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    deque<SimpleVector<int>> batches;
+};
+
+struct RecyclingBatchChannel : BatchChannel<int, SpscRing> {
+    RecyclingBatchChannel()
+        : BatchChannel(8, 0) {}
+
+    void Pop(SimpleVector<int>& batch) {
+        BatchChannel::Pop(batch);
+    }
+};
+
+template <typename Queue>
+void BM_BatchHandoff(benchmark::State& state) {
+    const size_t size = state.range(0);
+    constexpr size_t kBatches = 256;
+    for (auto _ : state) {
+        Queue queue;
+        thread consumer([&queue] {
+            SimpleVector<int> batch;
+            int64_t sum = 0;
+            for (size_t b = 0; b < kBatches; ++b) {
+                queue.Pop(batch);
+                sum += batch[0];
+                queue.Recycle(std::move(batch));
+            }
+            benchmark::DoNotOptimize(sum);
+        });
+        for (size_t b = 0; b < kBatches; ++b) {
+            SimpleVector<int> batch = queue.TakeBatch();
+            for (size_t i = 0; i < size; ++i) {
+                batch.PushBack(static_cast<int>(i));
+            }
+            queue.Push(std::move(batch));
+        }
+        consumer.join();
+    }
+    state.SetItemsProcessed(state.iterations() * kBatches * size);
+}
+
+// a = b * c + d over doubles: a temporary per operator and a pass per
+// operator, against the fused expression and a hand-written loop
+enum class Arithmetic { kTemporaries, kExpression, kHandWritten };
+
+template <Arithmetic kind>
+void BM_MultiplyAdd(benchmark::State& state) {
+    const size_t size = state.range(0);
+    const SimpleVector<double> b(size, 1.5);
+    const SimpleVector<double> c(size, 2.0);
+    const SimpleVector<double> d(size, 0.25);
+    SimpleVector<double> a(size);
+    for (auto _ : state) {
+        if constexpr (kind == Arithmetic::kTemporaries) {
+            SimpleVector<double> product(size);
+            for (size_t i = 0; i < size; ++i) {
+                product[i] = b[i] * c[i];
+            }
+            SimpleVector<double> sum(size);
+            for (size_t i = 0; i < size; ++i) {
+                sum[i] = product[i] + d[i];
+            }
+            a = std::move(sum);
+        } else if constexpr (kind == Arithmetic::kExpression) {
+            using namespace vector_expression;
+            a = b * c + d;
+        } else {
+            for (size_t i = 0; i < size; ++i) {
+                a[i] = b[i] * c[i] + d[i];
+            }
+        }
+        benchmark::DoNotOptimize(a.begin());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+// A 12-field record of which the hot loop reads two: x += vx
+struct Particle {
+    float x, y, z, vx, vy, vz, ax, ay, az, mass, charge, age;
+};
+
+using SoaParticles = SoaSimpleVector<float, float, float, float, float, float, float, float, float, float, float, float>;
+
+void BM_ParticleStepAos(benchmark::State& state) {
+    SimpleVector<Particle> particles(state.range(0), Particle{0, 0, 0, 1, 1, 1, 0, 0, 0, 1, 0, 0});
+    for (auto _ : state) {
+        for (Particle& particle : particles) {
+            particle.x += particle.vx;
+        }
+        benchmark::DoNotOptimize(particles.begin());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_ParticleStepSoa(benchmark::State& state) {
+    SoaParticles particles(state.range(0));
+    for (float& vx : particles.Column<3>()) {
+        vx = 1;
+    }
+    for (auto _ : state) {
+        float* x = particles.Data<0>();
+        const float* vx = particles.Data<3>();
+        for (size_t i = 0, size = particles.GetSize(); i < size; ++i) {
+            x[i] += vx[i];
+        }
+        benchmark::DoNotOptimize(particles.Data<0>());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename Function>
+void Register(const string& name, Function function) {
+    auto* benchmark = benchmark::RegisterBenchmark(name.c_str(), function);
+    for (int64_t size : kSizes) {
+        benchmark->Arg(size);
+    }
+}
+
+// Registers every operation for one container type under names like
+// "SimpleVector<int>/PushBack/1024"
+template <typename Vector>
+void RegisterContainer(const string& label) {
+    using Type = ValueOf<Vector>;
+    Register(label + "/PushBack", BM_PushBack<Vector>);
+    Register(label + "/PushBackReserved", BM_PushBackReserved<Vector>);
+    Register(label + "/InsertFront", BM_Insert<Vector, Position::kFront>);
+    Register(label + "/InsertMiddle", BM_Insert<Vector, Position::kMiddle>);
+    Register(label + "/InsertBack", BM_Insert<Vector, Position::kBack>);
+    Register(label + "/EraseFront", BM_Erase<Vector, Position::kFront>);
+    Register(label + "/EraseMiddle", BM_Erase<Vector, Position::kMiddle>);
+    Register(label + "/EraseBack", BM_Erase<Vector, Position::kBack>);
+    Register(label + "/EraseIf", BM_EraseIf<Vector>);
+    Register(label + "/MoveConstruct", BM_MoveConstruct<Vector>);
+    Register(label + "/Iterate", BM_Iterate<Vector>);
+    if constexpr (is_default_constructible_v<Type>) {
+        Register(label + "/Resize", BM_Resize<Vector>);
+    }
+    if constexpr (is_arithmetic_v<Type>) {
+        Register(label + "/Generate", BM_Generate<Vector>);
+    }
+    if constexpr (is_copy_constructible_v<Type>) {
+        Register(label + "/CopyConstruct", BM_CopyConstruct<Vector>);
+    }
+    if constexpr (IsComparable<Type>::value) {
+        Register(label + "/Equal", BM_Equal<Vector>);
+        Register(label + "/Less", BM_Less<Vector>);
+    }
+}
+
+// The paths that shift or regrow the buffer, for relocation and for the
+// exception guarantees
+template <typename Vector>
+void RegisterRelocation(const string& label) {
+    Register(label + "/PushBack", BM_PushBack<Vector>);
+    Register(label + "/InsertFront", BM_Insert<Vector, Position::kFront>);
+    Register(label + "/EraseFront", BM_Erase<Vector, Position::kFront>);
+}
+
+template <typename Type>
+void RegisterType(const string& type_name) {
+    RegisterContainer<vector<Type>>("std::vector<" + type_name + ">");
+    RegisterContainer<SimpleVector<Type>>("SimpleVector<" + type_name + ">");
+    RegisterContainer<ChunkedSimpleVector<Type>>("ChunkedSimpleVector<" + type_name + ">");
+}
+
+// Dedup-style key comparisons: equal keys, so both operators scan the whole vector
+template <typename Vector>
+void RegisterComparisons(const string& label) {
+    Register(label + "/Equal", BM_Equal<Vector>);
+    Register(label + "/Less", BM_Less<Vector>);
+}
+
+template <typename Type>
+void RegisterComparisonType(const string& type_name) {
+    RegisterComparisons<vector<Type>>("std::vector<" + type_name + ">");
+    RegisterComparisons<SimpleVector<Type>>("SimpleVector<" + type_name + ">");
+    RegisterComparisons<ChunkedSimpleVector<Type>>("ChunkedSimpleVector<" + type_name + ">");
+}
+
+int main(int argc, char** argv) {
+    RegisterType<int>("int");
+    // the element-wise paths and realloc growth, for the trivially copyable fast paths
+    RegisterContainer<SimpleVector<int, GenericPathAllocator<int>>>("SimpleVector<int,GenericPath>");
+    RegisterContainer<SimpleVector<int, MallocAllocator<int>>>("SimpleVector<int,Malloc>");
+    RegisterContainer<AlignedSimpleVector<int>>("SimpleVector<int,Aligned64>");
+    RegisterType<Pod64>("Pod64");
+    RegisterType<X>("X");
+    RegisterType<string>("string");
+    RegisterRelocation<vector<ThrowingMove>>("std::vector<ThrowingMove>");
+    RegisterRelocation<SimpleVector<ThrowingMove>>("SimpleVector<ThrowingMove>");
+    RegisterRelocation<vector<unique_ptr<size_t>>>("std::vector<unique_ptr>");
+    RegisterRelocation<SimpleVector<unique_ptr<size_t>>>("SimpleVector<unique_ptr>");
+    // moves and destroys element by element, as without IsTriviallyRelocatable
+    RegisterRelocation<SimpleVector<unique_ptr<size_t>, GenericPathAllocator<unique_ptr<size_t>>>>(
+        "SimpleVector<unique_ptr,GenericPath>");
+    RegisterComparisonType<uint8_t>("uint8_t");
+    RegisterComparisonType<int32_t>("int32_t");
+    RegisterComparisonType<double>("double");
+    Register("SimpleVector<int>/ShortLived", BM_ShortLived<SimpleVector<int>>);
+    Register("PooledSimpleVector<int>/ShortLived", BM_ShortLived<PooledSimpleVector<int>>);
+    benchmark::RegisterBenchmark("SortedSimpleVector<uint32_t>/Lookup", BM_SortedLookup<false>)->Range(1 << 10, 1 << 24);
+    benchmark::RegisterBenchmark("SortedSimpleVector<uint32_t>/LookupEytzinger", BM_SortedLookup<true>)->Range(1 << 10, 1 << 24);
+    Register("SortedSimpleVector<uint32_t>/InsertSorted", BM_SortedAdd<false>);
+    Register("SortedSimpleVector<uint32_t>/MergeBulk", BM_SortedAdd<true>);
+    Register("SimpleVector<int>/FanOut", BM_FanOut<SimpleVector<int>, false>);
+    Register("CowSimpleVector<int>/FanOut", BM_FanOut<CowSimpleVector<int>, false>);
+    Register("SimpleVector<string>/FanOut", BM_FanOut<SimpleVector<string>, false>);
+    Register("CowSimpleVector<string>/FanOut", BM_FanOut<CowSimpleVector<string>, false>);
+    Register("SimpleVector<int>/FanOutMutate", BM_FanOut<SimpleVector<int>, true>);
+    Register("CowSimpleVector<int>/FanOutMutate", BM_FanOut<CowSimpleVector<int>, true>);
+    Register("SimpleVector<int>+mutex/BatchHandoff", BM_BatchHandoff<LockedBatchQueue>);
+    Register("BatchChannel<int>/BatchHandoff", BM_BatchHandoff<RecyclingBatchChannel>);
+    Register("SimpleVector<double>/MultiplyAddTemporaries", BM_MultiplyAdd<Arithmetic::kTemporaries>);
+    Register("SimpleVector<double>/MultiplyAddExpression", BM_MultiplyAdd<Arithmetic::kExpression>);
+    Register("SimpleVector<double>/MultiplyAddHandWritten", BM_MultiplyAdd<Arithmetic::kHandWritten>);
+    Register("SimpleVector<Particle>/ParticleStep", BM_ParticleStepAos);
+    Register("SoaSimpleVector<12 floats>/ParticleStep", BM_ParticleStepSoa);
+    benchmark::RegisterBenchmark("SimpleVector<int>+mutex/ConcurrentAppend", BM_ConcurrentAppend<LockedAppend>)
+        ->ThreadRange(1, 32)
+        ->UseRealTime();
+    benchmark::RegisterBenchmark("ConcurrentSimpleVector<int>/ConcurrentAppend", BM_ConcurrentAppend<ConcurrentAppend>)
+        ->ThreadRange(1, 32)
+        ->UseRealTime();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,558 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "array_ptr.h"
+#include "simple_vector.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define CHANNEL_HAS_COROUTINES 1
+#endif
+
+// Bounded rings and channels for handing items, typically whole SimpleVector
+// batches, from one pipeline stage to the next. Items are moved in and out,
+// never copied. The rings are lock-free; Channel adds blocking and co_await
+// waits on top, and BatchChannel recycles drained batches back to the
+// producers so that a steady stream allocates nothing.
+
+// Capacities are rounded up to a power of two so that slots are found with a mask
+inline size_t RingCapacity(size_t capacity) noexcept {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+        rounded *= 2;
+    }
+    return rounded;
+}
+
+// Keeps the producer and the consumer indices on separate cache lines
+inline constexpr size_t kRingCacheLine = 64;
+
+// Single producer, single consumer: one thread pushes, one thread pops.
+// Each side keeps a cached copy of the other side's index and only reloads
+// it when the ring looks full (or empty).
+template <typename Type, typename Alloc = std::allocator<Type>>
+class SpscRing {
+    static_assert(std::is_nothrow_move_constructible_v<Type> && std::is_nothrow_move_assignable_v<Type>,
+                  "items are moved through the ring and must not throw");
+
+public:
+    using ValueType = Type;
+
+    explicit SpscRing(size_t capacity, const Alloc& alloc = Alloc())
+        : slots_(RingCapacity(capacity), alloc), mask_(slots_.GetSize() - 1) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    ~SpscRing() {
+        for (size_t head = head_.load(std::memory_order_relaxed); head != tail_.load(std::memory_order_relaxed);
+             ++head) {
+            slots_.Destroy(&slots_[head & mask_]);
+        }
+    }
+
+    size_t GetCapacity() const noexcept {
+        return mask_ + 1;
+    }
+
+    // Producer side; item is left untouched when the ring is full
+    bool TryPush(Type&& item) noexcept {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ > mask_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ > mask_) {
+                return false;
+            }
+        }
+        slots_.Construct(&slots_[tail & mask_], std::move(item));
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; moves the oldest item into out
+    bool TryPop(Type& out) noexcept {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return false;
+            }
+        }
+        Type& slot = slots_[head & mask_];
+        out = std::move(slot);
+        slots_.Destroy(&slot);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    ArrayPtr<Type, Alloc> slots_;
+    size_t mask_;
+    alignas(kRingCacheLine) std::atomic<size_t> tail_{0};
+    size_t cached_head_ = 0;
+    alignas(kRingCacheLine) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0;
+};
+
+// Any number of producers and consumers (D. Vyukov's bounded queue): every
+// slot carries a sequence number that says whose turn it is, so a push or
+// pop is one CAS on the shared index plus a release store on the slot.
+template <typename Type, typename Alloc = std::allocator<Type>>
+class MpmcRing {
+    static_assert(std::is_nothrow_move_constructible_v<Type> && std::is_nothrow_move_assignable_v<Type>,
+                  "items are moved through the ring and must not throw");
+
+    struct Cell {
+        explicit Cell(size_t initial_sequence) noexcept
+            : sequence(initial_sequence) {}
+
+        Type* Item() noexcept {
+            return std::launder(reinterpret_cast<Type*>(storage));
+        }
+
+        std::atomic<size_t> sequence;
+        alignas(Type) unsigned char storage[sizeof(Type)];
+    };
+
+    using CellAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Cell>;
+
+public:
+    using ValueType = Type;
+
+    explicit MpmcRing(size_t capacity, const Alloc& alloc = Alloc())
+        : cells_(RingCapacity(capacity), CellAllocator(alloc)), mask_(cells_.GetSize() - 1) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_.Construct(&cells_[i], i);
+        }
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    ~MpmcRing() {
+        for (size_t pos = dequeue_.load(std::memory_order_relaxed); pos != enqueue_.load(std::memory_order_relaxed);
+             ++pos) {
+            cells_[pos & mask_].Item()->~Type();
+        }
+        cells_.Destroy(cells_.Get(), cells_.Get() + cells_.GetSize());
+    }
+
+    size_t GetCapacity() const noexcept {
+        return mask_ + 1;
+    }
+
+    // item is left untouched when the ring is full
+    bool TryPush(Type&& item) noexcept {
+        size_t pos = enqueue_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t lag = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (lag == 0) {
+                if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (lag < 0) {
+                return false;
+            } else {
+                pos = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+        ::new (static_cast<void*>(cell->storage)) Type(std::move(item));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(Type& out) noexcept {
+        size_t pos = dequeue_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t lag = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (lag == 0) {
+                if (dequeue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (lag < 0) {
+                return false;
+            } else {
+                pos = dequeue_.load(std::memory_order_relaxed);
+            }
+        }
+        Type* item = cell->Item();
+        out = std::move(*item);
+        item->~Type();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    ArrayPtr<Cell, CellAllocator> cells_;
+    size_t mask_;
+    alignas(kRingCacheLine) std::atomic<size_t> enqueue_{0};
+    alignas(kRingCacheLine) std::atomic<size_t> dequeue_{0};
+};
+
+// A ring plus waiting: Push and Pop block the calling thread, and with
+// coroutine support PushAsync and PopAsync suspend the calling coroutine,
+// until there is room or an item. Ring is SpscRing (then there must be one
+// producer and one consumer, threads or coroutines) or MpmcRing.
+//
+// The fast path is the ring operation plus a fence and a check for waiters.
+// A side that has to wait parks in a list under a mutex; whoever next makes
+// progress on the ring completes the parked operations on its behalf and
+// wakes them, resuming parked coroutines inline on its own thread.
+//
+// Close() makes pushes fail and wakes everyone; consumers still drain what
+// is left, and Pop returns false once the channel is closed and empty.
+template <typename Ring>
+class Channel {
+public:
+    using ValueType = typename Ring::ValueType;
+
+    static_assert(std::is_default_constructible_v<ValueType>, "Pop needs somewhere to move the item to");
+
+    explicit Channel(size_t capacity)
+        : ring_(capacity) {}
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    size_t GetCapacity() const noexcept {
+        return ring_.GetCapacity();
+    }
+
+    bool IsClosed() const noexcept {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+    // False when the channel is full or closed; item is then left untouched
+    bool TryPush(ValueType&& item) {
+        if (IsClosed() || !ring_.TryPush(std::move(item))) {
+            return false;
+        }
+        WakeWaiters();
+        return true;
+    }
+
+    bool TryPop(ValueType& out) {
+        if (!ring_.TryPop(out)) {
+            return false;
+        }
+        WakeWaiters();
+        return true;
+    }
+
+    // Blocks while the channel is full; false if it is closed
+    bool Push(ValueType&& item) {
+        if (TryPush(std::move(item))) {
+            return true;
+        }
+        ThreadWaiter waiter(&item);
+        return Park(producers_, waiter) ? waiter.Wait() : waiter.done;
+    }
+
+    // Blocks while the channel is empty; false once it is closed and drained
+    bool Pop(ValueType& out) {
+        if (TryPop(out)) {
+            return true;
+        }
+        ThreadWaiter waiter(&out);
+        return Park(consumers_, waiter) ? waiter.Wait() : waiter.done;
+    }
+
+    // Fails pending and future pushes and wakes every waiter
+    void Close() {
+        Waiter* woken = nullptr;
+        {
+            std::lock_guard lock(mutex_);
+            closed_.store(true, std::memory_order_release);
+            woken = ServeParked();
+            woken = FailAll(producers_, woken);
+            woken = FailAll(consumers_, woken);
+        }
+        Resume(woken);
+    }
+
+#ifdef CHANNEL_HAS_COROUTINES
+    class PushAwaiter;
+    class PopAwaiter;
+
+    // co_await channel.PushAsync(std::move(batch)) -> false if closed
+    PushAwaiter PushAsync(ValueType&& item) {
+        return PushAwaiter(*this, std::move(item));
+    }
+
+    // co_await channel.PopAsync(batch) -> false once closed and drained
+    PopAwaiter PopAsync(ValueType& out) {
+        return PopAwaiter(*this, out);
+    }
+#endif
+
+protected:
+    // A parked push or pop. item is the source of a push or the destination
+    // of a pop; wake runs once the operation completed (done) or failed.
+    struct Waiter {
+        explicit Waiter(ValueType* waiter_item) noexcept
+            : item(waiter_item) {}
+
+        virtual void Wake() noexcept = 0;
+
+        ValueType* item;
+        bool done = false;
+        Waiter* next = nullptr;
+    };
+
+    struct WaitList {
+        Waiter* head = nullptr;
+        Waiter* tail = nullptr;
+        std::atomic<size_t> count{0};
+
+        void Append(Waiter& waiter) noexcept {
+            (tail ? tail->next : head) = &waiter;
+            tail = &waiter;
+        }
+
+        Waiter* PopFront() noexcept {
+            Waiter* waiter = head;
+            head = waiter->next;
+            if (!head) {
+                tail = nullptr;
+            }
+            waiter->next = nullptr;
+            count.fetch_sub(1, std::memory_order_relaxed);
+            return waiter;
+        }
+    };
+
+    struct ThreadWaiter : Waiter {
+        using Waiter::Waiter;
+
+        void Wake() noexcept override {
+            std::lock_guard lock(mutex);
+            woken = true;
+            condition.notify_one();
+        }
+
+        bool Wait() {
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [this] { return woken; });
+            return this->done;
+        }
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool woken = false;
+    };
+
+    // Tries the operation once more under the lock and parks waiter if it
+    // still cannot complete. Returns true if parked; otherwise waiter.done
+    // says whether the retry went through. The seq_cst fences here and in
+    // WakeWaiters make sure a concurrent ring operation either sees the
+    // parked waiter or is seen by the retry.
+    bool Park(WaitList& list, Waiter& waiter) {
+        {
+            std::lock_guard lock(mutex_);
+            const bool push = &list == &producers_;
+            if (push && IsClosed()) {
+                return false;
+            }
+            list.count.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            waiter.done = push ? ring_.TryPush(std::move(*waiter.item)) : ring_.TryPop(*waiter.item);
+            if (!waiter.done && !(!push && IsClosed())) {
+                list.Append(waiter);
+                return true;
+            }
+            list.count.fetch_sub(1, std::memory_order_relaxed);
+        }
+        if (waiter.done) {
+            WakeWaiters();
+        }
+        return false;
+    }
+
+    // Called after every successful ring operation: completes parked
+    // operations that can now go through
+    void WakeWaiters() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (producers_.count.load(std::memory_order_relaxed) == 0 &&
+            consumers_.count.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        Waiter* woken = nullptr;
+        {
+            std::lock_guard lock(mutex_);
+            woken = ServeParked();
+        }
+        Resume(woken);
+    }
+
+    // Completes parked pushes and pops for as long as the ring lets them
+    // through (a served push may unblock a parked pop and the other way
+    // round). Returns the served waiters, newest first; needs mutex_.
+    Waiter* ServeParked() {
+        Waiter* woken = nullptr;
+        for (bool progress = true; progress;) {
+            progress = false;
+            while (producers_.head && ring_.TryPush(std::move(*producers_.head->item))) {
+                woken = Finish(producers_.PopFront(), true, woken);
+                progress = true;
+            }
+            while (consumers_.head && ring_.TryPop(*consumers_.head->item)) {
+                woken = Finish(consumers_.PopFront(), true, woken);
+                progress = true;
+            }
+        }
+        return woken;
+    }
+
+    static Waiter* FailAll(WaitList& list, Waiter* woken) {
+        while (list.head) {
+            woken = Finish(list.PopFront(), false, woken);
+        }
+        return woken;
+    }
+
+    static Waiter* Finish(Waiter* waiter, bool done, Waiter* woken) noexcept {
+        waiter->done = done;
+        waiter->next = woken;
+        return waiter;
+    }
+
+    // Wakes in the order the waiters parked; outside the lock, as a woken
+    // coroutine runs right here and may use the channel again
+    static void Resume(Waiter* woken) noexcept {
+        Waiter* ordered = nullptr;
+        while (woken) {
+            Waiter* next = woken->next;
+            woken->next = ordered;
+            ordered = woken;
+            woken = next;
+        }
+        while (ordered) {
+            Waiter* next = ordered->next;
+            ordered->Wake();
+            ordered = next;
+        }
+    }
+
+    Ring ring_;
+    std::atomic<bool> closed_{false};
+    std::mutex mutex_;
+    WaitList producers_;
+    WaitList consumers_;
+};
+
+#ifdef CHANNEL_HAS_COROUTINES
+template <typename Ring>
+class Channel<Ring>::PushAwaiter : Waiter {
+public:
+    PushAwaiter(Channel& channel, ValueType&& item)
+        : Waiter(&item_), channel_(channel), item_(std::move(item)) {}
+
+    bool await_ready() {
+        this->done = channel_.TryPush(std::move(item_));
+        return this->done || channel_.IsClosed();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        handle_ = handle;
+        return channel_.Park(channel_.producers_, *this);
+    }
+
+    bool await_resume() const noexcept {
+        return this->done;
+    }
+
+private:
+    void Wake() noexcept override {
+        handle_.resume();
+    }
+
+    Channel& channel_;
+    ValueType item_;
+    std::coroutine_handle<> handle_;
+};
+
+template <typename Ring>
+class Channel<Ring>::PopAwaiter : Waiter {
+public:
+    PopAwaiter(Channel& channel, ValueType& out)
+        : Waiter(&out), channel_(channel) {}
+
+    bool await_ready() {
+        this->done = channel_.TryPop(*this->item);
+        return this->done;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        handle_ = handle;
+        return channel_.Park(channel_.consumers_, *this);
+    }
+
+    bool await_resume() const noexcept {
+        return this->done;
+    }
+
+private:
+    void Wake() noexcept override {
+        handle_.resume();
+    }
+
+    Channel& channel_;
+    std::coroutine_handle<> handle_;
+};
+#endif
+
+template <typename Type>
+using SpscChannel = Channel<SpscRing<Type>>;
+
+template <typename Type>
+using MpmcChannel = Channel<MpmcRing<Type>>;
+
+// Channel of SimpleVector batches that also carries the drained batches back:
+// the consumer hands a batch it is done with to Recycle, and the producer's
+// next TakeBatch gets it back with its capacity intact. Up to the channel's
+// capacity (rounded up to a power of two) of spare batches are kept; Recycle
+// frees any batch beyond that.
+template <typename Type, template <typename...> class Ring = MpmcRing>
+class BatchChannel : public Channel<Ring<SimpleVector<Type>>> {
+public:
+    using Batch = SimpleVector<Type>;
+
+    // New batches reserve batch_capacity elements
+    BatchChannel(size_t capacity, size_t batch_capacity)
+        : Channel<Ring<Batch>>(capacity), spare_(capacity), batch_capacity_(batch_capacity) {}
+
+    // An empty batch, recycled if one is available
+    Batch TakeBatch() {
+        Batch batch;
+        if (!spare_.TryPop(batch)) {
+            batch.Reserve(batch_capacity_);
+        }
+        return batch;
+    }
+
+    // Returns a drained batch to the producers, or frees it if enough are
+    // spare already. Either way batch is left without storage.
+    void Recycle(Batch&& batch) noexcept {
+        Batch spare(std::move(batch));
+        spare.Clear();
+        spare_.TryPush(std::move(spare));
+    }
+
+private:
+    MpmcRing<Batch> spare_;
+    size_t batch_capacity_;
+};
@@ -0,0 +1,618 @@
+#pragma once
+
+#include <cassert>
+#include <initializer_list>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "array_ptr.h"
+#include "compare_kernels.h"
+#include "simple_vector.h"
+
+// The largest power of two of elements that fits into a 4 KiB block, at least one
+template <typename Type>
+constexpr size_t DefaultChunkBlockSize() noexcept {
+    size_t size = 1;
+    while (size * 2 * sizeof(Type) <= 4096) {
+        size *= 2;
+    }
+    return size;
+}
+
+// SimpleVector over fixed-size blocks of BlockSize elements plus a block
+// index. Growing adds blocks: elements are never moved or copied, the peak
+// is one block above the final size, and references and pointers to elements
+// stay valid until the element is erased. As with std::deque, iterators are
+// invalidated by growth, as they point into the block index.
+template <typename Type, typename Alloc = std::allocator<Type>, size_t BlockSize = DefaultChunkBlockSize<Type>()>
+class ChunkedSimpleVector {
+    static_assert(BlockSize > 0 && (BlockSize & (BlockSize - 1)) == 0, "block size must be a power of two");
+
+    using Block = ArrayPtr<Type, Alloc>;
+
+    template <typename ValueType>
+    class BasicIterator;
+
+public:
+    using Iterator = BasicIterator<Type>;
+    using ConstIterator = BasicIterator<const Type>;
+    using AllocatorType = Alloc;
+
+    static constexpr size_t kBlockSize = BlockSize;
+
+    ChunkedSimpleVector() noexcept(noexcept(Alloc())) = default;
+
+    explicit ChunkedSimpleVector(const Alloc& alloc) noexcept
+        : alloc_(alloc) {}
+
+    explicit ChunkedSimpleVector(ReserveProxy proxy, const Alloc& alloc = Alloc())
+        : alloc_(alloc) {
+        Reserve(proxy.capacity);
+    }
+
+    explicit ChunkedSimpleVector(size_t size, const Alloc& alloc = Alloc())
+        : alloc_(alloc) {
+        Resize(size);
+    }
+
+    ChunkedSimpleVector(size_t size, const Type& value, const Alloc& alloc = Alloc())
+        : alloc_(alloc) {
+        Grow(size, [&value](Block& block, Type* dest, size_t, size_t count) {
+            block.UninitializedFill(dest, count, value);
+        });
+    }
+
+    ChunkedSimpleVector(std::initializer_list<Type> init, const Alloc& alloc = Alloc())
+        : alloc_(alloc) {
+        Grow(init.size(), [&init](Block& block, Type* dest, size_t index, size_t count) {
+            block.UninitializedCopy(init.begin() + index, init.begin() + index + count, dest);
+        });
+    }
+
+    ChunkedSimpleVector(const ChunkedSimpleVector& other)
+        : ChunkedSimpleVector(other, AllocTraits::select_on_container_copy_construction(other.alloc_)) {}
+
+    // Both vectors have the same block layout, so the copy goes block by block
+    ChunkedSimpleVector(const ChunkedSimpleVector& other, const Alloc& alloc)
+        : alloc_(alloc) {
+        Grow(other.size_, [&other](Block& block, Type* dest, size_t index, size_t count) {
+            const Type* source = other.GetBlock(index / kBlockSize) + index % kBlockSize;
+            block.UninitializedCopy(source, source + count, dest);
+        });
+    }
+
+    ChunkedSimpleVector(ChunkedSimpleVector&& other) noexcept
+        : alloc_(other.alloc_),
+          blocks_(std::move(other.blocks_)),
+          size_(std::exchange(other.size_, 0)) {}
+
+    ChunkedSimpleVector& operator=(const ChunkedSimpleVector& rhs) {
+        if (this != &rhs) {
+            ChunkedSimpleVector temp(rhs, AllocTraits::propagate_on_container_copy_assignment::value
+                                              ? rhs.alloc_
+                                              : alloc_);
+            SwapStorage(temp);
+        }
+        return *this;
+    }
+
+    ChunkedSimpleVector& operator=(ChunkedSimpleVector&& rhs) noexcept(kMoveAssignNoexcept) {
+        if (this != &rhs) {
+            if (kMoveAssignNoexcept || alloc_ == rhs.alloc_) {
+                SwapStorage(rhs);
+            } else {
+                // blocks of rhs can't be freed by our allocator, so move element-wise
+                ChunkedSimpleVector temp(alloc_);
+                temp.Grow(rhs.size_, [&rhs](Block& block, Type* dest, size_t index, size_t count) {
+                    Type* source = rhs.blocks_[index / kBlockSize].Get() + index % kBlockSize;
+                    block.UninitializedMove(source, source + count, dest);
+                });
+                SwapStorage(temp);
+            }
+            rhs.Clear();
+        }
+        return *this;
+    }
+
+    ~ChunkedSimpleVector() {
+        DestroyTail(0);
+    }
+
+    // Allocates the missing blocks; existing elements stay where they are
+    void Reserve(size_t new_capacity) {
+        if (new_capacity > GetCapacity()) {
+            blocks_.Reserve(BlocksFor(new_capacity));
+            while (GetCapacity() < new_capacity) {
+                blocks_.EmplaceBack(kBlockSize, alloc_);
+            }
+        }
+    }
+
+    // Frees the blocks past the last element
+    void ShrinkToFit() {
+        while (blocks_.GetSize() > BlocksFor(size_)) {
+            blocks_.PopBack();
+        }
+        blocks_.ShrinkToFit();
+    }
+
+    // Destroys the elements and frees the storage
+    void ClearAndRelease() noexcept {
+        Clear();
+        blocks_.ClearAndRelease();
+    }
+
+    size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    size_t GetCapacity() const noexcept {
+        return blocks_.GetSize() * kBlockSize;
+    }
+
+    bool IsEmpty() const noexcept {
+        return size_ == 0;
+    }
+
+    Alloc GetAllocator() const noexcept {
+        return alloc_;
+    }
+
+    // The elements in block i are contiguous: [GetBlock(i), GetBlock(i) + kBlockSize)
+    size_t GetBlockCount() const noexcept {
+        return BlocksFor(size_);
+    }
+
+    Type* GetBlock(size_t block) noexcept {
+        assert(block < GetBlockCount());
+        return blocks_[block].Get();
+    }
+
+    const Type* GetBlock(size_t block) const noexcept {
+        assert(block < GetBlockCount());
+        return blocks_[block].Get();
+    }
+
+    Type& operator[](size_t index) noexcept {
+        assert(index < size_);
+        return blocks_[index / kBlockSize][index % kBlockSize];
+    }
+
+    const Type& operator[](size_t index) const noexcept {
+        assert(index < size_);
+        return blocks_[index / kBlockSize][index % kBlockSize];
+    }
+
+    Type& At(size_t index) {
+        if (index >= size_) {
+            throw std::out_of_range("Index out of range");
+        }
+        return (*this)[index];
+    }
+
+    const Type& At(size_t index) const {
+        if (index >= size_) {
+            throw std::out_of_range("Index out of range");
+        }
+        return (*this)[index];
+    }
+
+    void Clear() noexcept {
+        DestroyTail(0);
+    }
+
+    void Resize(size_t new_size) {
+        if (new_size <= size_) {
+            DestroyTail(new_size);
+            return;
+        }
+        Grow(new_size, [](Block& block, Type* dest, size_t, size_t count) {
+            block.UninitializedValueConstruct(dest, count);
+        });
+    }
+
+    void PushBack(const Type& item) {
+        EmplaceBack(item);
+    }
+
+    void PushBack(Type&& item) {
+        EmplaceBack(std::move(item));
+    }
+
+    // O(1): at worst one new block is allocated
+    template <typename... Args>
+    Type& EmplaceBack(Args&&... args) {
+        if (size_ == GetCapacity()) {
+            blocks_.EmplaceBack(kBlockSize, alloc_);
+        }
+        Block& block = blocks_[size_ / kBlockSize];
+        Type* slot = block.Get() + size_ % kBlockSize;
+        block.Construct(slot, std::forward<Args>(args)...);
+        ++size_;
+        return *slot;
+    }
+
+    // Everything after pos moves by one; the blocks themselves never move
+    template <typename... Args>
+    Iterator Emplace(ConstIterator pos, Args&&... args) {
+        size_t offset = pos - cbegin();
+        if (offset == size_) {
+            EmplaceBack(std::forward<Args>(args)...);
+        } else {
+            // args may refer to an element of the vector
+            Type value(std::forward<Args>(args)...);
+            EmplaceBack(std::move((*this)[size_ - 1]));
+            MoveBackward(size_ - 1, size_ - 2, size_ - 2 - offset);
+            (*this)[offset] = std::move(value);
+        }
+        return begin() + offset;
+    }
+
+    Iterator Insert(ConstIterator pos, const Type& value) {
+        return Emplace(pos, value);
+    }
+
+    Iterator Insert(ConstIterator pos, Type&& value) {
+        return Emplace(pos, std::move(value));
+    }
+
+    Iterator Insert(ConstIterator pos, size_t count, const Type& value) {
+        size_t offset = pos - cbegin();
+        size_t old_size = size_;
+        AppendOrRollBack(old_size, [&] {
+            Grow(size_ + count, [&value](Block& block, Type* dest, size_t, size_t block_count) {
+                block.UninitializedFill(dest, block_count, value);
+            });
+        });
+        std::rotate(begin() + offset, begin() + old_size, end());
+        return begin() + offset;
+    }
+
+    template <typename InputIt, typename = std::enable_if_t<IsIterator<InputIt>::value>>
+    Iterator Insert(ConstIterator pos, InputIt first, InputIt last) {
+        size_t offset = pos - cbegin();
+        size_t old_size = size_;
+        AppendOrRollBack(old_size, [&] {
+            for (; first != last; ++first) {
+                EmplaceBack(*first);
+            }
+        });
+        std::rotate(begin() + offset, begin() + old_size, end());
+        return begin() + offset;
+    }
+
+    template <typename InputIt, typename = std::enable_if_t<IsIterator<InputIt>::value>>
+    void Append(InputIt first, InputIt last) {
+        Insert(cend(), first, last);
+    }
+
+    void PopBack() noexcept {
+        assert(size_ > 0);
+        --size_;
+        blocks_[size_ / kBlockSize].Destroy(blocks_[size_ / kBlockSize].Get() + size_ % kBlockSize);
+    }
+
+    Iterator Erase(ConstIterator pos) {
+        return Erase(pos, std::next(pos));
+    }
+
+    // Removes [first, last) with a single shift of the tail
+    Iterator Erase(ConstIterator first, ConstIterator last) {
+        size_t offset = first - cbegin();
+        size_t count = last - first;
+        if (count > 0) {
+            MoveForward(offset, offset + count, size_ - offset - count);
+            DestroyTail(size_ - count);
+        }
+        return begin() + offset;
+    }
+
+    // Unordered O(1) erase: the last element is moved into the hole
+    Iterator SwapRemove(ConstIterator pos) {
+        size_t index = pos - cbegin();
+        if (index + 1 != size_) {
+            (*this)[index] = std::move((*this)[size_ - 1]);
+        }
+        PopBack();
+        return begin() + index;
+    }
+
+    void swap(ChunkedSimpleVector& other) noexcept {
+        if constexpr (!AllocTraits::propagate_on_container_swap::value) {
+            assert(alloc_ == other.alloc_);
+        }
+        SwapStorage(other);
+    }
+
+    Iterator begin() noexcept {
+        return Iterator(blocks_.begin(), 0);
+    }
+
+    Iterator end() noexcept {
+        return Iterator(blocks_.begin(), size_);
+    }
+
+    ConstIterator begin() const noexcept {
+        return ConstIterator(blocks_.begin(), 0);
+    }
+
+    ConstIterator end() const noexcept {
+        return ConstIterator(blocks_.begin(), size_);
+    }
+
+    ConstIterator cbegin() const noexcept {
+        return begin();
+    }
+
+    ConstIterator cend() const noexcept {
+        return end();
+    }
+
+private:
+    using AllocTraits = std::allocator_traits<Alloc>;
+
+    static constexpr bool kMoveAssignNoexcept = AllocTraits::propagate_on_container_move_assignment::value ||
+                                                AllocTraits::is_always_equal::value;
+
+    static size_t BlocksFor(size_t size) noexcept {
+        return (size + kBlockSize - 1) / kBlockSize;
+    }
+
+    // Every block remembers the allocator it came from, so the block index
+    // itself can always be swapped
+    void SwapStorage(ChunkedSimpleVector& other) noexcept {
+        std::swap(alloc_, other.alloc_);
+        blocks_.swap(other.blocks_);
+        std::swap(size_, other.size_);
+    }
+
+    // Constructs the elements [size_, new_size) block by block with
+    // construct(block, dest, index, count). If it throws, the elements built
+    // so far stay in the vector.
+    template <typename ConstructBlock>
+    void Grow(size_t new_size, ConstructBlock construct) {
+        Reserve(new_size);
+        while (size_ < new_size) {
+            Block& block = blocks_[size_ / kBlockSize];
+            size_t offset = size_ % kBlockSize;
+            size_t count = std::min(kBlockSize - offset, new_size - size_);
+            construct(block, block.Get() + offset, size_, count);
+            size_ += count;
+        }
+    }
+
+    // Runs append and, if it throws, destroys what it appended after old_size
+    template <typename Append>
+    void AppendOrRollBack(size_t old_size, Append append) {
+        try {
+            append();
+        } catch (...) {
+            DestroyTail(old_size);
+            throw;
+        }
+    }
+
+    Type* Slot(size_t index) noexcept {
+        return blocks_[index / kBlockSize].Get() + index % kBlockSize;
+    }
+
+    // Moves the count elements starting at from to the ones starting at
+    // to < from, one contiguous span at a time
+    void MoveForward(size_t to, size_t from, size_t count) {
+        while (count > 0) {
+            size_t span = std::min({count, kBlockSize - from % kBlockSize, kBlockSize - to % kBlockSize});
+            std::move(Slot(from), Slot(from) + span, Slot(to));
+            from += span;
+            to += span;
+            count -= span;
+        }
+    }
+
+    // Moves the count elements ending at from_end to the ones ending at
+    // to_end > from_end, from the back one contiguous span at a time
+    void MoveBackward(size_t to_end, size_t from_end, size_t count) {
+        while (count > 0) {
+            size_t span = std::min({count, (from_end - 1) % kBlockSize + 1, (to_end - 1) % kBlockSize + 1});
+            from_end -= span;
+            to_end -= span;
+            std::move_backward(Slot(from_end), Slot(from_end) + span, Slot(to_end) + span);
+            count -= span;
+        }
+    }
+
+    // Destroys the elements from new_size on, one block at a time
+    void DestroyTail(size_t new_size) noexcept {
+        while (size_ > new_size) {
+            Block& block = blocks_[(size_ - 1) / kBlockSize];
+            size_t first = std::max(new_size, (size_ - 1) / kBlockSize * kBlockSize);
+            block.Destroy(block.Get() + first % kBlockSize, block.Get() + (size_ - 1) % kBlockSize + 1);
+            size_ = first;
+        }
+    }
+
+    template <typename ValueType>
+    class BasicIterator {
+        using BlockPointer = std::conditional_t<std::is_const_v<ValueType>, const Block*, Block*>;
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::remove_const_t<ValueType>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = ValueType*;
+        using reference = ValueType&;
+
+        BasicIterator() noexcept = default;
+
+        BasicIterator(BlockPointer blocks, size_t index) noexcept
+            : blocks_(blocks), index_(index) {}
+
+        // Iterator converts to ConstIterator
+        template <typename Other, typename = std::enable_if_t<std::is_same_v<ValueType, const Other>>>
+        BasicIterator(const BasicIterator<Other>& other) noexcept
+            : blocks_(other.blocks_), index_(other.index_) {}
+
+        reference operator*() const noexcept {
+            return blocks_[index_ / kBlockSize].Get()[index_ % kBlockSize];
+        }
+
+        pointer operator->() const noexcept {
+            return &**this;
+        }
+
+        reference operator[](difference_type offset) const noexcept {
+            return *(*this + offset);
+        }
+
+        BasicIterator& operator++() noexcept {
+            ++index_;
+            return *this;
+        }
+
+        BasicIterator operator++(int) noexcept {
+            BasicIterator copy = *this;
+            ++index_;
+            return copy;
+        }
+
+        BasicIterator& operator--() noexcept {
+            --index_;
+            return *this;
+        }
+
+        BasicIterator operator--(int) noexcept {
+            BasicIterator copy = *this;
+            --index_;
+            return copy;
+        }
+
+        BasicIterator& operator+=(difference_type offset) noexcept {
+            index_ += offset;
+            return *this;
+        }
+
+        BasicIterator& operator-=(difference_type offset) noexcept {
+            index_ -= offset;
+            return *this;
+        }
+
+        friend BasicIterator operator+(BasicIterator it, difference_type offset) noexcept {
+            return it += offset;
+        }
+
+        friend BasicIterator operator+(difference_type offset, BasicIterator it) noexcept {
+            return it += offset;
+        }
+
+        friend BasicIterator operator-(BasicIterator it, difference_type offset) noexcept {
+            return it -= offset;
+        }
+
+        friend difference_type operator-(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+            return static_cast<difference_type>(lhs.index_) - static_cast<difference_type>(rhs.index_);
+        }
+
+        friend bool operator==(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+            return lhs.index_ == rhs.index_;
+        }
+
+        friend bool operator!=(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+            return lhs.index_ != rhs.index_;
+        }
+
+        friend bool operator<(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+            return lhs.index_ < rhs.index_;
+        }
+
+        friend bool operator>(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+            return rhs < lhs;
+        }
+
+        friend bool operator<=(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+            return !(rhs < lhs);
+        }
+
+        friend bool operator>=(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+            return !(lhs < rhs);
+        }
+
+    private:
+        template <typename>
+        friend class BasicIterator;
+
+        BlockPointer blocks_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    Alloc alloc_;
+    // Holds only the block pointers, so its own growth is cheap
+    SimpleVector<Block> blocks_;
+    size_t size_ = 0;
+};
+
+// Vectors with the same block size line up block by block, so the
+// comparisons run the kernels over whole blocks
+template <typename Type, typename Alloc, size_t BlockSize>
+inline bool operator==(const ChunkedSimpleVector<Type, Alloc, BlockSize>& lhs,
+                       const ChunkedSimpleVector<Type, Alloc, BlockSize>& rhs) {
+    if (lhs.GetSize() != rhs.GetSize()) {
+        return false;
+    }
+    for (size_t block = 0; block < lhs.GetBlockCount(); ++block) {
+        size_t count = std::min(BlockSize, lhs.GetSize() - block * BlockSize);
+        if (!RangesEqual(lhs.GetBlock(block), rhs.GetBlock(block), count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Type, typename Alloc, size_t BlockSize>
+inline bool operator!=(const ChunkedSimpleVector<Type, Alloc, BlockSize>& lhs,
+                       const ChunkedSimpleVector<Type, Alloc, BlockSize>& rhs) {
+    return !(lhs == rhs);
+}
+
+template <typename Type, typename Alloc, size_t BlockSize>
+inline bool operator<(const ChunkedSimpleVector<Type, Alloc, BlockSize>& lhs,
+                      const ChunkedSimpleVector<Type, Alloc, BlockSize>& rhs) {
+    for (size_t block = 0; block < std::min(lhs.GetBlockCount(), rhs.GetBlockCount()); ++block) {
+        size_t lhs_count = std::min(BlockSize, lhs.GetSize() - block * BlockSize);
+        size_t rhs_count = std::min(BlockSize, rhs.GetSize() - block * BlockSize);
+        // a partial block is the last one, so it decides the order
+        if (lhs_count != BlockSize || rhs_count != BlockSize ||
+            !RangesEqual(lhs.GetBlock(block), rhs.GetBlock(block), BlockSize)) {
+            return RangesLess(lhs.GetBlock(block), lhs_count, rhs.GetBlock(block), rhs_count);
+        }
+    }
+    return lhs.GetSize() < rhs.GetSize();
+}
+
+template <typename Type, typename Alloc, size_t BlockSize>
+inline bool operator<=(const ChunkedSimpleVector<Type, Alloc, BlockSize>& lhs,
+                       const ChunkedSimpleVector<Type, Alloc, BlockSize>& rhs) {
+    return !(rhs < lhs);
+}
+
+template <typename Type, typename Alloc, size_t BlockSize>
+inline bool operator>(const ChunkedSimpleVector<Type, Alloc, BlockSize>& lhs,
+                      const ChunkedSimpleVector<Type, Alloc, BlockSize>& rhs) {
+    return rhs < lhs;
+}
+
+template <typename Type, typename Alloc, size_t BlockSize>
+inline bool operator>=(const ChunkedSimpleVector<Type, Alloc, BlockSize>& lhs,
+                       const ChunkedSimpleVector<Type, Alloc, BlockSize>& rhs) {
+    return !(lhs < rhs);
+}
+
+// Removes the elements satisfying pred in one compaction pass and returns how many were removed
+template <typename Type, typename Alloc, size_t BlockSize, typename Predicate>
+size_t EraseIf(ChunkedSimpleVector<Type, Alloc, BlockSize>& vector, Predicate pred) {
+    auto new_end = std::remove_if(vector.begin(), vector.end(), pred);
+    size_t removed = vector.end() - new_end;
+    vector.Erase(new_end, vector.end());
+    return removed;
+}
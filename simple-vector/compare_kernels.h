@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <immintrin.h>
+#define COMPARE_KERNELS_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define COMPARE_KERNELS_NEON 1
+#endif
+
+// Comparison kernels behind operator== and operator< of the vectors. Integral
+// elements compare equal exactly when their bytes do, so equality is a
+// memcmp and ordering only has to find the first differing byte, which the
+// SIMD kernels below do 16 or 32 bytes at a time. Everything else, floating
+// point included (NaN, -0.0), goes through the element-wise std algorithms.
+
+// Index of the first byte where lhs and rhs differ, or size if they don't
+inline size_t MismatchBytesScalar(const unsigned char* lhs, const unsigned char* rhs, size_t size) noexcept {
+    size_t i = 0;
+    while (i < size && lhs[i] == rhs[i]) {
+        ++i;
+    }
+    return i;
+}
+
+#ifdef COMPARE_KERNELS_X86
+inline size_t MismatchBytesSse2(const unsigned char* lhs, const unsigned char* rhs, size_t size) noexcept {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))) ^ 0xFFFFu;
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + MismatchBytesScalar(lhs + i, rhs + i, size - i);
+}
+
+__attribute__((target("avx2"))) inline size_t MismatchBytesAvx2(const unsigned char* lhs, const unsigned char* rhs,
+                                                                 size_t size) noexcept {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs + i));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + MismatchBytesSse2(lhs + i, rhs + i, size - i);
+}
+#endif
+
+#ifdef COMPARE_KERNELS_NEON
+inline size_t MismatchBytesNeon(const unsigned char* lhs, const unsigned char* rhs, size_t size) noexcept {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t equal = vceqq_u8(vld1q_u8(lhs + i), vld1q_u8(rhs + i));
+        if (vminvq_u8(equal) != 0xFF) {
+            break;
+        }
+    }
+    return i + MismatchBytesScalar(lhs + i, rhs + i, size - i);
+}
+#endif
+
+using MismatchBytesKernel = size_t (*)(const unsigned char*, const unsigned char*, size_t) noexcept;
+
+// The best kernel for the CPU we are running on
+inline MismatchBytesKernel SelectMismatchBytesKernel() noexcept {
+#if defined(COMPARE_KERNELS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return MismatchBytesAvx2;
+    }
+    return MismatchBytesSse2;
+#elif defined(COMPARE_KERNELS_NEON)
+    return MismatchBytesNeon;
+#else
+    return MismatchBytesScalar;
+#endif
+}
+
+inline size_t MismatchBytes(const void* lhs, const void* rhs, size_t size) noexcept {
+    static const MismatchBytesKernel kernel = SelectMismatchBytesKernel();
+    return kernel(static_cast<const unsigned char*>(lhs), static_cast<const unsigned char*>(rhs), size);
+}
+
+template <typename Type>
+inline constexpr bool kComparesAsBytes = std::is_integral_v<Type>;
+
+template <typename Type>
+bool RangesEqual(const Type* lhs, const Type* rhs, size_t count) {
+    if constexpr (kComparesAsBytes<Type>) {
+        return count == 0 || std::memcmp(lhs, rhs, count * sizeof(Type)) == 0;
+    } else {
+        return std::equal(lhs, lhs + count, rhs);
+    }
+}
+
+template <typename Type>
+bool RangesLess(const Type* lhs, size_t lhs_count, const Type* rhs, size_t rhs_count) {
+    if constexpr (kComparesAsBytes<Type>) {
+        size_t count = std::min(lhs_count, rhs_count);
+        if constexpr (sizeof(Type) == 1 && std::is_unsigned_v<Type>) {
+            // memcmp orders bytes as unsigned char, which is exactly this order
+            int order = count == 0 ? 0 : std::memcmp(lhs, rhs, count);
+            return order != 0 ? order < 0 : lhs_count < rhs_count;
+        } else {
+            size_t index = MismatchBytes(lhs, rhs, count * sizeof(Type)) / sizeof(Type);
+            return index == count ? lhs_count < rhs_count : lhs[index] < rhs[index];
+        }
+    } else {
+        return std::lexicographical_compare(lhs, lhs + lhs_count, rhs, rhs + rhs_count);
+    }
+}
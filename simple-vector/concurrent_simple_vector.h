@@ -0,0 +1,356 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "array_ptr.h"
+
+// Append-only vector for many producers. PushBack and EmplaceBack reserve a
+// slot with a compare-and-swap and construct the element in place; no lock is
+// taken.
+// Storage is a list of segments that double in size (kFirstSegment elements,
+// then 2x, 4x, ...), so growing never moves an element and references stay
+// valid for the lifetime of the vector.
+//
+// An element becomes visible once it and every element before it have been
+// constructed: GetSize() is that published prefix, and begin()/end() iterate a
+// snapshot of it. A producer only flags its slot as ready; readers move the
+// published size over the ready slots, so producers never wait for each other
+// and pay one successful atomic read-modify-write per element.
+//
+// Only appending and reading may run concurrently. Clear, Reserve and
+// destruction need the vector to themselves.
+template <typename Type, typename Alloc = std::allocator<Type>>
+class ConcurrentSimpleVector {
+    static_assert(std::is_nothrow_move_constructible_v<Type>,
+                  "a slot is reserved before the element is placed into it, which must not fail");
+
+    template <typename ValueType>
+    class BasicIterator;
+
+public:
+    using Iterator = BasicIterator<Type>;
+    using ConstIterator = BasicIterator<const Type>;
+    using AllocatorType = Alloc;
+
+    static constexpr size_t kFirstSegment = 8;
+
+    ConcurrentSimpleVector() noexcept(noexcept(Alloc())) = default;
+
+    explicit ConcurrentSimpleVector(const Alloc& alloc) noexcept
+        : alloc_(alloc) {}
+
+    ConcurrentSimpleVector(const ConcurrentSimpleVector&) = delete;
+    ConcurrentSimpleVector& operator=(const ConcurrentSimpleVector&) = delete;
+
+    ~ConcurrentSimpleVector() {
+        Clear();
+        for (auto& segment : segments_) {
+            delete segment.load(std::memory_order_relaxed);
+        }
+    }
+
+    void PushBack(const Type& item) {
+        EmplaceBack(item);
+    }
+
+    void PushBack(Type&& item) {
+        EmplaceBack(std::move(item));
+    }
+
+    // Safe to call from any number of threads at once. The returned reference
+    // stays valid until Clear or destruction.
+    template <typename... Args>
+    Type& EmplaceBack(Args&&... args) {
+        if constexpr (std::is_nothrow_constructible_v<Type, Args&&...>) {
+            return Publish([&](Segment& segment, Type* slot) {
+                segment.items.Construct(slot, std::forward<Args>(args)...);
+            });
+        } else {
+            // build the element before taking a slot, so a throwing
+            // constructor cannot leave a hole in the sequence
+            Type item(std::forward<Args>(args)...);
+            return Publish([&](Segment& segment, Type* slot) {
+                segment.items.Construct(slot, std::move(item));
+            });
+        }
+    }
+
+    // Allocates the segments for the first new_capacity elements up front
+    void Reserve(size_t new_capacity) {
+        for (size_t index = 0; index < SegmentCount(new_capacity); ++index) {
+            AcquireSegment(index);
+        }
+    }
+
+    // Destroys all elements and keeps the segments for reuse
+    void Clear() noexcept {
+        const size_t size = GetSize();
+        assert(size == reserved_.load(std::memory_order_relaxed));
+        for (size_t index = 0; index < SegmentCount(size); ++index) {
+            Segment& segment = *segments_[index].load(std::memory_order_relaxed);
+            const size_t count = std::min(SegmentSize(index), size - SegmentStart(index));
+            segment.items.Destroy(segment.items.Get(), segment.items.Get() + count);
+            for (size_t offset = 0; offset < count; ++offset) {
+                segment.ready[offset].store(false, std::memory_order_relaxed);
+            }
+        }
+        reserved_.store(0, std::memory_order_relaxed);
+        published_.store(0, std::memory_order_release);
+    }
+
+    // Number of published elements
+    size_t GetSize() const noexcept {
+        size_t published = published_.load(std::memory_order_acquire);
+        size_t size = published;
+        while (IsReady(size)) {
+            ++size;
+        }
+        // remember how far we got; another reader may have got further already
+        while (published < size &&
+               !published_.compare_exchange_weak(published, size, std::memory_order_acq_rel)) {
+        }
+        return size;
+    }
+
+    // Number of elements that fit into the allocated segments
+    size_t GetCapacity() const noexcept {
+        size_t capacity = 0;
+        for (size_t index = 0; index < kMaxSegments && segments_[index].load(std::memory_order_acquire); ++index) {
+            capacity = SegmentStart(index) + SegmentSize(index);
+        }
+        return capacity;
+    }
+
+    bool IsEmpty() const noexcept {
+        return GetSize() == 0;
+    }
+
+    Alloc GetAllocator() const noexcept {
+        return alloc_;
+    }
+
+    Type& operator[](size_t index) noexcept {
+        assert(index < GetSize());
+        return *Locate(index);
+    }
+
+    const Type& operator[](size_t index) const noexcept {
+        assert(index < GetSize());
+        return *Locate(index);
+    }
+
+    Type& At(size_t index) {
+        if (index >= GetSize()) {
+            throw std::out_of_range("Index out of range");
+        }
+        return *Locate(index);
+    }
+
+    const Type& At(size_t index) const {
+        if (index >= GetSize()) {
+            throw std::out_of_range("Index out of range");
+        }
+        return *Locate(index);
+    }
+
+    // begin() and end() taken together see the elements published before
+    // end() was called, however many producers keep appending
+    Iterator begin() noexcept {
+        return Iterator(this, 0);
+    }
+
+    Iterator end() noexcept {
+        return Iterator(this, GetSize());
+    }
+
+    ConstIterator begin() const noexcept {
+        return ConstIterator(this, 0);
+    }
+
+    ConstIterator end() const noexcept {
+        return ConstIterator(this, GetSize());
+    }
+
+    ConstIterator cbegin() const noexcept {
+        return begin();
+    }
+
+    ConstIterator cend() const noexcept {
+        return end();
+    }
+
+private:
+    using FlagAllocator = typename std::allocator_traits<Alloc>::template rebind_alloc<std::atomic<bool>>;
+
+    struct Segment {
+        Segment(size_t size, const Alloc& alloc)
+            : items(size, alloc), ready(size, FlagAllocator(alloc)) {
+            ready.UninitializedValueConstruct(ready.Get(), size);
+        }
+
+        ArrayPtr<Type, Alloc> items;
+        // ready[i] is set once items[i] has been constructed
+        ArrayPtr<std::atomic<bool>, FlagAllocator> ready;
+    };
+
+    static constexpr size_t kFirstSegmentBits = 3;
+    static_assert(kFirstSegment == size_t{1} << kFirstSegmentBits);
+    // enough segments to address every size_t index
+    static constexpr size_t kMaxSegments = sizeof(size_t) * 8 - kFirstSegmentBits;
+
+    static size_t HighestBit(size_t value) noexcept {
+        return sizeof(size_t) * 8 - 1 - __builtin_clzl(value);
+    }
+
+    // Segment k holds the indices [kFirstSegment * (2^k - 1), kFirstSegment * (2^(k+1) - 1))
+    static size_t SegmentOf(size_t index) noexcept {
+        return HighestBit(index + kFirstSegment) - kFirstSegmentBits;
+    }
+
+    static size_t SegmentStart(size_t segment) noexcept {
+        return (kFirstSegment << segment) - kFirstSegment;
+    }
+
+    static size_t SegmentSize(size_t segment) noexcept {
+        return kFirstSegment << segment;
+    }
+
+    // Number of segments needed to hold size elements
+    static size_t SegmentCount(size_t size) noexcept {
+        return size == 0 ? 0 : SegmentOf(size - 1) + 1;
+    }
+
+    // Returns the segment, allocating it if no other thread has done so yet
+    Segment& AcquireSegment(size_t index) {
+        if (index >= kMaxSegments) {
+            throw std::length_error("ConcurrentSimpleVector is too long");
+        }
+        Segment* segment = segments_[index].load(std::memory_order_acquire);
+        if (segment) {
+            return *segment;
+        }
+        auto fresh = std::make_unique<Segment>(SegmentSize(index), alloc_);
+        if (segments_[index].compare_exchange_strong(segment, fresh.get(), std::memory_order_acq_rel)) {
+            return *fresh.release();
+        }
+        // another thread installed its segment first; ours is freed
+        return *segment;
+    }
+
+    Type* Locate(size_t index) const noexcept {
+        const size_t segment = SegmentOf(index);
+        return segments_[segment].load(std::memory_order_acquire)->items.Get() + (index - SegmentStart(segment));
+    }
+
+    bool IsReady(size_t index) const noexcept {
+        const size_t segment = SegmentOf(index);
+        const Segment* owner = segments_[segment].load(std::memory_order_acquire);
+        return owner && owner->ready[index - SegmentStart(segment)].load(std::memory_order_acquire);
+    }
+
+    // The segment is acquired before the slot is claimed: AcquireSegment may
+    // throw, and a claimed slot that is never published would hide every
+    // element after it. Hence a CAS loop rather than a fetch_add.
+    template <typename ConstructSlot>
+    Type& Publish(ConstructSlot construct_slot) {
+        size_t index = reserved_.load(std::memory_order_relaxed);
+        size_t segment_index;
+        Segment* segment;
+        do {
+            segment_index = SegmentOf(index);
+            segment = &AcquireSegment(segment_index);
+        } while (!reserved_.compare_exchange_weak(index, index + 1, std::memory_order_relaxed));
+        const size_t offset = index - SegmentStart(segment_index);
+        Type* slot = segment->items.Get() + offset;
+        construct_slot(*segment, slot);
+        segment->ready[offset].store(true, std::memory_order_release);
+        return *slot;
+    }
+
+    template <typename ValueType>
+    class BasicIterator {
+        using Owner = std::conditional_t<std::is_const_v<ValueType>, const ConcurrentSimpleVector,
+                                         ConcurrentSimpleVector>;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::remove_const_t<ValueType>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = ValueType*;
+        using reference = ValueType&;
+
+        BasicIterator() noexcept = default;
+
+        BasicIterator(Owner* owner, size_t index) noexcept
+            : owner_(owner), index_(index) {}
+
+        // Iterator converts to ConstIterator
+        template <typename Other, typename = std::enable_if_t<std::is_same_v<ValueType, const Other>>>
+        BasicIterator(const BasicIterator<Other>& other) noexcept
+            : owner_(other.owner_), index_(other.index_), item_(other.item_), segment_end_(other.segment_end_) {}
+
+        reference operator*() const noexcept {
+            if (item_ == nullptr) {
+                Locate();
+            }
+            return *item_;
+        }
+
+        pointer operator->() const noexcept {
+            return &**this;
+        }
+
+        // Walks a segment with a plain pointer; the segment table is consulted
+        // only when crossing into the next segment
+        BasicIterator& operator++() noexcept {
+            ++index_;
+            if (item_ != nullptr && ++item_ == segment_end_) {
+                item_ = nullptr;
+            }
+            return *this;
+        }
+
+        BasicIterator operator++(int) noexcept {
+            BasicIterator copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        friend bool operator==(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+            return lhs.index_ == rhs.index_;
+        }
+
+        friend bool operator!=(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+            return !(lhs == rhs);
+        }
+
+    private:
+        template <typename>
+        friend class BasicIterator;
+
+        void Locate() const noexcept {
+            const size_t segment = SegmentOf(index_);
+            item_ = owner_->Locate(index_);
+            segment_end_ = item_ + (SegmentStart(segment) + SegmentSize(segment) - index_);
+        }
+
+        Owner* owner_ = nullptr;
+        size_t index_ = 0;
+        mutable ValueType* item_ = nullptr;
+        mutable ValueType* segment_end_ = nullptr;
+    };
+
+    Alloc alloc_;
+    std::atomic<Segment*> segments_[kMaxSegments] = {};
+    // slots handed out to producers
+    std::atomic<size_t> reserved_{0};
+    // every element below this index is known to be constructed
+    mutable std::atomic<size_t> published_{0};
+};
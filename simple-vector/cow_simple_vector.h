@@ -0,0 +1,312 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include "growth_policy.h"
+#include "simple_vector.h"
+#include "simple_vector_view.h"
+
+// Copy-on-write SimpleVector: copies share one reference-counted buffer, so
+// fanning a read-mostly vector out to many owners costs an atomic increment
+// instead of an allocation and a copy. The first mutating call on a shared
+// copy (non-const operator[], At, begin/end, PushBack, Insert, Erase, Resize,
+// ...) detaches it onto a private buffer; a vector that is the only owner is
+// mutated in place.
+//
+// The reference count is atomic, so copies of one vector may live and be
+// mutated on different threads, with the same rules as std::shared_ptr: one
+// CowSimpleVector object is not to be used concurrently. Detaching
+// invalidates the iterators and references handed out before, as
+// reallocation does.
+//
+// A reference or iterator for writing (non-const operator[], At, begin/end,
+// Mutable, the results of EmplaceBack, Insert and Erase) would let a write
+// reach copies made after it was taken. So, as with the old copy-on-write
+// std::string, handing one out marks the buffer unshareable: later copies
+// get a buffer of their own, until Clear makes it shareable again.
+template <typename Type, typename Alloc = std::allocator<Type>, typename Growth = DoublingGrowth>
+class CowSimpleVector {
+public:
+    using Vector = SimpleVector<Type, Alloc, Growth>;
+    using Iterator = Type*;
+    using ConstIterator = const Type*;
+
+    CowSimpleVector() noexcept = default;
+
+    // Takes over the elements of items
+    explicit CowSimpleVector(Vector items)
+        : buffer_(new Buffer(std::move(items))) {}
+
+    explicit CowSimpleVector(size_t size)
+        : CowSimpleVector(Vector(size)) {}
+
+    CowSimpleVector(size_t size, const Type& value)
+        : CowSimpleVector(Vector(size, value)) {}
+
+    CowSimpleVector(std::initializer_list<Type> init)
+        : CowSimpleVector(Vector(init)) {}
+
+    CowSimpleVector(const CowSimpleVector& other)
+        : buffer_(other.buffer_) {
+        if (buffer_ && !buffer_->shareable) {
+            buffer_ = new Buffer(Vector(other.buffer_->items));
+        } else if (buffer_) {
+            buffer_->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    CowSimpleVector(CowSimpleVector&& other) noexcept
+        : buffer_(std::exchange(other.buffer_, nullptr)) {}
+
+    CowSimpleVector& operator=(const CowSimpleVector& rhs) {
+        CowSimpleVector(rhs).swap(*this);
+        return *this;
+    }
+
+    CowSimpleVector& operator=(CowSimpleVector&& rhs) noexcept {
+        CowSimpleVector(std::move(rhs)).swap(*this);
+        return *this;
+    }
+
+    ~CowSimpleVector() {
+        Release();
+    }
+
+    // Reading never detaches
+    const Vector& Get() const noexcept {
+        return buffer_ ? buffer_->items : EmptyVector();
+    }
+
+    // The vector for in-place updates, detached from the other copies first.
+    // The buffer stays unshareable while the result may be in use.
+    Vector& Mutable() {
+        Detach();
+        buffer_->shareable = false;
+        return buffer_->items;
+    }
+
+    // True when another copy shares the buffer
+    bool IsShared() const noexcept {
+        return GetUseCount() > 1;
+    }
+
+    // Number of copies sharing the buffer; 0 for a vector without one. Like
+    // shared_ptr::use_count, only a hint while other threads copy.
+    size_t GetUseCount() const noexcept {
+        return buffer_ ? buffer_->refs.load(std::memory_order_relaxed) : 0;
+    }
+
+    size_t GetSize() const noexcept {
+        return Get().GetSize();
+    }
+
+    size_t GetCapacity() const noexcept {
+        return Get().GetCapacity();
+    }
+
+    bool IsEmpty() const noexcept {
+        return Get().IsEmpty();
+    }
+
+    const Type& operator[](size_t index) const noexcept {
+        assert(index < GetSize());
+        return Get()[index];
+    }
+
+    Type& operator[](size_t index) {
+        assert(index < GetSize());
+        return Mutable()[index];
+    }
+
+    const Type& At(size_t index) const {
+        return Get().At(index);
+    }
+
+    Type& At(size_t index) {
+        if (index >= GetSize()) {
+            throw std::out_of_range("Index out of range");
+        }
+        return Mutable()[index];
+    }
+
+    void Reserve(size_t new_capacity) {
+        if (new_capacity > GetCapacity()) {
+            Items().Reserve(new_capacity);
+        }
+    }
+
+    void Resize(size_t new_size) {
+        Items().Resize(new_size);
+    }
+
+    // A sole owner keeps its capacity; a shared copy just lets go of the
+    // buffer instead of copying it first
+    void Clear() noexcept {
+        if (buffer_ && buffer_->refs.load(std::memory_order_acquire) == 1) {
+            buffer_->items.Clear();
+            // nothing is left for an earlier reference to write to
+            buffer_->shareable = true;
+        } else {
+            Release();
+        }
+    }
+
+    void PushBack(const Type& item) {
+        Items().PushBack(item);
+    }
+
+    void PushBack(Type&& item) {
+        Items().PushBack(std::move(item));
+    }
+
+    template <typename... Args>
+    Type& EmplaceBack(Args&&... args) {
+        return Mutable().EmplaceBack(std::forward<Args>(args)...);
+    }
+
+    void PopBack() {
+        assert(!IsEmpty());
+        Items().PopBack();
+    }
+
+    // pos may come from before the detach, so it is carried over as an offset
+    Iterator Insert(ConstIterator pos, const Type& value) {
+        const size_t offset = pos - cbegin();
+        Vector& items = Mutable();
+        return items.Insert(items.begin() + offset, value);
+    }
+
+    Iterator Insert(ConstIterator pos, Type&& value) {
+        const size_t offset = pos - cbegin();
+        Vector& items = Mutable();
+        return items.Insert(items.begin() + offset, std::move(value));
+    }
+
+    Iterator Erase(ConstIterator pos) {
+        return Erase(pos, pos + 1);
+    }
+
+    Iterator Erase(ConstIterator first, ConstIterator last) {
+        const size_t offset = first - cbegin();
+        const size_t count = last - first;
+        Vector& items = Mutable();
+        return items.Erase(items.begin() + offset, items.begin() + offset + count);
+    }
+
+    void swap(CowSimpleVector& other) noexcept {
+        std::swap(buffer_, other.buffer_);
+    }
+
+    SimpleVectorView<const Type> View() const noexcept {
+        return Get().View();
+    }
+
+    Iterator begin() {
+        return Mutable().begin();
+    }
+
+    Iterator end() {
+        return Mutable().end();
+    }
+
+    ConstIterator begin() const noexcept {
+        return Get().begin();
+    }
+
+    ConstIterator end() const noexcept {
+        return Get().end();
+    }
+
+    ConstIterator cbegin() const noexcept {
+        return begin();
+    }
+
+    ConstIterator cend() const noexcept {
+        return end();
+    }
+
+private:
+    struct Buffer {
+        explicit Buffer(Vector&& vector)
+            : items(std::move(vector)) {}
+
+        std::atomic<size_t> refs{1};
+        // false once a reference for writing has been handed out; only ever
+        // touched by the sole owner
+        bool shareable = true;
+        Vector items;
+    };
+
+    static const Vector& EmptyVector() noexcept {
+        static const Vector empty;
+        return empty;
+    }
+
+    // The vector for an update that hands nothing out, so the buffer stays
+    // shareable
+    Vector& Items() {
+        Detach();
+        return buffer_->items;
+    }
+
+    // Makes this copy the sole owner of its buffer. The acquire pairs with
+    // the release in Release(), so the writes other owners made before
+    // letting go are visible before this one starts mutating.
+    void Detach() {
+        if (!buffer_) {
+            buffer_ = new Buffer(Vector());
+        } else if (buffer_->refs.load(std::memory_order_acquire) != 1) {
+            Buffer* copy = new Buffer(Vector(buffer_->items));
+            Release();
+            buffer_ = copy;
+        }
+    }
+
+    void Release() noexcept {
+        if (buffer_ && buffer_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete buffer_;
+        }
+        buffer_ = nullptr;
+    }
+
+    Buffer* buffer_ = nullptr;
+};
+
+// Only the pointer to the shared buffer lives in the object
+template <typename Type, typename Alloc, typename Growth>
+struct IsTriviallyRelocatable<CowSimpleVector<Type, Alloc, Growth>> : std::true_type {};
+
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator==(const CowSimpleVector<Type, Alloc, Growth>& lhs, const CowSimpleVector<Type, Alloc, Growth>& rhs) {
+    return lhs.Get() == rhs.Get();
+}
+
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator!=(const CowSimpleVector<Type, Alloc, Growth>& lhs, const CowSimpleVector<Type, Alloc, Growth>& rhs) {
+    return !(lhs == rhs);
+}
+
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator<(const CowSimpleVector<Type, Alloc, Growth>& lhs, const CowSimpleVector<Type, Alloc, Growth>& rhs) {
+    return lhs.Get() < rhs.Get();
+}
+
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator<=(const CowSimpleVector<Type, Alloc, Growth>& lhs, const CowSimpleVector<Type, Alloc, Growth>& rhs) {
+    return !(rhs < lhs);
+}
+
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator>(const CowSimpleVector<Type, Alloc, Growth>& lhs, const CowSimpleVector<Type, Alloc, Growth>& rhs) {
+    return rhs < lhs;
+}
+
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator>=(const CowSimpleVector<Type, Alloc, Growth>& lhs, const CowSimpleVector<Type, Alloc, Growth>& rhs) {
+    return !(lhs < rhs);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+// A growth policy tells SimpleVector how much to allocate once it runs out of
+// room: Capacity(current, required, element_size) returns the new capacity in
+// elements and must be at least `required`. SimpleVector clamps the result
+// to the allocator's max_size, so policies only need to avoid wrapping.
+
+inline size_t SaturatingAdd(size_t lhs, size_t rhs) noexcept {
+    return lhs > std::numeric_limits<size_t>::max() - rhs ? std::numeric_limits<size_t>::max() : lhs + rhs;
+}
+
+// 1, 2, 4, 8, ...
+struct DoublingGrowth {
+    static size_t Capacity(size_t current, size_t required, size_t) noexcept {
+        return std::max({required, SaturatingAdd(current, current), size_t{1}});
+    }
+};
+
+// 1, 2, 3, 4, 6, 9, 13, ...: at most 50% headroom, and freed blocks can be reused
+// for later growth steps
+struct OneAndHalfGrowth {
+    static size_t Capacity(size_t current, size_t required, size_t) noexcept {
+        return std::max({required, SaturatingAdd(current, current / 2), size_t{1}});
+    }
+};
+
+// Skips the tiny first steps: the first allocation holds at least MinCapacity elements
+template <size_t MinCapacity, typename Base = DoublingGrowth>
+struct MinFirstBlockGrowth {
+    static size_t Capacity(size_t current, size_t required, size_t element_size) noexcept {
+        size_t capacity = Base::Capacity(current, required, element_size);
+        return current == 0 ? std::max(capacity, MinCapacity) : capacity;
+    }
+};
+
+// Number of bytes glibc malloc actually hands out for a request of `bytes`:
+// small chunks are 16-byte aligned with an 8-byte header, mmapped chunks
+// (above the default 128 KiB threshold) are whole pages with a 16-byte header.
+inline size_t MallocUsableSize(size_t bytes) noexcept {
+    constexpr size_t kMmapThreshold = 128 * 1024;
+    constexpr size_t kPageSize = 4096;
+    if (bytes > std::numeric_limits<size_t>::max() - kPageSize - 16) {
+        return bytes;
+    }
+    if (bytes + 8 < kMmapThreshold) {
+        return std::max<size_t>((bytes + 8 + 15) & ~size_t{15}, 32) - 8;
+    }
+    return ((bytes + 16 + kPageSize - 1) & ~(kPageSize - 1)) - 16;
+}
+
+// Rounds the capacity chosen by Base up to the full usable size of the
+// malloc chunk, so the slack malloc would waste anyway holds elements
+template <typename Base = DoublingGrowth>
+struct SizeClassGrowth {
+    static size_t Capacity(size_t current, size_t required, size_t element_size) noexcept {
+        size_t capacity = Base::Capacity(current, required, element_size);
+        if (capacity > std::numeric_limits<size_t>::max() / element_size) {
+            return capacity;
+        }
+        return std::max(capacity, MallocUsableSize(capacity * element_size) / element_size);
+    }
+};
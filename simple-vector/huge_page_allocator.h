@@ -0,0 +1,238 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include "growth_policy.h"
+#include "simple_vector.h"
+
+#if defined(__linux__) && __has_include(<sys/mman.h>) && __has_include(<sys/syscall.h>) && __has_include(<unistd.h>)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HUGE_PAGE_ALLOCATOR_HAS_MMAP 1
+#endif
+
+// Storage mode for very large vectors: buffers of at least one huge page are
+// mapped directly, backed by huge pages and placed on chosen NUMA nodes.
+// Smaller buffers come from operator new as usual.
+//
+// Whatever the system refuses is skipped rather than failed: without
+// reserved hugetlb pages an explicit request falls back to transparent huge
+// pages, without THP the mapping keeps 4K pages, and a NUMA policy the
+// kernel rejects (single-node machine, no permission) leaves the default
+// first-touch placement. GetHugePageStats() tells what actually happened.
+
+enum class HugePages {
+    // plain mmap with 4K pages
+    kNone,
+    // a 2 MiB aligned mapping with MADV_HUGEPAGE
+    kTransparent,
+    // MAP_HUGETLB from the reserved pool, in 2 MiB or 1 GiB pages
+    kExplicit2M,
+    kExplicit1G,
+};
+
+enum class NumaPolicy {
+    // no policy: each page lands on the node of the thread that first
+    // touches it, e.g. the workers of SimpleVector(size, Parallel(n))
+    kFirstTouch,
+    // only the nodes in HugePageOptions::nodes
+    kBind,
+    // round-robin over the nodes, page by page
+    kInterleave,
+    // the first node in nodes while it has memory, others after that
+    kPreferred,
+};
+
+struct HugePageOptions {
+    HugePages pages = HugePages::kTransparent;
+    NumaPolicy numa = NumaPolicy::kFirstTouch;
+    // bit i selects NUMA node i; ignored for kFirstTouch
+    uint64_t nodes = 0;
+};
+
+// Process-wide counts of the large mappings made
+struct HugePageStats {
+    std::atomic<uint64_t> explicit_mappings{0};
+    std::atomic<uint64_t> transparent_mappings{0};
+    std::atomic<uint64_t> plain_mappings{0};
+    // explicit requests that had to fall back to transparent pages
+    std::atomic<uint64_t> hugetlb_fallbacks{0};
+    // NUMA policies the kernel rejected
+    std::atomic<uint64_t> numa_failures{0};
+};
+
+inline HugePageStats& GetHugePageStats() noexcept {
+    static HugePageStats stats;
+    return stats;
+}
+
+// Buffers of at least this many bytes are mapped, and their length is
+// rounded up to a multiple of it
+inline constexpr size_t HugePageSize(HugePages pages) noexcept {
+    return pages == HugePages::kExplicit1G ? size_t{1} << 30 : size_t{2} << 20;
+}
+
+#ifdef HUGE_PAGE_ALLOCATOR_HAS_MMAP
+namespace huge_page_detail {
+
+inline constexpr int kMapHugeShift = 26;
+
+inline void ApplyNumaPolicy(void* ptr, size_t bytes, const HugePageOptions& options) noexcept {
+    // the MPOL_* values of <numaif.h>, which is not always installed
+    constexpr int kMpolPreferred = 1;
+    constexpr int kMpolBind = 2;
+    constexpr int kMpolInterleave = 3;
+    if (options.numa == NumaPolicy::kFirstTouch) {
+        return;
+    }
+    int mode = options.numa == NumaPolicy::kBind ? kMpolBind
+               : options.numa == NumaPolicy::kInterleave ? kMpolInterleave
+                                                         : kMpolPreferred;
+    unsigned long mask = static_cast<unsigned long>(options.nodes);
+    if (options.nodes == 0 || syscall(SYS_mbind, ptr, bytes, mode, &mask, sizeof(mask) * 8 + 1, 0) != 0) {
+        GetHugePageStats().numa_failures.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// An anonymous mapping of bytes aligned to alignment: over-map, then cut off
+// the unaligned head and the tail
+inline void* MapAligned(size_t bytes, size_t alignment) noexcept {
+    void* raw = mmap(nullptr, bytes + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+    uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (begin + alignment - 1) & ~(alignment - 1);
+    if (aligned > begin) {
+        munmap(raw, aligned - begin);
+    }
+    size_t tail = begin + bytes + alignment - (aligned + bytes);
+    if (tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+
+// bytes is a multiple of HugePageSize(options.pages); nullptr on failure
+inline void* MapHugePages(size_t bytes, const HugePageOptions& options) noexcept {
+    HugePageStats& stats = GetHugePageStats();
+    HugePages pages = options.pages;
+    void* ptr = nullptr;
+    if (pages == HugePages::kExplicit2M || pages == HugePages::kExplicit1G) {
+#ifdef MAP_HUGETLB
+        const int size_flag = (pages == HugePages::kExplicit1G ? 30 : 21) << kMapHugeShift;
+        ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1, 0);
+        if (ptr != MAP_FAILED) {
+            stats.explicit_mappings.fetch_add(1, std::memory_order_relaxed);
+            ApplyNumaPolicy(ptr, bytes, options);
+            return ptr;
+        }
+#endif
+        stats.hugetlb_fallbacks.fetch_add(1, std::memory_order_relaxed);
+        pages = HugePages::kTransparent;
+    }
+    ptr = MapAligned(bytes, pages == HugePages::kNone ? static_cast<size_t>(sysconf(_SC_PAGESIZE))
+                                                      : HugePageSize(HugePages::kTransparent));
+    if (!ptr) {
+        return nullptr;
+    }
+#ifdef MADV_HUGEPAGE
+    if (pages == HugePages::kTransparent && madvise(ptr, bytes, MADV_HUGEPAGE) == 0) {
+        stats.transparent_mappings.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        stats.plain_mappings.fetch_add(1, std::memory_order_relaxed);
+    }
+#else
+    stats.plain_mappings.fetch_add(1, std::memory_order_relaxed);
+#endif
+    // before the first touch, so that no page is placed yet
+    ApplyNumaPolicy(ptr, bytes, options);
+    return ptr;
+}
+
+}  // namespace huge_page_detail
+#endif
+
+template <typename Type>
+class HugePageAllocator {
+public:
+    using value_type = Type;
+
+    HugePageAllocator() noexcept = default;
+
+    explicit HugePageAllocator(const HugePageOptions& options) noexcept
+        : options_(options) {}
+
+    template <typename Other>
+    HugePageAllocator(const HugePageAllocator<Other>& other) noexcept
+        : options_(other.GetOptions()) {}
+
+    const HugePageOptions& GetOptions() const noexcept {
+        return options_;
+    }
+
+    Type* allocate(size_t n) {
+        // leaves room for rounding up to a whole huge page
+        if (n > (std::numeric_limits<size_t>::max() - HugePageSize(HugePages::kExplicit1G)) / sizeof(Type)) {
+            throw std::bad_array_new_length();
+        }
+        const size_t bytes = n * sizeof(Type);
+#ifdef HUGE_PAGE_ALLOCATOR_HAS_MMAP
+        if (IsMapped(bytes)) {
+            void* ptr = huge_page_detail::MapHugePages(MappedBytes(bytes), options_);
+            if (!ptr) {
+                throw std::bad_alloc();
+            }
+            return static_cast<Type*>(ptr);
+        }
+#endif
+        return static_cast<Type*>(::operator new(bytes));
+    }
+
+    void deallocate(Type* ptr, size_t n) noexcept {
+        const size_t bytes = n * sizeof(Type);
+#ifdef HUGE_PAGE_ALLOCATOR_HAS_MMAP
+        if (IsMapped(bytes)) {
+            munmap(ptr, MappedBytes(bytes));
+            return;
+        }
+#endif
+        ::operator delete(ptr, bytes);
+    }
+
+    // Whether a buffer of bytes bypasses operator new
+    bool IsMapped(size_t bytes) const noexcept {
+#ifdef HUGE_PAGE_ALLOCATOR_HAS_MMAP
+        return bytes >= HugePageSize(options_.pages);
+#else
+        (void)bytes;
+        return false;
+#endif
+    }
+
+    // Only the page size decides how a buffer is freed
+    template <typename Other>
+    bool operator==(const HugePageAllocator<Other>& other) const noexcept {
+        return HugePageSize(options_.pages) == HugePageSize(other.GetOptions().pages);
+    }
+
+    template <typename Other>
+    bool operator!=(const HugePageAllocator<Other>& other) const noexcept {
+        return !(*this == other);
+    }
+
+private:
+    size_t MappedBytes(size_t bytes) const noexcept {
+        const size_t page = HugePageSize(options_.pages);
+        return (bytes + page - 1) & ~(page - 1);
+    }
+
+    HugePageOptions options_;
+};
+
+template <typename Type, typename Growth = DoublingGrowth>
+using HugePageSimpleVector = SimpleVector<Type, HugePageAllocator<Type>, Growth>;
@@ -0,0 +1,172 @@
+#pragma once
+
+// Opt-in counters for the vectors' hot paths. Build with
+// -DSIMPLE_VECTOR_INSTRUMENTATION to record, per call site, allocations,
+// bytes allocated, reallocations, elements moved by growth, elements shifted
+// by Insert/Erase and the peak buffer size. Without the macro every hook
+// below expands to nothing.
+//
+// A call site is tagged with SIMPLE_VECTOR_CALL_SITE("name") at the top of a
+// scope: everything any vector does on this thread until the scope ends is
+// counted under "name". Work outside any tagged scope goes to "untagged".
+// The totals live in InstrumentationRegistry::Instance(), which can be
+// dumped as text or walked with ForEach to feed a metrics system.
+
+#ifdef SIMPLE_VECTOR_INSTRUMENTATION
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+
+struct VectorCountersSnapshot {
+    uint64_t allocations = 0;
+    uint64_t bytes_allocated = 0;
+    uint64_t reallocations = 0;
+    uint64_t elements_moved = 0;
+    uint64_t elements_shifted = 0;
+    uint64_t peak_capacity_bytes = 0;
+};
+
+struct VectorCounters {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes_allocated{0};
+    // growths of a buffer that already existed
+    std::atomic<uint64_t> reallocations{0};
+    // elements relocated to a new buffer by growth
+    std::atomic<uint64_t> elements_moved{0};
+    // elements moved within the buffer to open or close a gap
+    std::atomic<uint64_t> elements_shifted{0};
+    // the largest single buffer allocated
+    std::atomic<uint64_t> peak_capacity_bytes{0};
+
+    void RecordAllocation(size_t bytes) noexcept {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+        uint64_t peak = peak_capacity_bytes.load(std::memory_order_relaxed);
+        while (bytes > peak && !peak_capacity_bytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+        }
+    }
+
+    VectorCountersSnapshot Snapshot() const noexcept {
+        return {allocations.load(std::memory_order_relaxed),     bytes_allocated.load(std::memory_order_relaxed),
+                reallocations.load(std::memory_order_relaxed),   elements_moved.load(std::memory_order_relaxed),
+                elements_shifted.load(std::memory_order_relaxed), peak_capacity_bytes.load(std::memory_order_relaxed)};
+    }
+
+    void Reset() noexcept {
+        allocations = 0;
+        bytes_allocated = 0;
+        reallocations = 0;
+        elements_moved = 0;
+        elements_shifted = 0;
+        peak_capacity_bytes = 0;
+    }
+};
+
+class InstrumentationRegistry {
+public:
+    static InstrumentationRegistry& Instance() {
+        static InstrumentationRegistry registry;
+        return registry;
+    }
+
+    // The counters for tag, created on first use. The reference stays
+    // valid for the lifetime of the program.
+    VectorCounters& Get(const std::string& tag) {
+        std::lock_guard lock(mutex_);
+        return counters_[tag];
+    }
+
+    // Calls visit(tag, snapshot) for every tag in alphabetical order
+    template <typename Visitor>
+    void ForEach(Visitor visit) const {
+        std::lock_guard lock(mutex_);
+        for (const auto& [tag, counters] : counters_) {
+            visit(tag, counters.Snapshot());
+        }
+    }
+
+    // One line per tag: "tag allocations=... bytes_allocated=... ..."
+    void Dump(std::ostream& out) const {
+        ForEach([&out](const std::string& tag, const VectorCountersSnapshot& counters) {
+            out << tag << " allocations=" << counters.allocations << " bytes_allocated=" << counters.bytes_allocated
+                << " reallocations=" << counters.reallocations << " elements_moved=" << counters.elements_moved
+                << " elements_shifted=" << counters.elements_shifted
+                << " peak_capacity_bytes=" << counters.peak_capacity_bytes << '\n';
+        });
+    }
+
+    // Zeroes every counter; the tags stay registered
+    void Reset() {
+        std::lock_guard lock(mutex_);
+        for (auto& [tag, counters] : counters_) {
+            counters.Reset();
+        }
+    }
+
+private:
+    InstrumentationRegistry() = default;
+
+    mutable std::mutex mutex_;
+    // std::map never moves its values, so the references handed out stay put
+    std::map<std::string, VectorCounters> counters_;
+};
+
+inline VectorCounters*& CurrentCallSite() noexcept {
+    thread_local VectorCounters* current = nullptr;
+    return current;
+}
+
+// The counters of the innermost tagged scope on this thread
+inline VectorCounters& CurrentVectorCounters() {
+    VectorCounters* current = CurrentCallSite();
+    if (current) {
+        return *current;
+    }
+    static VectorCounters& untagged = InstrumentationRegistry::Instance().Get("untagged");
+    return untagged;
+}
+
+// Makes counters the current ones until the end of the scope
+class CallSiteScope {
+public:
+    explicit CallSiteScope(VectorCounters& counters) noexcept
+        : previous_(std::exchange(CurrentCallSite(), &counters)) {}
+
+    CallSiteScope(const CallSiteScope&) = delete;
+    CallSiteScope& operator=(const CallSiteScope&) = delete;
+
+    ~CallSiteScope() {
+        CurrentCallSite() = previous_;
+    }
+
+private:
+    VectorCounters* previous_;
+};
+
+#define SIMPLE_VECTOR_CONCAT_IMPL(a, b) a##b
+#define SIMPLE_VECTOR_CONCAT(a, b) SIMPLE_VECTOR_CONCAT_IMPL(a, b)
+
+// The tag is looked up once per call site, so it should be a literal
+#define SIMPLE_VECTOR_CALL_SITE(tag)                                                 \
+    static VectorCounters& SIMPLE_VECTOR_CONCAT(simple_vector_site_, __LINE__) =     \
+        InstrumentationRegistry::Instance().Get(tag);                                \
+    CallSiteScope SIMPLE_VECTOR_CONCAT(simple_vector_scope_, __LINE__)(              \
+        SIMPLE_VECTOR_CONCAT(simple_vector_site_, __LINE__))
+
+#define SIMPLE_VECTOR_COUNT_ALLOCATION(bytes) CurrentVectorCounters().RecordAllocation(bytes)
+#define SIMPLE_VECTOR_COUNT(counter, amount) \
+    CurrentVectorCounters().counter.fetch_add((amount), std::memory_order_relaxed)
+
+#else
+
+#define SIMPLE_VECTOR_CALL_SITE(tag) static_cast<void>(0)
+#define SIMPLE_VECTOR_COUNT_ALLOCATION(bytes) static_cast<void>(0)
+#define SIMPLE_VECTOR_COUNT(counter, amount) static_cast<void>(0)
+
+#endif
@@ -1,13 +1,49 @@
+// the functional tests also check the instrumentation counters
+#define SIMPLE_VECTOR_INSTRUMENTATION
 #include "simple_vector.h"
+#include "parallel_algorithms.h"
+#include "malloc_allocator.h"
+#include "aligned_allocator.h"
+#include "soa_simple_vector.h"
+#include "cow_simple_vector.h"
+#include "pool_allocator.h"
+#include "static_simple_vector.h"
+#include "huge_page_allocator.h"
+#include "sorted_simple_vector.h"
+#include "channel.h"
+#include "vector_expression.h"
+#include "small_simple_vector.h"
+#include "concurrent_simple_vector.h"
+#include "chunked_simple_vector.h"
+#include "mapped_simple_vector.h"
+#include "serialization.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
 #include <iostream>
+#include <list>
+#include <random>
 #include <numeric>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace std;
 
 class X {
 public:
+    inline static size_t moves = 0;
+
     X()
         : X(5) {
     }
@@ -18,9 +54,11 @@ public:
     X& operator=(const X& other) = delete;
     X(X&& other) {
         x_ = exchange(other.x_, 0);
+        ++moves;
     }
     X& operator=(X&& other) {
         x_ = exchange(other.x_, 0);
+        ++moves;
         return *this;
     }
     size_t GetX() const {
@@ -31,6 +69,131 @@ private:
     size_t x_;
 };
 
+struct LifetimeCounter {
+    inline static size_t default_constructed = 0;
+    inline static size_t alive = 0;
+
+    LifetimeCounter() {
+        ++default_constructed;
+        ++alive;
+    }
+    LifetimeCounter(const LifetimeCounter&) {
+        ++alive;
+    }
+    LifetimeCounter& operator=(const LifetimeCounter&) = default;
+    ~LifetimeCounter() {
+        --alive;
+    }
+
+    static void Reset() {
+        default_constructed = 0;
+        alive = 0;
+    }
+};
+
+class NoDefault {
+public:
+    explicit NoDefault(int value)
+        : value_(value) {
+    }
+    int GetValue() const {
+        return value_;
+    }
+
+private:
+    int value_;
+};
+
+struct AllocationStats {
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t live_bytes = 0;
+};
+
+// Stateful allocator: instances with different stats compare unequal
+template <typename Type, bool Propagate>
+class TrackingAllocator {
+public:
+    using value_type = Type;
+    using propagate_on_container_copy_assignment = std::bool_constant<Propagate>;
+    using propagate_on_container_move_assignment = std::bool_constant<Propagate>;
+    using propagate_on_container_swap = std::bool_constant<Propagate>;
+    template <typename Other>
+    struct rebind {
+        using other = TrackingAllocator<Other, Propagate>;
+    };
+
+    explicit TrackingAllocator(AllocationStats* stats)
+        : stats_(stats) {
+    }
+    template <typename Other>
+    TrackingAllocator(const TrackingAllocator<Other, Propagate>& other)
+        : stats_(other.GetStats()) {
+    }
+
+    Type* allocate(size_t n) {
+        ++stats_->allocations;
+        stats_->live_bytes += n * sizeof(Type);
+        return allocator<Type>().allocate(n);
+    }
+    void deallocate(Type* p, size_t n) {
+        ++stats_->deallocations;
+        stats_->live_bytes -= n * sizeof(Type);
+        allocator<Type>().deallocate(p, n);
+    }
+
+    AllocationStats* GetStats() const {
+        return stats_;
+    }
+
+    bool operator==(const TrackingAllocator& other) const {
+        return stats_ == other.stats_;
+    }
+    bool operator!=(const TrackingAllocator& other) const {
+        return stats_ != other.stats_;
+    }
+
+private:
+    AllocationStats* stats_;
+};
+
+struct MoveCounter {
+    inline static size_t copies = 0;
+    inline static size_t moves = 0;
+
+    MoveCounter(string name, int id)
+        : name(move(name)), id(id) {
+    }
+    MoveCounter(const MoveCounter& other)
+        : name(other.name), id(other.id) {
+        ++copies;
+    }
+    MoveCounter(MoveCounter&& other) noexcept
+        : name(move(other.name)), id(other.id) {
+        ++moves;
+    }
+    MoveCounter& operator=(const MoveCounter& other) {
+        name = other.name;
+        id = other.id;
+        ++copies;
+        return *this;
+    }
+    MoveCounter& operator=(MoveCounter&& other) noexcept {
+        name = move(other.name);
+        id = other.id;
+        ++moves;
+        return *this;
+    }
+
+    static void Reset() {
+        copies = 0;
+        moves = 0;
+    }
+
+    string name;
+    int id;
+};
+
 SimpleVector<int> GenerateVector(size_t size) {
     SimpleVector<int> v(size);
     iota(v.begin(), v.end(), 1);
@@ -133,6 +296,11 @@ void TestNoncopiableInsert() {
     v.Insert(v.begin() + 3, X(size + 3));
     assert(v.GetSize() == size + 3);
     assert((v.begin() + 3)->GetX() == size + 3);
+    // перед последним, без перевыделения
+    v.Reserve(v.GetSize() + 1);
+    v.Insert(v.end() - 1, X(size + 4));
+    assert(v.GetSize() == size + 4);
+    assert((v.end() - 2)->GetX() == size + 4 && (v.end() - 1)->GetX() == size + 2);
     cout << "Done!" << endl << endl;
 }
 
@@ -149,6 +317,2433 @@ void TestNoncopiableErase() {
     cout << "Done!" << endl << endl;
 }
 
+void TestReserveDoesNotConstruct() {
+    cout << "Test reserve does not construct elements" << endl;
+    LifetimeCounter::Reset();
+    {
+        SimpleVector<LifetimeCounter> v(Reserve(1000));
+        assert(LifetimeCounter::default_constructed == 0);
+        v.Reserve(100000);
+        assert(LifetimeCounter::default_constructed == 0);
+        for (size_t i = 0; i < 10; ++i) {
+            v.PushBack(LifetimeCounter());
+        }
+        assert(LifetimeCounter::alive == 10);
+        v.PopBack();
+        assert(LifetimeCounter::alive == 9);
+        v.Erase(v.begin());
+        assert(LifetimeCounter::alive == 8);
+        v.Resize(3);
+        assert(LifetimeCounter::alive == 3);
+        v.Resize(5);
+        assert(LifetimeCounter::alive == 5);
+        v.Clear();
+        assert(LifetimeCounter::alive == 0);
+        v.Resize(4);
+    }
+    assert(LifetimeCounter::alive == 0);
+    cout << "Done!" << endl << endl;
+}
+
+void TestNoDefaultConstructible() {
+    cout << "Test type without default constructor" << endl;
+    SimpleVector<NoDefault> v;
+    for (int i = 0; i < 5; ++i) {
+        v.PushBack(NoDefault(i));
+    }
+    v.Insert(v.begin() + 2, NoDefault(42));
+    assert(v.GetSize() == 6);
+    assert(v[2].GetValue() == 42);
+    v.Erase(v.begin());
+    assert(v.GetSize() == 5);
+    assert(v[0].GetValue() == 1);
+    SimpleVector<NoDefault> copy(v);
+    assert(copy.GetSize() == 5 && copy[1].GetValue() == 42);
+    cout << "Done!" << endl << endl;
+}
+
+void TestCustomAllocator() {
+    cout << "Test stateful allocator" << endl;
+    using Alloc = TrackingAllocator<int, false>;
+    AllocationStats stats_a;
+    AllocationStats stats_b;
+    {
+        SimpleVector<int, Alloc> a{Alloc(&stats_a)};
+        for (int i = 0; i < 100; ++i) {
+            a.PushBack(i);
+        }
+        a.Resize(300);
+        assert(stats_a.allocations > 0);
+        assert(stats_a.live_bytes == a.GetCapacity() * sizeof(int));
+
+        SimpleVector<int, Alloc> copy(a);
+        assert(copy.GetAllocator() == a.GetAllocator());
+
+        SimpleVector<int, Alloc> moved(std::move(copy));
+        assert(moved.GetAllocator().GetStats() == &stats_a);
+        assert(moved.GetSize() == 300 && moved[99] == 99);
+
+        // allocators differ and don't propagate: elements are moved into b's storage
+        SimpleVector<int, Alloc> b{Alloc(&stats_b)};
+        b = std::move(moved);
+        assert(b.GetAllocator().GetStats() == &stats_b);
+        assert(b.GetSize() == 300 && b[42] == 42);
+        assert(stats_b.live_bytes == b.GetCapacity() * sizeof(int));
+    }
+    assert(stats_a.live_bytes == 0 && stats_a.allocations == stats_a.deallocations);
+    assert(stats_b.live_bytes == 0 && stats_b.allocations == stats_b.deallocations);
+
+    using PropagatingAlloc = TrackingAllocator<int, true>;
+    {
+        SimpleVector<int, PropagatingAlloc> a(10, 1, PropagatingAlloc(&stats_a));
+        SimpleVector<int, PropagatingAlloc> b(20, 2, PropagatingAlloc(&stats_b));
+        a.swap(b);
+        assert(a.GetAllocator().GetStats() == &stats_b && a.GetSize() == 20);
+        assert(b.GetAllocator().GetStats() == &stats_a && b.GetSize() == 10);
+        b = a;
+        assert(b.GetAllocator().GetStats() == &stats_b && b.GetSize() == 20);
+    }
+    assert(stats_a.live_bytes == 0 && stats_b.live_bytes == 0);
+    cout << "Done!" << endl << endl;
+}
+
+void TestRangeInsert() {
+    cout << "Test range insert and append" << endl;
+    {
+        SimpleVector<int> v;
+        const vector<int> chunk = {1, 2, 3, 4};
+        v.Append(chunk.begin(), chunk.end());
+        v.Append(chunk.data(), chunk.data() + chunk.size());
+        assert(v.GetSize() == 8 && v[4] == 1 && v[7] == 4);
+
+        const list<int> middle = {10, 11};
+        v.Insert(v.begin() + 1, middle.begin(), middle.end());
+        assert((v == SimpleVector<int>{1, 10, 11, 2, 3, 4, 1, 2, 3, 4}));
+
+        istringstream input("7 8 9");
+        auto it = v.Insert(v.begin(), istream_iterator<int>(input), istream_iterator<int>());
+        assert(it == v.begin());
+        assert((v == SimpleVector<int>{7, 8, 9, 1, 10, 11, 2, 3, 4, 1, 2, 3, 4}));
+    }
+    {
+        // tail longer and shorter than the inserted range, without reallocation
+        SimpleVector<string> v{"a", "b", "c", "d"};
+        v.Reserve(20);
+        const string* capacity_data = v.begin();
+        const vector<string> two = {"x", "y"};
+        v.Insert(v.begin() + 1, two.begin(), two.end());
+        assert((v == SimpleVector<string>{"a", "x", "y", "b", "c", "d"}));
+        const vector<string> four = {"1", "2", "3", "4"};
+        v.Insert(v.end() - 1, four.begin(), four.end());
+        assert((v == SimpleVector<string>{"a", "x", "y", "b", "c", "1", "2", "3", "4", "d"}));
+        v.Insert(v.begin() + 2, 3, string("z"));
+        assert((v == SimpleVector<string>{"a", "x", "z", "z", "z", "y", "b", "c", "1", "2", "3", "4", "d"}));
+        assert(v.begin() == capacity_data);
+    }
+    {
+        // the whole range lands in one allocation
+        using Alloc = TrackingAllocator<int, false>;
+        AllocationStats stats;
+        SimpleVector<int, Alloc> v{Alloc(&stats)};
+        vector<int> batch(4096);
+        iota(batch.begin(), batch.end(), 0);
+        v.Append(batch.begin(), batch.end());
+        assert(stats.allocations == 1);
+        v.Insert(v.begin(), v.GetSize(), 5);
+        assert(stats.allocations == 2);
+        assert(v.GetSize() == 8192 && v[4095] == 5 && v[4096] == 0 && v[8191] == 4095);
+    }
+    {
+        // value refers to an element of the vector itself
+        SimpleVector<string> v{"first", "second"};
+        v.Insert(v.begin(), 5, v[1]);
+        assert(v.GetSize() == 7 && v[0] == "second" && v[5] == "first");
+        v.Insert(v.begin() + 1, 2, v[5]);
+        assert(v[1] == "first" && v[2] == "first" && v[3] == "second");
+    }
+    cout << "Done!" << endl << endl;
+}
+
+void TestEmplace() {
+    cout << "Test emplace" << endl;
+    SimpleVector<MoveCounter> v(Reserve(4));
+    MoveCounter::Reset();
+    MoveCounter& first = v.EmplaceBack("first", 1);
+    assert(&first == &v[0] && first.id == 1);
+    v.EmplaceBack("second", 2);
+    auto it = v.Emplace(v.end(), "third", 3);
+    assert(it->name == "third");
+    assert(MoveCounter::copies == 0 && MoveCounter::moves == 0);
+
+    it = v.Emplace(v.begin(), "zero", 0);
+    assert(it == v.begin() && v[0].name == "zero" && v[3].name == "third");
+    assert(MoveCounter::copies == 0);
+
+    // growth constructs the new element before moving the old ones away
+    assert(v.GetSize() == v.GetCapacity());
+    v.EmplaceBack(v[0]);
+    assert(v.GetSize() == 5 && v[4].name == "zero" && v[0].name == "zero");
+    it = v.Emplace(v.begin() + 1, v[3]);
+    assert(it->name == "third" && v[4].name == "third");
+
+    SimpleVector<X> xs;
+    xs.EmplaceBack(7);
+    xs.Emplace(xs.begin(), 3);
+    assert(xs[0].GetX() == 3 && xs[1].GetX() == 7);
+    cout << "Done!" << endl << endl;
+}
+
+struct TelemetryRecord {
+    uint64_t timestamp;
+    uint32_t sensor;
+    float value;
+};
+
+void TestTriviallyCopyableFastPaths() {
+    cout << "Test trivially copyable fast paths" << endl;
+    SimpleVector<TelemetryRecord, MallocAllocator<TelemetryRecord>> records;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        records.PushBack({i, i % 7, i * 0.5f});
+    }
+    records.Insert(records.begin(), TelemetryRecord{5000, 1, 1.0f});
+    records.Emplace(records.begin() + 10, records[0]);
+    records.Erase(records.begin() + 1);
+    assert(records.GetSize() == 1001);
+    assert(records[0].timestamp == 5000 && records[9].timestamp == 5000);
+    assert(records[1].timestamp == 1 && records[1000].timestamp == 999);
+
+    // reallocation through realloc keeps the contents
+    records.Reserve(100000);
+    records.Resize(2000);
+    assert(records[1000].timestamp == 999 && records[1999].timestamp == 0);
+
+    SimpleVector<int, MallocAllocator<int>> ints;
+    for (int i = 0; i < 10; ++i) {
+        ints.EmplaceBack(ints.IsEmpty() ? 0 : ints[0] + i);
+    }
+    assert(ints[9] == 9);
+    const int extra[] = {-1, -2, -3};
+    ints.Insert(ints.begin() + 2, begin(extra), end(extra));
+    ints.Insert(ints.begin(), 2, ints[12]);
+    assert((ints == SimpleVector<int, MallocAllocator<int>>{9, 9, 0, 1, -1, -2, -3, 2, 3, 4, 5, 6, 7, 8, 9}));
+    cout << "Done!" << endl << endl;
+}
+
+void TestSmallSimpleVector() {
+    cout << "Test small vector with inline storage" << endl;
+    {
+        SmallSimpleVector<string, 4> v;
+        assert(v.IsInline() && v.GetCapacity() == 4);
+        v.PushBack("b");
+        v.EmplaceBack("d");
+        v.Insert(v.begin(), "a");
+        v.Insert(v.begin() + 2, "c");
+        assert(v.IsInline() && (v == SmallSimpleVector<string, 4>{"a", "b", "c", "d"}));
+
+        // spills on overflow and keeps the order
+        v.EmplaceBack(v[0]);
+        assert(!v.IsInline() && v.GetSize() == 5);
+        assert((v == SmallSimpleVector<string, 4>{"a", "b", "c", "d", "a"}));
+        v.Erase(v.begin() + 1);
+        assert((v == SmallSimpleVector<string, 4>{"a", "c", "d", "a"}));
+        const vector<string> extra = {"x", "y"};
+        v.Insert(v.begin() + 1, extra.begin(), extra.end());
+        v.Insert(v.end(), 2, string("z"));
+        assert((v == SmallSimpleVector<string, 4>{"a", "x", "y", "c", "d", "a", "z", "z"}));
+        assert((v < SmallSimpleVector<string, 4>{"b"}));
+    }
+    {
+        // moving an inline vector moves the elements
+        SmallSimpleVector<X, 8> inline_vector;
+        for (size_t i = 0; i < 5; ++i) {
+            inline_vector.PushBack(X(i));
+        }
+        SmallSimpleVector<X, 8> moved(move(inline_vector));
+        assert(moved.IsInline() && moved.GetSize() == 5 && moved[4].GetX() == 4);
+        assert(inline_vector.GetSize() == 0);
+
+        // moving a heap vector steals the buffer
+        SmallSimpleVector<X, 8> heap_vector;
+        for (size_t i = 0; i < 20; ++i) {
+            heap_vector.PushBack(X(i));
+        }
+        const X* heap_data = heap_vector.begin();
+        SmallSimpleVector<X, 8> stolen(move(heap_vector));
+        assert(stolen.begin() == heap_data && stolen.GetSize() == 20);
+        assert(heap_vector.IsInline() && heap_vector.GetSize() == 0);
+
+        moved.swap(stolen);
+        assert(moved.GetSize() == 20 && moved[19].GetX() == 19);
+        assert(stolen.IsInline() && stolen.GetSize() == 5 && stolen[0].GetX() == 0);
+        stolen = move(moved);
+        assert(stolen.GetSize() == 20 && moved.GetSize() == 0);
+        heap_vector.PushBack(X(1));
+        heap_vector.Insert(heap_vector.begin(), X(0));
+        assert(heap_vector[0].GetX() == 0 && heap_vector[1].GetX() == 1);
+    }
+    {
+        SmallSimpleVector<NoDefault, 2> v;
+        for (int i = 0; i < 6; ++i) {
+            v.Emplace(v.begin(), i);
+        }
+        assert(v[0].GetValue() == 5 && v[5].GetValue() == 0);
+        SmallSimpleVector<NoDefault, 2> copy(v);
+        copy = v;
+        assert(copy.GetSize() == 6 && copy[2].GetValue() == 3);
+    }
+    {
+        // growing moves every element once, straight around the gap
+        SmallSimpleVector<MoveCounter, 4> v;
+        for (int i = 0; i < 4; ++i) {
+            v.EmplaceBack("x"s, i);
+        }
+        MoveCounter::Reset();
+        v.Emplace(v.begin() + 1, "y"s, -1);
+        assert(!v.IsInline() && MoveCounter::moves == 5 && MoveCounter::copies == 0);
+        assert(v[0].id == 0 && v[1].id == -1 && v[1].name == "y" && v[2].id == 1 && v[4].id == 3);
+
+        // a one-element tail is shifted by the construct alone
+        SmallSimpleVector<MoveCounter, 4> inline_vector;
+        inline_vector.EmplaceBack("a"s, 0);
+        inline_vector.EmplaceBack("c"s, 2);
+        MoveCounter::Reset();
+        inline_vector.Emplace(inline_vector.begin() + 1, "b"s, 1);
+        assert(MoveCounter::moves == 2 && inline_vector[1].id == 1 && inline_vector[2].id == 2);
+    }
+    {
+        // move-assignment from an inline vector still propagates the allocator
+        using PropagatingAlloc = TrackingAllocator<int, true>;
+        AllocationStats lhs_stats;
+        AllocationStats rhs_stats;
+        SmallSimpleVector<int, 2, PropagatingAlloc> lhs(PropagatingAlloc{&lhs_stats});
+        for (int i = 0; i < 5; ++i) {
+            lhs.PushBack(i);
+        }
+        SmallSimpleVector<int, 2, PropagatingAlloc> rhs(PropagatingAlloc{&rhs_stats});
+        rhs.PushBack(7);
+        lhs = move(rhs);
+        assert(lhs.IsInline() && lhs.GetSize() == 1 && lhs[0] == 7);
+        assert(lhs.GetAllocator() == PropagatingAlloc{&rhs_stats} && lhs_stats.live_bytes == 0);
+        lhs.PushBack(8);
+        lhs.PushBack(9);
+        assert(rhs_stats.live_bytes > 0 && lhs_stats.live_bytes == 0);
+    }
+    cout << "Done!" << endl << endl;
+}
+
+template <typename Growth>
+vector<size_t> CapacitySteps(size_t pushes) {
+    SimpleVector<int, allocator<int>, Growth> v;
+    vector<size_t> steps;
+    for (size_t i = 0; i < pushes; ++i) {
+        v.PushBack(static_cast<int>(i));
+        if (steps.empty() || steps.back() != v.GetCapacity()) {
+            steps.push_back(v.GetCapacity());
+        }
+    }
+    return steps;
+}
+
+void TestGrowthPolicies() {
+    cout << "Test growth policies" << endl;
+    assert((CapacitySteps<DoublingGrowth>(20) == vector<size_t>{1, 2, 4, 8, 16, 32}));
+    assert((CapacitySteps<OneAndHalfGrowth>(20) == vector<size_t>{1, 2, 3, 4, 6, 9, 13, 19, 28}));
+    assert((CapacitySteps<MinFirstBlockGrowth<16>>(40) == vector<size_t>{16, 32, 64}));
+    assert((CapacitySteps<MinFirstBlockGrowth<10, OneAndHalfGrowth>>(20) == vector<size_t>{10, 15, 22}));
+    // 4 bytes fit into the smallest 32-byte glibc chunk with 24 usable bytes
+    assert((CapacitySteps<SizeClassGrowth<>>(7)[0] == 6));
+    assert(MallocUsableSize(1000) == 1000 && MallocUsableSize(1001) == 1016);
+    assert(MallocUsableSize(200000) == 200688);
+
+    // growth doesn't wrap around near the top of size_t
+    const size_t huge = numeric_limits<size_t>::max() / 2 + 10;
+    assert(DoublingGrowth::Capacity(huge, huge + 1, 1) == numeric_limits<size_t>::max());
+    assert(OneAndHalfGrowth::Capacity(huge + huge / 2, huge, 1) == numeric_limits<size_t>::max());
+    assert(SizeClassGrowth<>::Capacity(huge, huge + 1, 8) == numeric_limits<size_t>::max());
+
+    SimpleVector<int, allocator<int>, OneAndHalfGrowth> v(10, 1);
+    v.Resize(11);
+    assert(v.GetCapacity() == 15);
+    const vector<int> batch(100, 2);
+    v.Append(batch.begin(), batch.end());
+    assert(v.GetCapacity() == 111 && v[110] == 2);
+    bool thrown = false;
+    try {
+        v.Reserve(v.GetCapacity());
+        v.Resize(numeric_limits<size_t>::max());
+    } catch (const length_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    cout << "Done!" << endl << endl;
+}
+
+void TestShrink() {
+    cout << "Test shrink and release" << endl;
+    using Alloc = TrackingAllocator<string, false>;
+    AllocationStats stats;
+    {
+        SimpleVector<string, Alloc> v(Reserve(100), Alloc(&stats));
+        for (int i = 0; i < 10; ++i) {
+            v.PushBack(to_string(i));
+        }
+        v.ShrinkTo(50);
+        assert(v.GetCapacity() == 50 && stats.live_bytes == 50 * sizeof(string));
+        v.ShrinkTo(5);
+        assert(v.GetCapacity() == 10 && v[9] == "9");
+        v.ShrinkTo(20);
+        assert(v.GetCapacity() == 10);
+        v.PopBack();
+        v.ShrinkToFit();
+        assert(v.GetCapacity() == 9 && v.GetSize() == 9 && v[8] == "8");
+        v.ClearAndRelease();
+        assert(v.GetCapacity() == 0 && v.IsEmpty() && stats.live_bytes == 0);
+        v.PushBack("again");
+        v.Clear();
+        v.ShrinkToFit();
+        assert(v.GetCapacity() == 0 && stats.live_bytes == 0);
+    }
+    assert(stats.allocations == stats.deallocations);
+
+    SimpleVector<int, MallocAllocator<int>> ints(1000, 7);
+    ints.Resize(10);
+    ints.ShrinkToFit();
+    assert(ints.GetCapacity() == 10 && ints[9] == 7);
+
+    // pages of the spare capacity go back to the OS, the capacity stays
+    SimpleVector<int> big(Reserve(1 << 22));
+    big.PushBack(1);
+    const size_t capacity = big.GetCapacity();
+    const size_t released = big.ReleaseUnusedPages();
+    assert(big.GetCapacity() == capacity && big[0] == 1);
+    assert(released <= capacity * sizeof(int));
+#ifdef ARRAY_PTR_HAS_MADVISE
+    assert(released > 0);
+#endif
+    big.Resize(1 << 22);
+    assert(big[1 << 21] == 0);
+    cout << "Done!" << endl << endl;
+}
+
+void TestEraseRange() {
+    cout << "Test range erase and EraseIf" << endl;
+    {
+        SimpleVector<int> v{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+        auto it = v.Erase(v.begin() + 2, v.begin() + 5);
+        assert(*it == 5 && (v == SimpleVector<int>{0, 1, 5, 6, 7, 8, 9}));
+        it = v.Erase(v.begin() + 4, v.end());
+        assert(it == v.end() && (v == SimpleVector<int>{0, 1, 5, 6}));
+        it = v.Erase(v.begin(), v.begin());
+        assert(it == v.begin() && v.GetSize() == 4);
+        assert(EraseIf(v, [](int x) { return x % 2 == 1; }) == 2);
+        assert((v == SimpleVector<int>{0, 6}));
+    }
+    {
+        LifetimeCounter::Reset();
+        SimpleVector<LifetimeCounter> v(100);
+        v.Erase(v.begin() + 10, v.begin() + 60);
+        assert(v.GetSize() == 50 && LifetimeCounter::alive == 50);
+        size_t index = 0;
+        assert(EraseIf(v, [&index](const LifetimeCounter&) { return index++ % 5 != 0; }) == 40);
+        assert(v.GetSize() == 10 && LifetimeCounter::alive == 10);
+    }
+    {
+        SimpleVector<X> v;
+        for (size_t i = 0; i < 100000; ++i) {
+            v.PushBack(X(i));
+        }
+        assert(EraseIf(v, [](const X& x) { return x.GetX() % 3 != 0; }) == 66666);
+        assert(v.GetSize() == 33334 && v[1].GetX() == 3 && v[33333].GetX() == 99999);
+    }
+    {
+        SmallSimpleVector<string, 4> v{"a", "bb", "c", "dd", "e"};
+        assert(EraseIf(v, [](const string& s) { return s.size() == 2; }) == 2);
+        v.Erase(v.begin(), v.begin() + 1);
+        assert((v == SmallSimpleVector<string, 4>{"c", "e"}));
+    }
+    cout << "Done!" << endl << endl;
+}
+
+void TestSwapRemove() {
+    cout << "Test swap remove" << endl;
+    SimpleVector<int> v{0, 1, 2, 3, 4, 5};
+    auto it = v.SwapRemove(v.begin() + 1);
+    assert(*it == 5 && (v == SimpleVector<int>{0, 5, 2, 3, 4}));
+    v.SwapRemove(0);
+    assert((v == SimpleVector<int>{4, 5, 2, 3}));
+    v.SwapRemove(v.GetSize() - 1);
+    it = v.SwapRemove(v.end() - 1);
+    assert(it == v.end() && (v == SimpleVector<int>{4, 5}));
+
+    SimpleVector<MoveCounter> entities;
+    for (int i = 0; i < 10; ++i) {
+        entities.EmplaceBack("entity", i);
+    }
+    MoveCounter::Reset();
+    const vector<size_t> dead = {0, 3, 4, 8, 9};
+    entities.SwapRemoveIndices(dead.begin(), dead.end());
+    assert(MoveCounter::moves <= dead.size() && MoveCounter::copies == 0);
+    vector<int> ids;
+    for (const auto& entity : entities) {
+        ids.push_back(entity.id);
+    }
+    sort(ids.begin(), ids.end());
+    assert((ids == vector<int>{1, 2, 5, 6, 7}));
+
+    SimpleVector<X> xs;
+    for (size_t i = 0; i < 4; ++i) {
+        xs.PushBack(X(i));
+    }
+    const size_t all[] = {0, 1, 2, 3};
+    xs.SwapRemoveIndices(begin(all), end(all));
+    assert(xs.IsEmpty());
+    cout << "Done!" << endl << endl;
+}
+
+template <typename Type>
+void CheckComparisonsAgainstStd(SimpleVector<Type> lhs, SimpleVector<Type> rhs) {
+    const bool equal = lhs.GetSize() == rhs.GetSize() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+    assert((lhs == rhs) == equal);
+    assert((lhs < rhs) == lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end()));
+    assert((rhs < lhs) == lexicographical_compare(rhs.begin(), rhs.end(), lhs.begin(), lhs.end()));
+}
+
+template <typename Type>
+void CheckMismatchPositions(const vector<Type>& values) {
+    for (size_t size : {0, 1, 15, 16, 17, 31, 32, 33, 100}) {
+        SimpleVector<Type> base(size);
+        for (size_t i = 0; i < size; ++i) {
+            base[i] = values[i % values.size()];
+        }
+        CheckComparisonsAgainstStd(base, base);
+        SimpleVector<Type> shorter(base);
+        if (size > 0) {
+            shorter.PopBack();
+        }
+        CheckComparisonsAgainstStd(base, shorter);
+        for (size_t pos = 0; pos < size; ++pos) {
+            for (const Type& value : values) {
+                SimpleVector<Type> changed(base);
+                changed[pos] = value;
+                CheckComparisonsAgainstStd(base, changed);
+            }
+        }
+    }
+}
+
+void TestComparisonKernels() {
+    cout << "Test comparison kernels" << endl;
+    CheckMismatchPositions<uint8_t>({0, 1, 127, 128, 255});
+    CheckMismatchPositions<char>({'a', 'z', static_cast<char>(-1), static_cast<char>(0x80)});
+    CheckMismatchPositions<int32_t>({0, 1, -1, 256, numeric_limits<int32_t>::min(), numeric_limits<int32_t>::max()});
+    CheckMismatchPositions<uint64_t>({0, 1, 1ull << 63, 0xFFull});
+    CheckMismatchPositions<double>({0.0, -0.0, 1.5, -1.5});
+
+    // floating point keeps its semantics: NaN is unequal to itself, -0.0 == 0.0
+    const double nan = numeric_limits<double>::quiet_NaN();
+    assert(!(SimpleVector<double>{1.0, nan} == SimpleVector<double>{1.0, nan}));
+    assert((SimpleVector<double>{-0.0} == SimpleVector<double>{0.0}));
+    assert(!(SimpleVector<float>{-0.0f} < SimpleVector<float>{0.0f}));
+
+    // every kernel the CPU supports agrees with the scalar one
+    vector<unsigned char> lhs(200, 7);
+    for (size_t pos = 0; pos <= lhs.size(); ++pos) {
+        vector<unsigned char> rhs = lhs;
+        if (pos < rhs.size()) {
+            rhs[pos] = 8;
+        }
+        for (size_t size : {pos, lhs.size()}) {
+            const size_t expected = MismatchBytesScalar(lhs.data(), rhs.data(), size);
+            assert(MismatchBytes(lhs.data(), rhs.data(), size) == expected);
+#ifdef COMPARE_KERNELS_X86
+            assert(MismatchBytesSse2(lhs.data(), rhs.data(), size) == expected);
+            if (__builtin_cpu_supports("avx2")) {
+                assert(MismatchBytesAvx2(lhs.data(), rhs.data(), size) == expected);
+            }
+#endif
+        }
+    }
+
+    assert((SmallSimpleVector<int, 2>{1, 2, 3} < SmallSimpleVector<int, 2>{1, 3}));
+    {
+        // growth past max_size is a checked error, not a wrapped capacity
+        SmallSimpleVector<int, 2> v{1, 2, 3};
+        try {
+            v.Reserve(numeric_limits<size_t>::max());
+            assert(false);
+        } catch (const length_error&) {
+        }
+        assert(v.GetSize() == 3 && v[2] == 3);
+    }
+    cout << "Done!" << endl << endl;
+}
+
+struct ThrowingCopy {
+    inline static atomic<size_t> copies_left{0};
+    inline static atomic<long> alive{0};
+
+    ThrowingCopy() {
+        ++alive;
+    }
+    ThrowingCopy(const ThrowingCopy&) {
+        if (copies_left.fetch_sub(1) == 0) {
+            throw runtime_error("copy failed");
+        }
+        ++alive;
+    }
+    ~ThrowingCopy() {
+        --alive;
+    }
+};
+
+void TestParallelAlgorithms() {
+    cout << "Test parallel algorithms" << endl;
+    const size_t size = 1 << 20;
+    SimpleVector<int> zeros(size, Parallel(4));
+    assert(zeros.GetSize() == size && ParallelReduce(zeros.begin(), zeros.end(), 0, plus<>(), 4) == 0);
+
+    SimpleVector<uint64_t> v(size, uint64_t{3}, Parallel(4));
+    assert(v.GetSize() == size && v[size - 1] == 3);
+    iota(v.begin(), v.end(), 0);
+    ParallelTransform(v.begin(), v.end(), v.begin(), [](uint64_t x) { return x * 2; }, 4);
+    assert(ParallelReduce(v.begin(), v.end(), uint64_t{0}, plus<>(), 4) == uint64_t{size} * (size - 1));
+    assert(ParallelReduce(v.begin(), v.begin(), uint64_t{7}) == 7);
+    assert(ParallelReduce(v.begin(), v.begin() + 10, uint64_t{1}, [](uint64_t a, uint64_t b) { return max(a, b); }) == 18);
+    ParallelFill(v.begin() + 10, v.end(), uint64_t{1}, 3);
+    assert(v[9] == 18 && v[10] == 1 && v[size - 1] == 1);
+
+    {
+        // task i runs on the same pool worker every time, never on the caller
+        ParallelPool& pool = ParallelPool::Global();
+        vector<thread::id> first_run(4);
+        vector<thread::id> second_run(4);
+        ParallelForTasks(4, [&](size_t index) { first_run[index] = this_thread::get_id(); });
+        ParallelForTasks(4, [&](size_t index) { second_run[index] = this_thread::get_id(); });
+        assert(first_run == second_run && pool.GetWorkerCount() >= 4);
+        assert(set<thread::id>(first_run.begin(), first_run.end()).size() == 4);
+        assert(find(first_run.begin(), first_run.end(), this_thread::get_id()) == first_run.end());
+
+        // a parallel call inside a task runs inline instead of waiting for itself
+        ParallelForTasks(2, [](size_t) {
+            vector<thread::id> inner(3);
+            ParallelForTasks(3, [&inner](size_t index) { inner[index] = this_thread::get_id(); });
+            assert(count(inner.begin(), inner.end(), this_thread::get_id()) == 3);
+        });
+#ifdef PARALLEL_HAS_AFFINITY
+        // pinned workers run on their own CPU
+        assert(pool.GetPlacement() == WorkerPlacement::kPinned && pool.GetWorkerCpu(0) >= 0);
+        vector<int> cpus(4);
+        ParallelForTasks(4, [&cpus](size_t index) { cpus[index] = sched_getcpu(); });
+        for (size_t index = 0; index < cpus.size(); ++index) {
+            assert(cpus[index] == pool.GetWorkerCpu(index));
+        }
+        pool.SetPlacement(WorkerPlacement::kUnpinned);
+        ParallelForTasks(4, [&](size_t index) { second_run[index] = this_thread::get_id(); });
+        assert(first_run == second_run);
+        pool.SetPlacement(WorkerPlacement::kPinned);
+#endif
+    }
+
+    // the chunks are the same for the same size and thread count
+    for (size_t chunks : {1, 3, 7}) {
+        size_t covered = 0;
+        for (size_t i = 0; i < chunks; ++i) {
+            auto [first, last] = ParallelChunkBounds(100, chunks, i);
+            assert(first == covered && last > first);
+            covered = last;
+        }
+        assert(covered == 100);
+    }
+
+    mt19937 generator(42);
+    for (size_t threads : {1, 2, 3, 5, 8}) {
+        SimpleVector<uint32_t> random(size / 2);
+        for (auto& item : random) {
+            item = generator();
+        }
+        vector<uint32_t> expected(random.begin(), random.end());
+        sort(expected.begin(), expected.end());
+        ParallelSort(random.begin(), random.end(), less<>(), threads);
+        assert(equal(random.begin(), random.end(), expected.begin()));
+    }
+    SimpleVector<string> words{"pear", "apple", "fig"};
+    ParallelSort(words.begin(), words.end(), greater<>());
+    assert((words == SimpleVector<string>{"pear", "fig", "apple"}));
+    {
+        // a comparison that throws while merging reaches the caller
+        const size_t chunks = ParallelChunkCount(size, 4);
+        assert(chunks == 4);
+        SimpleVector<pair<uint32_t, size_t>> tagged(size);
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            auto [first, last] = ParallelChunkBounds(size, chunks, chunk);
+            for (size_t i = first; i < last; ++i) {
+                tagged[i] = {static_cast<uint32_t>(generator()), chunk};
+            }
+        }
+        // elements of different chunks only meet in the merges
+        auto by_value = [](const auto& lhs, const auto& rhs) {
+            if (lhs.second != rhs.second) {
+                throw runtime_error("merge failed");
+            }
+            return lhs.first < rhs.first;
+        };
+        bool merge_thrown = false;
+        try {
+            ParallelSort(tagged.begin(), tagged.end(), by_value, 4);
+        } catch (const runtime_error&) {
+            merge_thrown = true;
+        }
+        assert(merge_thrown);
+    }
+
+    // a failing chunk takes the others down with it
+    ThrowingCopy::copies_left = size / 2;
+    bool thrown = false;
+    try {
+        SimpleVector<ThrowingCopy> failing(size, ThrowingCopy(), Parallel(4));
+    } catch (const runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown && ThrowingCopy::alive == 0);
+    cout << "Done!" << endl << endl;
+}
+
+// Allocator that throws bad_alloc once allocations_left runs out
+template <typename Type>
+struct FailingAllocator {
+    using value_type = Type;
+
+    inline static size_t allocations_left = numeric_limits<size_t>::max();
+
+    FailingAllocator() = default;
+    template <typename Other>
+    FailingAllocator(const FailingAllocator<Other>&) noexcept {
+    }
+
+    Type* allocate(size_t n) {
+        if (FailingAllocator<char>::allocations_left == 0) {
+            throw bad_alloc();
+        }
+        --FailingAllocator<char>::allocations_left;
+        return allocator<Type>().allocate(n);
+    }
+    void deallocate(Type* p, size_t n) noexcept {
+        allocator<Type>().deallocate(p, n);
+    }
+
+    template <typename Other>
+    bool operator==(const FailingAllocator<Other>&) const noexcept {
+        return true;
+    }
+    template <typename Other>
+    bool operator!=(const FailingAllocator<Other>&) const noexcept {
+        return false;
+    }
+};
+
+void TestConcurrentSimpleVector() {
+    cout << "Test concurrent simple vector" << endl;
+    {
+        // a segment that can't be allocated leaves no hole behind
+        ConcurrentSimpleVector<int, FailingAllocator<int>> v;
+        FailingAllocator<char>::allocations_left = 2;
+        for (int i = 0; i < 8; ++i) {
+            v.PushBack(i);
+        }
+        try {
+            v.PushBack(8);
+            assert(false);
+        } catch (const bad_alloc&) {
+        }
+        assert(v.GetSize() == 8 && v.GetCapacity() == 8);
+        FailingAllocator<char>::allocations_left = numeric_limits<size_t>::max();
+        v.PushBack(8);
+        v.PushBack(9);
+        assert(v.GetSize() == 10 && v[8] == 8 && v[9] == 9);
+        v.Clear();
+        assert(v.IsEmpty());
+    }
+    {
+        ConcurrentSimpleVector<string> v;
+        assert(v.IsEmpty() && v.GetCapacity() == 0 && v.begin() == v.end());
+        string& first = v.EmplaceBack(3, 'a');
+        for (int i = 0; i < 1000; ++i) {
+            v.PushBack(to_string(i));
+        }
+        // growing appends segments, nothing moves
+        assert(&first == &v[0] && first == "aaa");
+        assert(v.GetSize() == 1001 && v.At(1000) == "999" && v.GetCapacity() >= 1001);
+        size_t count = 0;
+        for (const string& item : v) {
+            assert(&item == &v[count]);
+            ++count;
+        }
+        assert(count == 1001);
+        bool thrown = false;
+        try {
+            v.At(1001);
+        } catch (const out_of_range&) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        const size_t capacity = v.GetCapacity();
+        v.Clear();
+        assert(v.IsEmpty() && v.GetCapacity() == capacity);
+        v.Reserve(100000);
+        assert(v.GetCapacity() >= 100000);
+    }
+    {
+        const size_t producers = 8;
+        const size_t per_producer = 20000;
+        struct Item {
+            size_t producer;
+            size_t sequence;
+            bool constructed = true;
+        };
+        ConcurrentSimpleVector<Item> v;
+        atomic<bool> done{false};
+        atomic<size_t> snapshots{0};
+        // a reader walking snapshots never meets an element still under construction
+        thread reader([&] {
+            while (!done) {
+                auto last = v.end();
+                for (auto it = v.begin(); it != last; ++it) {
+                    assert(it->constructed);
+                }
+                ++snapshots;
+            }
+        });
+        vector<thread> threads;
+        vector<vector<const Item*>> addresses(producers);
+        for (size_t producer = 0; producer < producers; ++producer) {
+            threads.emplace_back([&, producer] {
+                for (size_t sequence = 0; sequence < per_producer; ++sequence) {
+                    addresses[producer].push_back(&v.EmplaceBack(Item{producer, sequence}));
+                }
+            });
+        }
+        for (auto& producer : threads) {
+            producer.join();
+        }
+        done = true;
+        reader.join();
+        assert(snapshots > 0);
+
+        assert(v.GetSize() == producers * per_producer);
+        vector<size_t> next(producers, 0);
+        for (const Item& item : v) {
+            // each producer's elements keep their relative order
+            assert(item.sequence == next[item.producer]++);
+            assert(addresses[item.producer][item.sequence] == &item);
+        }
+        assert(all_of(next.begin(), next.end(), [&](size_t n) { return n == per_producer; }));
+    }
+    {
+        struct Counted {
+            explicit Counted(atomic<long>* alive) noexcept
+                : alive(alive) {
+                ++*alive;
+            }
+            Counted(Counted&& other) noexcept
+                : alive(other.alive) {
+                ++*alive;
+            }
+            ~Counted() {
+                --*alive;
+            }
+            atomic<long>* alive;
+        };
+        atomic<long> alive{0};
+        AllocationStats stats;
+        {
+            ConcurrentSimpleVector<Counted, TrackingAllocator<Counted, false>> v{
+                TrackingAllocator<Counted, false>(&stats)};
+            // segments are allocated up front, the producers only construct
+            v.Reserve(4000);
+            const size_t allocations = stats.allocations;
+            vector<thread> threads;
+            for (int producer = 0; producer < 4; ++producer) {
+                threads.emplace_back([&] {
+                    for (int i = 0; i < 1000; ++i) {
+                        v.EmplaceBack(&alive);
+                    }
+                });
+            }
+            for (auto& producer : threads) {
+                producer.join();
+            }
+            assert(alive == 4000 && v.GetSize() == 4000 && stats.allocations == allocations);
+        }
+        assert(alive == 0 && stats.live_bytes == 0);
+    }
+    cout << "Done!" << endl << endl;
+}
+
+void TestChunkedSimpleVector() {
+    cout << "Test chunked simple vector" << endl;
+    static_assert(DefaultChunkBlockSize<int>() == 1024 && DefaultChunkBlockSize<char[3000]>() == 1);
+    {
+        // growth never moves an element
+        MoveCounter::Reset();
+        ChunkedSimpleVector<MoveCounter, allocator<MoveCounter>, 4> v;
+        MoveCounter& first = v.EmplaceBack("first", 0);
+        for (int i = 1; i < 100; ++i) {
+            v.EmplaceBack("item", i);
+        }
+        assert(MoveCounter::copies == 0 && MoveCounter::moves == 0);
+        assert(&first == &v[0] && v.GetSize() == 100 && v.GetCapacity() == 100 && v.GetBlockCount() == 25);
+        assert(v.At(99).id == 99 && v.GetBlock(24) + 3 == &v[99]);
+    }
+    {
+        using Chunked = ChunkedSimpleVector<int, allocator<int>, 4>;
+        Chunked v(10);
+        assert(v.GetSize() == 10 && v.GetCapacity() == 12 && all_of(v.begin(), v.end(), [](int x) { return x == 0; }));
+        iota(v.begin(), v.end(), 0);
+        vector<int> expected(v.begin(), v.end());
+
+        auto it = v.Insert(v.begin() + 3, 100);
+        expected.insert(expected.begin() + 3, 100);
+        assert(*it == 100 && equal(v.begin(), v.end(), expected.begin(), expected.end()));
+        v.Insert(v.begin() + 1, 6, -1);
+        expected.insert(expected.begin() + 1, 6, -1);
+        list<int> extra{7, 8, 9};
+        v.Insert(v.end() - 2, extra.begin(), extra.end());
+        expected.insert(expected.end() - 2, extra.begin(), extra.end());
+        assert(equal(v.begin(), v.end(), expected.begin(), expected.end()));
+
+        it = v.Erase(v.begin() + 2, v.begin() + 9);
+        expected.erase(expected.begin() + 2, expected.begin() + 9);
+        assert(*it == expected[2] && equal(v.begin(), v.end(), expected.begin(), expected.end()));
+        assert(EraseIf(v, [](int x) { return x % 2 != 0; }) == 7);
+        expected.erase(remove_if(expected.begin(), expected.end(), [](int x) { return x % 2 != 0; }), expected.end());
+        assert(equal(v.begin(), v.end(), expected.begin(), expected.end()));
+        v.SwapRemove(v.begin());
+        assert(v[0] == expected.back() && v.GetSize() == expected.size() - 1);
+
+        // the iterators are random access and work with the std algorithms
+        sort(v.begin(), v.end(), greater<>());
+        assert(is_sorted(v.cbegin(), v.cend(), greater<>()) && v.end() - v.begin() == static_cast<ptrdiff_t>(v.GetSize()));
+        Chunked::ConstIterator const_it = v.begin() + 2;
+        assert(const_it[1] == v[3] && const_it > v.cbegin() && *--const_it == v[1]);
+
+        v.Resize(2);
+        v.ShrinkToFit();
+        assert(v.GetSize() == 2 && v.GetCapacity() == 4);
+        v.ClearAndRelease();
+        assert(v.IsEmpty() && v.GetCapacity() == 0);
+        v.Reserve(9);
+        assert(v.GetCapacity() == 12 && v.IsEmpty());
+    }
+    {
+        using Chunked = ChunkedSimpleVector<string, allocator<string>, 2>;
+        Chunked v{"a", "b", "c", "d", "e"};
+        Chunked copy(v);
+        assert(copy == v && !(copy < v));
+        Chunked moved(move(copy));
+        assert(moved == v && copy.IsEmpty());
+        copy = moved;
+        moved.PopBack();
+        assert(moved < v && v > moved && moved != v && moved <= v);
+        moved.PushBack("f");
+        assert(v < moved && !(moved < v));
+        copy = move(moved);
+        assert(copy.GetSize() == 5 && copy[4] == "f" && moved.IsEmpty());
+        copy.swap(v);
+        assert(copy[4] == "e" && v[4] == "f");
+    }
+    {
+        // the comparisons agree with std::vector for integral and other types
+        for (int size : {0, 1, 63, 64, 65, 200}) {
+            ChunkedSimpleVector<int32_t, allocator<int32_t>, 64> lhs(size, 7);
+            vector<int32_t> expected(size, 7);
+            for (int position = 0; position < size; position += 31) {
+                ChunkedSimpleVector<int32_t, allocator<int32_t>, 64> rhs(lhs);
+                vector<int32_t> rhs_expected(expected);
+                rhs[position] = rhs_expected[position] = -1;
+                assert((lhs == rhs) == (expected == rhs_expected));
+                assert((lhs < rhs) == (expected < rhs_expected) && (rhs < lhs) == (rhs_expected < expected));
+            }
+            ChunkedSimpleVector<int32_t, allocator<int32_t>, 64> longer(lhs);
+            longer.PushBack(7);
+            assert(lhs < longer && !(longer < lhs) && lhs != longer);
+        }
+    }
+    {
+        // no moment with two copies of the data: the capacity stays within a block of the size
+        AllocationStats stats;
+        {
+            ChunkedSimpleVector<int, TrackingAllocator<int, false>, 256> v{TrackingAllocator<int, false>(&stats)};
+            for (int i = 0; i < 10000; ++i) {
+                v.PushBack(i);
+                assert(stats.live_bytes < (v.GetSize() + 256) * sizeof(int));
+            }
+            assert(stats.allocations == 40 && stats.deallocations == 0);
+
+            ChunkedSimpleVector<int, TrackingAllocator<int, false>, 256> other{
+                TrackingAllocator<int, false>(&stats)};
+            other = v;
+            assert(other == v && stats.allocations == 80);
+        }
+        assert(stats.live_bytes == 0 && stats.deallocations == 80);
+    }
+    cout << "Done!" << endl << endl;
+}
+
+#ifdef MAPPED_SIMPLE_VECTOR_AVAILABLE
+void TestMappedSimpleVector() {
+    cout << "Test mapped simple vector" << endl;
+    struct Record {
+        int64_t id;
+        double value;
+    };
+    const string path = (filesystem::temp_directory_path() / "mapped_simple_vector_test.bin").string();
+    {
+        auto v = MappedSimpleVector<Record>::Create(path);
+        assert(v.IsOpen() && v.IsEmpty() && v.GetCapacity() == 0);
+        for (int64_t i = 0; i < 10000; ++i) {
+            v.PushBack({i, i * 0.5});
+        }
+        assert(v.GetSize() == 10000 && v.GetCapacity() >= 10000 && v[9999].value == 4999.5);
+        v.Insert(v.begin(), {-1, -1.0});
+        v.Erase(v.begin() + 1, v.begin() + 11);
+        assert(v.GetSize() == 9991 && v[0].id == -1 && v[1].id == 10);
+        v.EmplaceBack(v[0]);
+        v.ShrinkToFit();
+        assert(v.GetCapacity() == 9992 && filesystem::file_size(path) == 64 + 9992 * sizeof(Record));
+        v.Advise(MappedAccess::kSequential);
+        v.Sync();
+    }
+    {
+        // reopening maps the same records back without reading them
+        auto v = MappedSimpleVector<Record>::Open(path);
+        assert(v.GetSize() == 9992 && v.GetCapacity() == 9992);
+        assert(v[0].id == -1 && v[1].id == 10 && v[9990].id == 9999 && v[9991].id == -1);
+        // the iterators are plain pointers into the mapping
+        Record* data = v.begin();
+        sort(data, v.end(), [](const Record& lhs, const Record& rhs) { return lhs.id < rhs.id; });
+        assert(v[0].id == -1 && v[2].id == 10);
+        v.Resize(10000);
+        assert(v[9999].id == 0 && v[9999].value == 0.0);
+        v.Resize(3);
+        v.PopBack();
+
+        MappedSimpleVector<Record> moved(move(v));
+        assert(!v.IsOpen() && moved.GetSize() == 2);
+        bool thrown = false;
+        try {
+            moved.At(2);
+        } catch (const out_of_range&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    {
+        auto v = MappedSimpleVector<Record>::Open(path);
+        assert(v.GetSize() == 2 && v[1].id == -1);
+        v.Clear();
+        assert(v.IsEmpty());
+    }
+    {
+        auto expect_failure = [&](auto open) {
+            try {
+                open();
+            } catch (const runtime_error&) {
+                return true;
+            }
+            return false;
+        };
+        // wrong element type, not our file, no file
+        assert(expect_failure([&] { MappedSimpleVector<int32_t>::Open(path); }));
+        ofstream(path, ios::trunc) << "definitely not a vector, but longer than the header "
+                                      "so that it gets as far as the magic check";
+        assert(expect_failure([&] { MappedSimpleVector<Record>::Open(path); }));
+        filesystem::remove(path);
+        assert(expect_failure([&] { MappedSimpleVector<Record>::Open(path); }));
+    }
+    cout << "Done!" << endl << endl;
+}
+#endif
+
+void TestSerialization() {
+    cout << "Test serialization" << endl;
+    struct Point {
+        int32_t x;
+        int32_t y;
+        double weight;
+    };
+    SimpleVector<Point> points;
+    for (int32_t i = 0; i < 1000; ++i) {
+        points.PushBack({i, -i, i * 0.25});
+    }
+    auto same_points = [&points](const auto& other) {
+        return other.GetSize() == points.GetSize() &&
+               equal(points.begin(), points.end(), other.begin(), [](const Point& lhs, const Point& rhs) {
+                   return lhs.x == rhs.x && lhs.y == rhs.y && lhs.weight == rhs.weight;
+               });
+    };
+
+    stringstream stream;
+    WriteTo(points, stream);
+    const string bytes = stream.str();
+    assert(bytes.size() == kSerializedHeaderSize + 1000 * sizeof(Point));
+    SimpleVector<Point> restored{{7, 7, 7.0}};
+    ReadFrom(restored, stream);
+    // storage reserved once, for exactly the elements read
+    assert(same_points(restored) && restored.GetCapacity() == 1000);
+
+    SimpleVector<char> empty;
+    stringstream empty_stream;
+    WriteTo(empty, empty_stream);
+    SimpleVector<char> empty_restored{'a'};
+    ReadFrom(empty_restored, empty_stream);
+    assert(empty_restored.IsEmpty());
+
+    {
+        // the view reads an aligned copy of the received bytes in place
+        vector<uint64_t> received((bytes.size() + 7) / 8);
+        memcpy(received.data(), bytes.data(), bytes.size());
+        SerializedView<Point> view(received.data(), bytes.size());
+        assert(same_points(view) && view.GetBytes() == bytes.size());
+        assert(reinterpret_cast<const char*>(view.begin()) == reinterpret_cast<const char*>(received.data()) + 32);
+        assert(view.At(999).x == 999);
+    }
+
+    auto rejects = [](auto read) {
+        try {
+            read();
+        } catch (const runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    {
+        SimpleVector<int64_t> wrong_type;
+        stringstream in(bytes);
+        assert(rejects([&] { ReadFrom(wrong_type, in); }));
+
+        SimpleVector<Point> truncated;
+        stringstream short_in(bytes.substr(0, bytes.size() - 1));
+        assert(rejects([&] { ReadFrom(truncated, short_in); }) && truncated.IsEmpty());
+
+        string garbage = bytes;
+        garbage[0] ^= 1;
+        assert(rejects([&] { SerializedView<Point>(garbage.data(), garbage.size()); }));
+        assert(rejects([&] { SerializedView<Point>(bytes.data(), bytes.size() - 1); }));
+        assert(rejects([&] { SerializedView<Point>(bytes.data(), 8); }));
+
+        vector<uint64_t> misaligned(bytes.size() / 8 + 2);
+        char* start = reinterpret_cast<char*>(misaligned.data()) + 4;
+        memcpy(start, bytes.data(), bytes.size());
+        assert(rejects([&] { SerializedView<Point>(start, bytes.size()); }));
+    }
+    {
+        // a header written on a machine of the other byte order is reported
+        // as such
+        SerializedHeader header;
+        memcpy(&header, bytes.data(), sizeof(header));
+        header.magic = __builtin_bswap32(header.magic);
+        header.byte_order = __builtin_bswap32(header.byte_order);
+        header.version = __builtin_bswap16(header.version);
+        header.alignment = __builtin_bswap16(header.alignment);
+        header.element_size = __builtin_bswap32(header.element_size);
+        header.count = __builtin_bswap64(header.count);
+        string swapped = bytes;
+        memcpy(swapped.data(), &header, sizeof(header));
+        SimpleVector<Point> foreign;
+        stringstream foreign_in(swapped);
+        string error;
+        try {
+            ReadFrom(foreign, foreign_in);
+        } catch (const runtime_error& e) {
+            error = e.what();
+        }
+        assert(error == "serialized SimpleVector has a different byte order");
+    }
+    {
+        // a forged count is rejected without reserving storage for it
+        auto forge = [&bytes](uint64_t count) {
+            string forged = bytes;
+            memcpy(&forged[offsetof(SerializedHeader, count)], &count, sizeof(count));
+            return forged;
+        };
+        SimpleVector<Point> forged;
+        stringstream too_long(forge(numeric_limits<uint64_t>::max()));
+        assert(rejects([&] { ReadFrom(forged, too_long); }) && forged.IsEmpty());
+        stringstream too_many(forge(uint64_t{1} << 40));
+        assert(rejects([&] { ReadFrom(forged, too_many); }) && forged.IsEmpty());
+        assert(forged.GetCapacity() <= 2 * kSerializedReadChunkBytes / sizeof(Point));
+        assert(rejects([&] { SerializedView<Point>(forge(1001).data(), bytes.size()); }));
+    }
+
+#ifdef SERIALIZATION_HAS_FD_IO
+    {
+        const string path = (filesystem::temp_directory_path() / "serialization_test.bin").string();
+        SimpleVector<uint32_t> big(1 << 20);
+        iota(big.begin(), big.end(), 0);
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        assert(fd >= 0);
+        WriteTo(big, fd);
+        WriteTo(points, fd);
+        ::lseek(fd, 0, SEEK_SET);
+        SimpleVector<uint32_t> big_restored;
+        ReadFrom(big_restored, fd);
+        ReadFrom(restored, fd);
+        assert(big_restored == big && same_points(restored));
+        assert(rejects([&] { ReadFrom(restored, fd); }));
+        ::close(fd);
+
+        // a regular file is checked against its size before anything is
+        // reserved; a pipe is read in bounded chunks
+        stringstream small;
+        WriteTo(SimpleVector<uint32_t>(1024), small);
+        string forged = small.str();
+        const uint64_t forged_count = uint64_t{1} << 40;
+        memcpy(&forged[offsetof(SerializedHeader, count)], &forged_count, sizeof(forged_count));
+        auto put = [&forged](int to) {
+            ssize_t written = ::write(to, forged.data(), forged.size());
+            assert(written == static_cast<ssize_t>(forged.size()));
+            ::close(to);
+        };
+        put(::open(path.c_str(), O_WRONLY | O_TRUNC));
+        fd = ::open(path.c_str(), O_RDONLY);
+        assert(fd >= 0);
+        SimpleVector<uint32_t> from_file;
+        assert(rejects([&] { ReadFrom(from_file, fd); }) && from_file.GetCapacity() == 0);
+        ::close(fd);
+        filesystem::remove(path);
+
+        int pipe_fds[2] = {-1, -1};
+        ::pipe(pipe_fds);
+        assert(pipe_fds[0] >= 0);
+        put(pipe_fds[1]);
+        SimpleVector<uint32_t> from_pipe;
+        assert(rejects([&] { ReadFrom(from_pipe, pipe_fds[0]); }) && from_pipe.IsEmpty());
+        assert(from_pipe.GetCapacity() <= 2 * kSerializedReadChunkBytes / sizeof(uint32_t));
+        ::close(pipe_fds[0]);
+    }
+#endif
+    cout << "Done!" << endl << endl;
+}
+
+int64_t SumOfView(SimpleVectorView<const int> view) {
+    return accumulate(view.begin(), view.end(), int64_t{0});
+}
+
+void TestSimpleVectorView() {
+    cout << "Test simple vector view" << endl;
+    static_assert(sizeof(SimpleVectorView<int>) == 2 * sizeof(void*));
+    // a view of a temporary would dangle
+    static_assert(!is_constructible_v<SimpleVectorView<const int>, SimpleVector<int>&&>);
+    static_assert(!is_constructible_v<SimpleVectorView<int>, const SimpleVector<int>&>);
+    static_assert(is_constructible_v<SimpleVectorView<const int>, SimpleVector<int>&>);
+
+    SimpleVector<int> v(100);
+    iota(v.begin(), v.end(), 0);
+    // vectors convert to views implicitly, so call sites don't change
+    assert(SumOfView(v) == 4950);
+    assert(SumOfView(v.Slice(10, 5)) == 10 + 11 + 12 + 13 + 14);
+    assert(SumOfView(v.Slice(100, 0)) == 0);
+
+    SimpleVectorView<int> middle = v.Slice(40, 20);
+    assert(middle.GetSize() == 20 && middle[0] == 40 && middle.At(19) == 59 && middle.Data() == &v[40]);
+    for (int& item : middle) {
+        item = -item;
+    }
+    assert(v[39] == 39 && v[40] == -40 && v[59] == -59 && v[60] == 60);
+    SimpleVectorView<const int> tail = middle.Slice(15);
+    assert(tail.GetSize() == 5 && tail[0] == -55);
+
+    bool thrown = false;
+    try {
+        v.Slice(90, 11);
+    } catch (const out_of_range&) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        middle.At(20);
+    } catch (const out_of_range&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // comparisons mix const and mutable views and agree with std::vector
+    const SimpleVector<int>& const_v = v;
+    assert(v.View() == const_v.View() && !(v.View() < const_v.View()));
+    assert(v.Slice(0, 10) < v.Slice(0, 11) && v.Slice(1, 5) > v.Slice(0, 5));
+    assert(v.Slice(0, 40) != middle && v.Slice(40, 20) == middle && v.Slice(40, 20) <= middle);
+    SimpleVector<int> other = v;
+    other[70] = 0;
+    vector<int> expected(v.begin(), v.end());
+    vector<int> other_expected(other.begin(), other.end());
+    assert((v.View() < other.View()) == (expected < other_expected));
+    assert((other.Slice(60, 20) >= v.Slice(60, 20)) == (other_expected >= expected));
+    SimpleVector<string> words{"apple", "banana", "cherry"};
+    assert(words.Slice(0, 2) < words.Slice(1, 2) && words.Slice(2, 1) == SimpleVectorView<const string>(&words[2], 1));
+
+    // other contiguous containers
+    MoveCounter::Reset();
+    SmallSimpleVector<MoveCounter, 4> small;
+    small.EmplaceBack("a", 1);
+    small.EmplaceBack("b", 2);
+    SimpleVectorView small_view(small);
+    static_assert(is_same_v<decltype(small_view), SimpleVectorView<MoveCounter>>);
+    assert(small_view.GetSize() == 2 && small_view[1].id == 2 && small.Slice(1, 1)[0].name == "b");
+    assert(MoveCounter::copies == 0);
+
+    stringstream stream;
+    WriteTo(v, stream);
+    const string bytes = stream.str();
+    vector<uint64_t> buffer((bytes.size() + 7) / 8);
+    memcpy(buffer.data(), bytes.data(), bytes.size());
+    const SerializedView<int> serialized(buffer.data(), bytes.size());
+    assert(SimpleVectorView<const int>(serialized) == v.View());
+
+    SimpleVectorView<const int> empty;
+    assert(empty.IsEmpty() && empty.begin() == empty.end() && empty == v.Slice(3, 0));
+    cout << "Done!" << endl << endl;
+}
+
+void TestMoveCounts() {
+    cout << "Test move counts" << endl;
+    {
+        SimpleVector<X> v;
+        X::moves = 0;
+        for (size_t i = 0; i < 100; ++i) {
+            v.PushBack(X(i));
+        }
+        // one move per push, plus 1 + 2 + ... + 64 for growing to 128
+        assert(X::moves == 100 + 127);
+
+        X::moves = 0;
+        SimpleVector<X> reserved(Reserve(100));
+        for (size_t i = 0; i < 100; ++i) {
+            reserved.PushBack(X(i));
+        }
+        assert(X::moves == 100);
+
+        // with spare capacity the tail moves by one: new last slot, 98 shifts, the value
+        X::moves = 0;
+        v.Insert(v.begin() + 1, X(1000));
+        assert(X::moves == 100 && v[1].GetX() == 1000 && v[2].GetX() == 1);
+        X::moves = 0;
+        v.Erase(v.begin());
+        assert(X::moves == 100 && v[0].GetX() == 1000);
+        X::moves = 0;
+        v.SwapRemove(v.begin());
+        assert(X::moves == 1 && v[0].GetX() == 99);
+
+        X::moves = 0;
+        SimpleVector<X> moved(move(v));
+        moved.Resize(50);
+        assert(X::moves == 0);
+    }
+    cout << "Done!" << endl << endl;
+}
+
+// Owns a heap int and counts its moves and destructions; declared trivially
+// relocatable, so SimpleVector may move it around with memcpy
+struct Handle {
+    explicit Handle(int value)
+        : ptr(new int(value)) {}
+
+    Handle(Handle&& other) noexcept
+        : ptr(exchange(other.ptr, nullptr)) {
+        ++moves;
+    }
+
+    Handle& operator=(Handle&& rhs) noexcept {
+        swap(ptr, rhs.ptr);
+        ++moves;
+        return *this;
+    }
+
+    ~Handle() {
+        delete ptr;
+        ++destructions;
+    }
+
+    inline static int moves = 0;
+    inline static int destructions = 0;
+    int* ptr;
+};
+
+template <>
+struct IsTriviallyRelocatable<Handle> : true_type {};
+
+void TestTriviallyRelocatable() {
+    cout << "Test trivially relocatable" << endl;
+    static_assert(IsTriviallyRelocatable<int>::value && IsTriviallyRelocatable<unique_ptr<int>>::value);
+    static_assert(IsTriviallyRelocatable<SimpleVector<string>>::value && !IsTriviallyRelocatable<string>::value);
+    static_assert(ArrayPtr<Handle>::kRelocatesAsBytes && !ArrayPtr<Handle>::kMovesAsBytes);
+    {
+        // growth, Resize, Insert and Erase neither move nor destroy the old elements
+        SimpleVector<Handle> v;
+        Handle::moves = 0;
+        Handle::destructions = 0;
+        for (int i = 0; i < 100; ++i) {
+            v.EmplaceBack(i);
+        }
+        assert(Handle::moves == 0 && Handle::destructions == 0);
+        v.Reserve(1000);
+        v.Emplace(v.begin() + 10, -1);
+        v.Insert(v.begin() + 20, Handle(-2));
+        // only the inserted values move, out of their temporaries
+        assert(Handle::moves == 2 && Handle::destructions == 2);
+        assert(*v[9].ptr == 9 && *v[10].ptr == -1 && *v[20].ptr == -2 && *v[21].ptr == 19);
+        Handle::moves = 0;
+        Handle::destructions = 0;
+        v.Erase(v.begin() + 10);
+        v.Erase(v.begin() + 19, v.begin() + 21);
+        assert(Handle::moves == 0 && Handle::destructions == 3 && v.GetSize() == 99);
+        assert(*v[10].ptr == 10 && *v[19].ptr == 20);
+        v.SwapRemove(size_t{0});
+        assert(Handle::moves == 0 && Handle::destructions == 4 && *v[0].ptr == 99 && *v[1].ptr == 1);
+        v.ShrinkToFit();
+        assert(Handle::moves == 0 && v.GetCapacity() == 98);
+    }
+    {
+        // standard handles and nested vectors
+        SimpleVector<unique_ptr<int>> owners;
+        for (int i = 0; i < 50; ++i) {
+            owners.Insert(owners.begin(), make_unique<int>(i));
+        }
+        owners.Erase(owners.begin(), owners.begin() + 10);
+        assert(owners.GetSize() == 40 && *owners[0] == 39 && *owners[39] == 0);
+        SimpleVector<SimpleVector<string>> nested;
+        for (int i = 0; i < 20; ++i) {
+            nested.PushBack(SimpleVector<string>(3, to_string(i)));
+        }
+        nested.Insert(nested.begin(), SimpleVector<string>{"front"s});
+        assert(nested.GetSize() == 21 && nested[0][0] == "front"s && nested[20][2] == "19"s);
+    }
+    cout << "Done!" << endl << endl;
+}
+
+// Copyable, with a move constructor that is not noexcept; copies start
+// throwing once copies_left runs out
+struct MayThrowMove {
+    inline static size_t copies_left = numeric_limits<size_t>::max();
+    inline static size_t copies = 0;
+    inline static size_t moves = 0;
+
+    MayThrowMove(int v = 0)
+        : value(v) {}
+
+    MayThrowMove(const MayThrowMove& other)
+        : value(other.value) {
+        if (copies_left-- == 0) {
+            throw runtime_error("copy failed");
+        }
+        ++copies;
+    }
+
+    MayThrowMove(MayThrowMove&& other)
+        : value(other.value) {
+        ++moves;
+    }
+
+    MayThrowMove& operator=(const MayThrowMove& rhs) = default;
+    MayThrowMove& operator=(MayThrowMove&& rhs) = default;
+
+    int value;
+};
+
+// Default construction throws once constructions_left runs out
+struct ThrowingDefault {
+    inline static size_t constructions_left = numeric_limits<size_t>::max();
+    inline static long alive = 0;
+
+    ThrowingDefault() {
+        if (constructions_left == 0) {
+            throw runtime_error("construction failed");
+        }
+        --constructions_left;
+        ++alive;
+    }
+    explicit ThrowingDefault(int v) noexcept
+        : value(v) {
+        ++alive;
+    }
+    ThrowingDefault(const ThrowingDefault& other) noexcept
+        : value(other.value) {
+        ++alive;
+    }
+    ~ThrowingDefault() {
+        --alive;
+    }
+
+    int value = 0;
+};
+
+void TestStrongExceptionSafety() {
+    cout << "Test strong exception safety" << endl;
+    auto values = [](const SimpleVector<MayThrowMove>& v) {
+        SimpleVector<int> result;
+        for (const MayThrowMove& item : v) {
+            result.PushBack(item.value);
+        }
+        return result;
+    };
+    auto expect_throw = [](auto operation) {
+        try {
+            operation();
+            assert(false);
+        } catch (const runtime_error&) {
+        }
+        MayThrowMove::copies_left = numeric_limits<size_t>::max();
+    };
+    {
+        // growth copies the elements of a type whose move may throw
+        SimpleVector<MayThrowMove> v;
+        MayThrowMove::copies = 0;
+        MayThrowMove::moves = 0;
+        for (int i = 0; i < 8; ++i) {
+            v.PushBack(MayThrowMove(i));
+        }
+        assert(MayThrowMove::moves == 8 && MayThrowMove::copies == 1 + 2 + 4);
+        const SimpleVector<int> before = values(v);
+        assert(v.GetCapacity() == 8);
+
+        // a failed copy during growth leaves the vector as it was
+        MayThrowMove::copies_left = 3;
+        expect_throw([&] { v.PushBack(MayThrowMove(8)); });
+        assert(values(v) == before && v.GetCapacity() == 8);
+        MayThrowMove::copies_left = 5;
+        expect_throw([&] { v.Resize(20); });
+        MayThrowMove::copies_left = 0;
+        expect_throw([&] { v.Reserve(100); });
+        assert(values(v) == before && v.GetCapacity() == 8);
+
+        // and so does one while inserting with spare capacity
+        v.Reserve(16);
+        MayThrowMove::copies_left = 4;
+        expect_throw([&] { v.Insert(v.begin() + 2, MayThrowMove(100)); });
+        expect_throw([&] {
+            MayThrowMove::copies_left = 6;
+            v.Emplace(v.begin() + 1, 200);
+        });
+        assert(values(v) == before && v.GetCapacity() == 16);
+        v.Insert(v.begin() + 2, MayThrowMove(100));
+        assert(v.GetSize() == 9 && v[2].value == 100 && v[3].value == 2 && v.GetCapacity() == 16);
+    }
+    {
+        // a default constructor that throws while growing leaves the buffer
+        // where it was
+        SimpleVector<ThrowingDefault> v;
+        for (int i = 0; i < 4; ++i) {
+            v.EmplaceBack(i);
+        }
+        const ThrowingDefault* data = v.begin();
+        ThrowingDefault::constructions_left = 3;
+        try {
+            v.Resize(10);
+            assert(false);
+        } catch (const runtime_error&) {
+        }
+        assert(v.GetSize() == 4 && v.GetCapacity() == 4 && v.begin() == data && v[3].value == 3);
+        assert(ThrowingDefault::alive == 4);
+        ThrowingDefault::constructions_left = numeric_limits<size_t>::max();
+        v.Resize(10);
+        assert(v.GetSize() == 10 && v[3].value == 3 && v[9].value == 0 && ThrowingDefault::alive == 10);
+    }
+    assert(ThrowingDefault::alive == 0);
+    {
+        // nothrow moves never fall back to copying
+        SimpleVector<MoveCounter> v;
+        MoveCounter::copies = 0;
+        for (int i = 0; i < 100; ++i) {
+            v.EmplaceBack("x"s, i);
+        }
+        v.Insert(v.begin() + 1, MoveCounter("y"s, -1));
+        assert(MoveCounter::copies == 0 && v[1].id == -1);
+    }
+    cout << "Done!" << endl << endl;
+}
+
+void TestInstrumentation() {
+    cout << "Test instrumentation" << endl;
+    auto& registry = InstrumentationRegistry::Instance();
+    registry.Reset();
+    {
+        SIMPLE_VECTOR_CALL_SITE("test/growth");
+        SimpleVector<int> v;
+        for (int i = 0; i < 100; ++i) {
+            v.PushBack(i);
+        }
+        {
+            SIMPLE_VECTOR_CALL_SITE("test/shifts");
+            v.Insert(v.begin() + 10, -1);
+            v.Erase(v.begin(), v.begin() + 5);
+            v.Insert(v.begin(), 3, 0);
+        }
+        // back to the outer site
+        SimpleVector<int> copy = v;
+    }
+    SimpleVector<int> untagged(10);
+
+    auto growth = registry.Get("test/growth").Snapshot();
+    assert(growth.allocations == 8 + 1 && growth.reallocations == 7 && growth.elements_moved == 127);
+    assert(growth.bytes_allocated == (255 + 99) * sizeof(int) && growth.peak_capacity_bytes == 128 * sizeof(int));
+    auto shifts = registry.Get("test/shifts").Snapshot();
+    assert(shifts.allocations == 0 && shifts.reallocations == 0);
+    assert(shifts.elements_shifted == 90 + 96 + 96);
+    assert(registry.Get("untagged").Snapshot().bytes_allocated >= 10 * sizeof(int));
+
+    ostringstream dump;
+    registry.Dump(dump);
+    assert(dump.str().find("test/shifts allocations=0 bytes_allocated=0 reallocations=0 elements_moved=0 "
+                           "elements_shifted=282 peak_capacity_bytes=0\n") != string::npos);
+    size_t tags = 0;
+    registry.ForEach([&tags](const string&, const VectorCountersSnapshot&) {
+        ++tags;
+    });
+    assert(tags >= 3);
+    registry.Reset();
+    assert(registry.Get("test/growth").Snapshot().allocations == 0);
+    cout << "Done!" << endl << endl;
+}
+
+template <size_t Alignment, typename Vector>
+bool IsAligned(const Vector& v) {
+    return reinterpret_cast<uintptr_t>(v.Data()) % Alignment == 0;
+}
+
+void TestAlignedSimpleVector() {
+    cout << "Test aligned simple vector" << endl;
+    static_assert(SimpleVector<float>::kAlignment == alignof(float));
+    static_assert(AlignedSimpleVector<float>::kAlignment == 64);
+    {
+        AlignedSimpleVector<float> v;
+        assert(v.Data() == nullptr);
+        for (int i = 0; i < 1000; ++i) {
+            v.PushBack(static_cast<float>(i));
+            assert(IsAligned<64>(v));
+        }
+        assert(v.Data() == v.begin() && v.Data()[999] == 999.0f);
+        v.Reserve(5000);
+        assert(IsAligned<64>(v));
+        v.Resize(10000);
+        assert(IsAligned<64>(v) && v[999] == 999.0f && v[9999] == 0.0f);
+        v.Insert(v.begin(), 100, -1.0f);
+        v.ShrinkToFit();
+        assert(IsAligned<64>(v) && v.GetCapacity() == v.GetSize());
+
+        AlignedSimpleVector<float> copy = v;
+        AlignedSimpleVector<float> moved = move(v);
+        assert(IsAligned<64>(copy) && IsAligned<64>(moved) && copy == moved);
+        AlignedSimpleVector<float> other(3, 1.0f);
+        other.swap(moved);
+        assert(IsAligned<64>(other) && IsAligned<64>(moved) && other == copy && moved.GetSize() == 3);
+    }
+    {
+        // page alignment, for mapping tricks and huge pages
+        AlignedSimpleVector<char, 4096> pages(10);
+        assert(IsAligned<4096>(pages));
+        pages.Reserve(100000);
+        assert(IsAligned<4096>(pages) && pages[9] == 0);
+        AlignedSimpleVector<uint64_t, 2 * 1024 * 1024> huge(1);
+        assert(IsAligned<2 * 1024 * 1024>(huge));
+    }
+    {
+        // the allocator also serves the other containers
+        SmallSimpleVector<double, 2, AlignedAllocator<double, 64>> small{1.0, 2.0, 3.0};
+        assert(!small.IsInline() && reinterpret_cast<uintptr_t>(small.begin()) % 64 == 0);
+        ChunkedSimpleVector<int, AlignedAllocator<int, 128>, 32> chunked(100);
+        assert(reinterpret_cast<uintptr_t>(chunked.GetBlock(3)) % 128 == 0);
+    }
+    cout << "Done!" << endl << endl;
+}
+
+void TestSoaSimpleVector() {
+    cout << "Test SoA simple vector" << endl;
+    using Particles = SoaSimpleVector<float, float, int, string>;
+    static_assert(is_same_v<Particles::FieldType<3>, string> && Particles::kFieldCount == 4);
+    {
+        Particles particles;
+        assert(particles.IsEmpty() && particles.GetCapacity() == 0 && particles.Data<0>() == nullptr);
+        for (int i = 0; i < 100; ++i) {
+            particles.PushBack(static_cast<float>(i), 1.0f, i, to_string(i));
+        }
+        assert(particles.GetSize() == 100 && particles.GetCapacity() >= 100);
+        auto [x, vx, id, name] = particles[42];
+        assert(x == 42.0f && vx == 1.0f && id == 42 && name == "42");
+
+        // iteration writes through to the columns
+        for (auto [px, pvx, pid, pname] : particles) {
+            px += pvx;
+            (void)pid;
+            (void)pname;
+        }
+        SimpleVectorView<float> xs = particles.Column<0>();
+        assert(xs.GetSize() == 100 && xs.Data() == particles.Data<0>());
+        assert(accumulate(xs.begin(), xs.end(), 0.0f) == 5050.0f);
+
+        // PushBack from a row of the same vector survives the reallocation
+        particles.ShrinkToFit();
+        assert(particles.GetCapacity() == 100);
+        particles.PushBack(get<0>(particles[0]), get<1>(particles[0]), get<2>(particles[0]), get<3>(particles[0]));
+        particles.PushBack(Particles::ValueType{-1.0f, 0.0f, -1, "last"});
+        assert(particles.GetSize() == 102 && get<3>(particles[100]) == "0" && get<3>(particles.At(101)) == "last");
+
+        auto it = particles.Erase(particles.begin() + 10, particles.begin() + 20);
+        assert(it == particles.begin() + 10 && get<2>(*it) == 20 && particles.GetSize() == 92);
+        it = particles.Erase(particles.cbegin());
+        assert(get<2>(*it) == 1 && particles.Column<3>()[0] == "1");
+        particles.PopBack();
+        assert(get<3>(particles[particles.GetSize() - 1]) == "0");
+
+        const Particles copy = particles;
+        assert(copy == particles);
+        get<1>(particles[5]) = 2.0f;
+        assert(copy != particles && get<1>(copy[5]) == 1.0f);
+        Particles moved = move(particles);
+        assert(particles.IsEmpty() && moved.GetSize() == copy.GetSize());
+        particles = copy;
+        assert(particles == copy);
+
+        size_t count = 0;
+        for (auto row : copy) {
+            static_assert(is_same_v<decltype(row), tuple<const float&, const float&, const int&, const string&>>);
+            ++count;
+        }
+        assert(count == copy.GetSize() && copy.end() - copy.begin() == static_cast<ptrdiff_t>(count));
+
+        try {
+            particles.At(1000);
+            assert(false);
+        } catch (const out_of_range&) {
+        }
+    }
+    {
+        // the columns share one size and capacity
+        Particles particles(Reserve(50));
+        assert(particles.GetCapacity() == 50 && particles.IsEmpty());
+        particles.Resize(10);
+        assert(get<0>(particles[9]) == 0.0f && get<3>(particles[9]).empty());
+        particles.Reserve(200);
+        assert(particles.GetCapacity() == 200 && particles.GetSize() == 10 && particles.Column<2>().GetSize() == 10);
+        particles.Resize(3);
+        particles.Clear();
+        particles.ShrinkToFit();
+        assert(particles.GetCapacity() == 0);
+    }
+    {
+        // a throwing field leaves the other columns untouched
+        struct CopyThrows {
+            CopyThrows() = default;
+            CopyThrows(const CopyThrows&) {
+                throw runtime_error("copy failed");
+            }
+            CopyThrows(CopyThrows&&) noexcept = default;
+        };
+        SoaSimpleVector<string, CopyThrows> v(2);
+        CopyThrows source;
+        // the string column is built first and must be rolled back (ASan
+        // would report the leaked buffer otherwise)
+        try {
+            v.PushBack(string(100, 'x'), source);
+            assert(false);
+        } catch (const runtime_error&) {
+        }
+        v.ShrinkToFit();
+        try {
+            v.PushBack(string(100, 'x'), source);
+            assert(false);
+        } catch (const runtime_error&) {
+        }
+        assert(v.GetSize() == 2 && v.GetCapacity() == 2 && v.Column<0>()[1].empty());
+    }
+    cout << "Done!" << endl << endl;
+}
+
+void TestCowSimpleVector() {
+    cout << "Test copy-on-write simple vector" << endl;
+    {
+        CowSimpleVector<int> empty;
+        assert(empty.IsEmpty() && empty.GetUseCount() == 0 && empty.begin() == empty.end());
+        CowSimpleVector<int> copy_of_empty = empty;
+        copy_of_empty.PushBack(1);
+        assert(empty.IsEmpty() && copy_of_empty.GetSize() == 1 && copy_of_empty.GetUseCount() == 1);
+    }
+    {
+        const CowSimpleVector<int> original{1, 2, 3, 4, 5};
+        CowSimpleVector<int> copy = original;
+        // copies share the buffer until one of them is mutated
+        assert(copy.GetUseCount() == 2 && copy.Get().begin() == original.Get().begin());
+        assert(as_const(copy)[2] == 3 && copy == original);
+
+        copy[0] = 10;
+        assert(!copy.IsShared() && !original.IsShared() && copy.Get().begin() != original.Get().begin());
+        assert(original[0] == 1 && copy[0] == 10 && copy != original && original < copy);
+
+        // iterators from the shared buffer are carried over the detach
+        CowSimpleVector<int> inserted = original;
+        auto it = inserted.Insert(inserted.cbegin() + 2, 0);
+        assert(*it == 0 && inserted.GetSize() == 6 && inserted[2] == 0 && original.GetSize() == 5);
+        CowSimpleVector<int> erased = original;
+        it = erased.Erase(erased.cbegin() + 1, erased.cbegin() + 3);
+        assert(*it == 4 && erased.GetSize() == 3 && original[1] == 2);
+
+        CowSimpleVector<int> resized = original;
+        resized.Resize(2);
+        CowSimpleVector<int> pushed = original;
+        pushed.PushBack(as_const(pushed)[4]);
+        assert(resized.GetSize() == 2 && pushed.GetSize() == 6 && pushed[5] == 5 && original.GetSize() == 5);
+
+        CowSimpleVector<int> cleared = original;
+        cleared.Clear();
+        assert(cleared.IsEmpty() && original.GetSize() == 5 && original.GetUseCount() == 1);
+
+        // a sole owner is mutated in place
+        const int* data = copy.Get().begin();
+        copy.Mutable().Reserve(copy.GetCapacity());
+        copy.At(1) = 20;
+        copy.Clear();
+        assert(copy.Get().begin() == data && copy.IsEmpty() && copy.GetCapacity() >= 5);
+
+        CowSimpleVector<int> assigned;
+        assigned = original;
+        CowSimpleVector<int> moved = move(assigned);
+        assert(moved.GetUseCount() == 2 && assigned.GetUseCount() == 0);
+        assigned = moved;
+        assigned = move(moved);
+        assert(assigned.GetUseCount() == 2 && moved.IsEmpty());
+
+        SimpleVector<int> source{7, 8};
+        const int* source_data = source.begin();
+        CowSimpleVector<int> adopted(move(source));
+        assert(adopted.Get().begin() == source_data && adopted.View().GetSize() == 2);
+    }
+    {
+        // a reference taken for writing keeps later copies off the buffer
+        CowSimpleVector<int> v{1, 2, 3};
+        int& first = v[0];
+        CowSimpleVector<int> copy = v;
+        first = 100;
+        assert(as_const(copy)[0] == 1 && as_const(v)[0] == 100 && !v.IsShared() && !copy.IsShared());
+
+        CowSimpleVector<int> iterated{1, 2, 3};
+        auto it = iterated.begin();
+        const CowSimpleVector<int> iterated_copy = iterated;
+        *it = 100;
+        assert(iterated_copy[0] == 1 && as_const(iterated)[0] == 100);
+
+        // plain updates hand nothing out, and Clear makes the buffer
+        // shareable again
+        CowSimpleVector<int> pushed{1};
+        pushed.PushBack(2);
+        CowSimpleVector<int> pushed_copy = pushed;
+        assert(pushed.GetUseCount() == 2);
+        v.Clear();
+        v.PushBack(5);
+        CowSimpleVector<int> shared_again = v;
+        assert(v.GetUseCount() == 2);
+
+        assert(copy <= copy && copy >= copy && !(copy > copy) && (v > copy) && (copy <= v) && !(copy >= v));
+    }
+    {
+        // fan out to threads that read, drop or modify their copies
+        const CowSimpleVector<string> config(1000, "value");
+        vector<thread> workers;
+        atomic<size_t> total{0};
+        for (int t = 0; t < 8; ++t) {
+            workers.emplace_back([&config, &total, t] {
+                for (int round = 0; round < 200; ++round) {
+                    CowSimpleVector<string> copy = config;
+                    CowSimpleVector<string> second = copy;
+                    if ((round + t) % 50 == 0) {
+                        second[0] = "changed";
+                        assert(second[0] == "changed");
+                    }
+                    total += copy.GetSize() + as_const(second)[999].size();
+                }
+            });
+        }
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        assert(total == 8 * 200 * 1005 && config.GetUseCount() == 1 && config[0] == "value");
+    }
+    cout << "Done!" << endl << endl;
+}
+
+void TestPoolAllocator() {
+    cout << "Test pool allocator" << endl;
+    static_assert(BufferPool::kMaxClassBytes == 1024 * 1024);
+    assert(BufferPool::ClassBytes(1) == 64 && BufferPool::ClassBytes(64) == 64 && BufferPool::ClassBytes(65) == 128);
+    assert(BufferPool::ClassBytes(BufferPool::kMaxClassBytes + 1) == BufferPool::kMaxClassBytes + 1);
+
+    BufferPool& pool = BufferPool::Local();
+    pool.Trim();
+    pool.ResetStats();
+    {
+        // a buffer comes back to the next vector of the same size class
+        const int* first_buffer = nullptr;
+        {
+            PooledSimpleVector<int> v(Reserve(100));
+            first_buffer = v.begin();
+        }
+        assert(pool.GetStats().misses == 1 && pool.GetStats().recycled == 1 && pool.GetStats().cached_bytes == 512);
+        PooledSimpleVector<int> v(Reserve(120));
+        assert(v.begin() == first_buffer && pool.GetStats().hits == 1 && pool.GetStats().cached_bytes == 0);
+        for (int i = 0; i < 1000; ++i) {
+            v.PushBack(i);
+        }
+        assert(v[999] == 999 && pool.GetStats().recycled == 5);
+    }
+    {
+        // at most kCacheDepth buffers per class are kept
+        pool.Trim();
+        pool.ResetStats();
+        vector<PooledSimpleVector<char>> many;
+        for (size_t i = 0; i < BufferPool::kCacheDepth + 2; ++i) {
+            many.emplace_back(Reserve(1000));
+        }
+        many.clear();
+        assert(pool.GetStats().recycled == BufferPool::kCacheDepth && pool.GetStats().released == 2);
+        assert(pool.GetStats().cached_bytes == BufferPool::kCacheDepth * 1024);
+
+        PooledSimpleVector<char> huge(2 * BufferPool::kMaxClassBytes);
+        assert(huge[huge.GetSize() - 1] == 0);
+    }
+    {
+        // buffers may move between threads; each thread's cache is freed
+        // when it exits
+        PooledSimpleVector<string> from_worker;
+        thread worker([&from_worker] {
+            PooledSimpleVector<string> local(100, "pooled");
+            from_worker = move(local);
+            PooledSimpleVector<int> cached(Reserve(10));
+        });
+        worker.join();
+        assert(from_worker.GetSize() == 100 && from_worker[99] == "pooled");
+    }
+    {
+        // a buffer allocated after its thread's pool has closed is still a
+        // whole size class, so another thread can cache and reuse it
+        struct LateAllocation {
+            ~LateAllocation() {
+                *out = BufferPool::Local().Allocate(100);
+            }
+            void** out = nullptr;
+        };
+        void* late_buffer = nullptr;
+        thread worker([&late_buffer] {
+            // constructed before the pool, so destroyed after it has closed
+            thread_local LateAllocation late;
+            late.out = &late_buffer;
+            BufferPool::Local();
+        });
+        worker.join();
+        assert(late_buffer != nullptr);
+        pool.Trim();
+        pool.ResetStats();
+        pool.Deallocate(late_buffer, 100);
+        void* reused = pool.Allocate(BufferPool::ClassBytes(100));
+        assert(reused == late_buffer && pool.GetStats().hits == 1);
+        memset(reused, 0, BufferPool::ClassBytes(100));
+        pool.Deallocate(reused, BufferPool::ClassBytes(100));
+    }
+    pool.Trim();
+    assert(pool.GetStats().cached_bytes == 0);
+    cout << "Done!" << endl << endl;
+}
+
+constexpr StaticSimpleVector<int, 16> MakeSquares() {
+    StaticSimpleVector<int, 16> squares;
+    for (int i = 0; i < 16; ++i) {
+        squares.PushBack(i * i);
+    }
+    return squares;
+}
+
+constexpr StaticSimpleVector<int, 8> EditedAtCompileTime() {
+    StaticSimpleVector<int, 8> v{1, 2, 3, 4};
+    v.Insert(v.begin() + 1, v[3]);
+    v.Erase(v.begin() + 3, v.begin() + 5);
+    v.EmplaceBack(9);
+    v.Resize(5);
+    StaticSimpleVector<int, 8> other(2, 7);
+    v.swap(other);
+    other.PopBack();
+    return other;
+}
+
+void TestStaticSimpleVector() {
+    cout << "Test static simple vector" << endl;
+    {
+        // usable in constant expressions
+        constexpr auto kSquares = MakeSquares();
+        static_assert(kSquares.GetSize() == 16 && kSquares.IsFull() && kSquares[15] == 225);
+        static_assert(kSquares.At(3) == 9 && *(kSquares.end() - 2) == 196);
+        constexpr auto kEdited = EditedAtCompileTime();
+        static_assert(kEdited == StaticSimpleVector<int, 8>{1, 4, 2, 9});
+        static_assert(kEdited < StaticSimpleVector<int, 8>{1, 5} && kEdited != StaticSimpleVector<int, 8>());
+        static_assert(StaticSimpleVector<char, 4>::GetCapacity() == 4 && sizeof(StaticSimpleVector<char, 4>) == 2 * sizeof(size_t));
+        int sum = 0;
+        for (int square : kSquares) {
+            sum += square;
+        }
+        assert(sum == 1240);
+    }
+    {
+        // non-trivial elements, at run time
+        StaticSimpleVector<string, 4> v;
+        v.PushBack("a");
+        v.EmplaceBack(3, 'b');
+        v.Insert(v.cbegin(), v[1]);
+        assert(v.GetSize() == 3 && v[0] == "bbb" && v[1] == "a" && v[2] == "bbb");
+        StaticSimpleVector<string, 4> copy = v;
+        v.Erase(v.begin());
+        assert(v.GetSize() == 2 && v[0] == "a" && copy.GetSize() == 3 && copy > v);
+        StaticSimpleVector<string, 4> moved = move(copy);
+        copy = v;
+        assert(moved.GetSize() == 3 && copy == v);
+        moved.swap(copy);
+        assert(moved == v && copy.GetSize() == 3 && copy.View().GetSize() == 3);
+        moved.Resize(4);
+        assert(moved.IsFull() && moved[3].empty());
+        moved.Clear();
+        assert(moved.IsEmpty());
+
+        // going over the capacity is a checked error
+        try {
+            copy.PushBack("d");
+            copy.PushBack("e");
+            assert(false);
+        } catch (const length_error&) {
+        }
+        assert(copy.GetSize() == 4 && copy[3] == "d");
+        try {
+            copy.Insert(copy.begin(), "f");
+            assert(false);
+        } catch (const length_error&) {
+        }
+        try {
+            StaticSimpleVector<int, 2> too_big{1, 2, 3};
+            assert(false);
+        } catch (const length_error&) {
+        }
+        try {
+            copy.At(4);
+            assert(false);
+        } catch (const out_of_range&) {
+        }
+    }
+    {
+        // a copy that throws part way destroys what it has built
+        StaticSimpleVector<ThrowingCopy, 8> source(5);
+        ThrowingCopy::copies_left = 3;
+        try {
+            StaticSimpleVector<ThrowingCopy, 8> copy(source);
+            assert(false);
+        } catch (const runtime_error&) {
+        }
+        assert(ThrowingCopy::alive == 5);
+    }
+    assert(ThrowingCopy::alive == 0);
+    cout << "Done!" << endl << endl;
+}
+
+void TestHugePageAllocator() {
+    cout << "Test huge page allocator" << endl;
+    HugePageStats& stats = GetHugePageStats();
+    const size_t kFloats = (8 << 20) / sizeof(float);
+    {
+        // small buffers stay with operator new
+        HugePageSimpleVector<float> small(1000);
+        assert(!small.GetAllocator().IsMapped(small.GetCapacity() * sizeof(float)));
+
+        const uint64_t mappings = stats.transparent_mappings + stats.plain_mappings;
+        HugePageSimpleVector<float> large(kFloats);
+#ifdef HUGE_PAGE_ALLOCATOR_HAS_MMAP
+        assert(stats.transparent_mappings + stats.plain_mappings == mappings + 1);
+        assert(reinterpret_cast<uintptr_t>(large.Data()) % HugePageSize(HugePages::kTransparent) == 0);
+#else
+        (void)mappings;
+#endif
+        large[kFloats - 1] = 1.0f;
+        large.PushBack(2.0f);
+        assert(large[kFloats - 1] == 1.0f && large[kFloats] == 2.0f && large[0] == 0.0f);
+        HugePageSimpleVector<float> moved = move(large);
+        moved.ShrinkToFit();
+        assert(moved.GetSize() == kFloats + 1 && moved[kFloats] == 2.0f);
+    }
+    {
+        // explicit huge pages fall back to transparent ones when none are reserved
+        const uint64_t attempts = stats.explicit_mappings + stats.hugetlb_fallbacks;
+        HugePageAllocator<float> explicit_pages(HugePageOptions{HugePages::kExplicit2M, NumaPolicy::kFirstTouch, 0});
+        HugePageSimpleVector<float> v(kFloats, 3.0f, explicit_pages);
+#ifdef HUGE_PAGE_ALLOCATOR_HAS_MMAP
+        assert(stats.explicit_mappings + stats.hugetlb_fallbacks == attempts + 1);
+#else
+        (void)attempts;
+#endif
+        assert(v.GetAllocator().GetOptions().pages == HugePages::kExplicit2M && v[kFloats / 2] == 3.0f);
+
+        // 1 GiB pages are only used for buffers of at least 1 GiB
+        HugePageAllocator<float> gigantic(HugePageOptions{HugePages::kExplicit1G, NumaPolicy::kFirstTouch, 0});
+        assert(!gigantic.IsMapped(kFloats * sizeof(float)) && gigantic != explicit_pages);
+    }
+    {
+        // a NUMA policy the kernel rejects leaves the buffer usable
+        for (NumaPolicy policy : {NumaPolicy::kBind, NumaPolicy::kInterleave, NumaPolicy::kPreferred}) {
+            HugePageAllocator<float> numa(HugePageOptions{HugePages::kTransparent, policy, 1});
+            HugePageSimpleVector<float> v(kFloats, 4.0f, numa);
+            assert(v[kFloats - 1] == 4.0f);
+        }
+        const uint64_t failures = stats.numa_failures;
+        HugePageAllocator<float> no_nodes(HugePageOptions{HugePages::kNone, NumaPolicy::kBind, 0});
+        HugePageSimpleVector<float> v(kFloats, no_nodes);
+#ifdef HUGE_PAGE_ALLOCATOR_HAS_MMAP
+        assert(stats.numa_failures == failures + 1);
+#else
+        (void)failures;
+#endif
+        assert(v[kFloats - 1] == 0.0f);
+    }
+    cout << "Done!" << endl << endl;
+}
+
+void TestSortedSimpleVector() {
+    cout << "Test sorted simple vector" << endl;
+    {
+        SortedSimpleVector<int> v{5, 1, 4, 1, 3};
+        assert((v.Get() == SimpleVector<int>{1, 3, 4, 5}));
+        assert(v.Contains(4) && !v.Contains(2) && v.Find(2) == v.end() && *v.Find(3) == 3);
+        assert(*v.LowerBound(2) == 3 && *v.UpperBound(3) == 4 && v.LowerBound(6) == v.end());
+
+        auto [it, inserted] = v.InsertSorted(2);
+        assert(inserted && *it == 2 && it == v.begin() + 1);
+        tie(it, inserted) = v.InsertSorted(4);
+        assert(!inserted && *it == 4 && v.GetSize() == 5);
+        v.InsertSorted(0);
+        v.InsertSorted(10);
+        assert((v.Get() == SimpleVector<int>{0, 1, 2, 3, 4, 5, 10}));
+
+        // the batch is sorted, deduplicated and merged in one pass
+        vector<int> batch{9, 2, 7, 9, 11, -1};
+        v.MergeBulk(batch.begin(), batch.end());
+        assert((v.Get() == SimpleVector<int>{-1, 0, 1, 2, 3, 4, 5, 7, 9, 10, 11}));
+        v.MergeBulk({20, 12});
+        assert(v.GetSize() == 13 && *(v.end() - 1) == 20);
+
+        assert(v.EraseKey(7) == 1 && v.EraseKey(7) == 0 && !v.Contains(7));
+        v.Erase(v.begin(), v.begin() + 2);
+        assert(*v.begin() == 1);
+
+        SortedSimpleVector<int, greater<>> descending{1, 3, 2};
+        assert(*descending.begin() == 3 && *descending.LowerBound(2) == 2 && descending.Contains(1));
+    }
+    {
+        // galloping insertion keeps random order sorted too
+        SortedSimpleVector<int> v;
+        mt19937 random(7);
+        set<int> reference;
+        for (int i = 0; i < 2000; ++i) {
+            int value = static_cast<int>(random() % 1000);
+            assert(v.InsertSorted(value).second == reference.insert(value).second);
+        }
+        assert(equal(v.begin(), v.end(), reference.begin(), reference.end()));
+    }
+    {
+        // the Eytzinger index answers like the binary search, for every
+        // tree shape and every probe
+        for (size_t size : {0, 1, 2, 3, 7, 8, 100, 1023, 1024, 1025}) {
+            SortedSimpleVector<int> v;
+            SimpleVector<int> evens;
+            for (size_t i = 0; i < size; ++i) {
+                evens.PushBack(static_cast<int>(2 * i));
+            }
+            v.MergeBulk(evens.begin(), evens.end());
+            v.BuildSearchIndex();
+            assert(v.HasSearchIndex());
+            for (int probe = -1; probe <= static_cast<int>(2 * size) + 1; ++probe) {
+                assert(v.LowerBound(probe) == lower_bound(evens.begin(), evens.end(), probe) - evens.begin() + v.begin());
+                assert(v.Contains(probe) == (probe >= 0 && probe < static_cast<int>(2 * size) && probe % 2 == 0));
+            }
+            v.InsertSorted(-5);
+            assert(!v.HasSearchIndex() && *v.begin() == -5);
+        }
+    }
+    {
+        FlatSimpleMap<string, int> map{{"b", 2}, {"a", 1}};
+        map["c"] = 3;
+        ++map["a"];
+        assert(map.GetSize() == 3 && map.At("a") == 2 && map["c"] == 3 && map.begin()->first == "a");
+        assert(map.FindValue("z") == nullptr && *map.FindValue("b") == 2);
+        map.InsertOrAssign("b", 20);
+        map.InsertOrAssign("d", 4);
+        assert(map.At("b") == 20 && map.GetSize() == 4 && (map.end() - 1)->first == "d");
+        for (auto& [key, value] : map) {
+            value *= 10;
+        }
+        const FlatSimpleMap<string, int>& const_map = map;
+        assert(const_map.At("d") == 40 && const_map.Contains("c") && *const_map.FindValue("a") == 20);
+        map.MergeBulk({{"a", -1}, {"e", 5}});
+        assert(map.At("a") == 20 && map.At("e") == 5);
+        try {
+            const_map.At("x");
+            assert(false);
+        } catch (const out_of_range&) {
+        }
+    }
+    cout << "Done!" << endl << endl;
+}
+
+#ifdef CHANNEL_HAS_COROUTINES
+// Starts running at once and frees its frame when it finishes
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
+
+Detached ProduceBatches(BatchChannel<int, SpscRing>& channel, int batches, int batch_size) {
+    for (int b = 0; b < batches; ++b) {
+        SimpleVector<int> batch = channel.TakeBatch();
+        for (int i = 0; i < batch_size; ++i) {
+            batch.PushBack(b * batch_size + i);
+        }
+        bool pushed = co_await channel.PushAsync(move(batch));
+        assert(pushed);
+    }
+    channel.Close();
+}
+
+Detached ConsumeBatches(BatchChannel<int, SpscRing>& channel, int64_t& sum, int& batches) {
+    SimpleVector<int> batch;
+    while (co_await channel.PopAsync(batch)) {
+        for (int item : batch) {
+            sum += item;
+        }
+        ++batches;
+        channel.Recycle(move(batch));
+    }
+}
+#endif
+
+void TestChannel() {
+    cout << "TestChannel"s << endl;
+    {
+        // SPSC ring: power-of-two capacity, FIFO order across the wrap
+        SpscRing<string> ring(3);
+        assert(ring.GetCapacity() == 4);
+        string out;
+        assert(!ring.TryPop(out));
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < 4; ++i) {
+                string item = to_string(i);
+                assert(ring.TryPush(move(item)) && item.empty());
+            }
+            string extra = "extra"s;
+            assert(!ring.TryPush(move(extra)) && extra == "extra"s);
+            for (int i = 0; i < 3; ++i) {
+                assert(ring.TryPop(out) && out == to_string(i));
+            }
+            assert(ring.TryPop(out) && out == "3"s);
+        }
+        string left = "left in the ring, freed by the destructor"s;
+        assert(ring.TryPush(move(left)));
+    }
+    {
+        // MPMC ring: every item comes out exactly once
+        MpmcRing<int> ring(64);
+        constexpr int kThreads = 3;
+        constexpr int kPerThread = 20000;
+        atomic<int64_t> sum{0};
+        atomic<int> popped{0};
+        vector<thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&ring, t] {
+                for (int i = 1; i <= kPerThread; ++i) {
+                    int item = t * kPerThread + i;
+                    while (!ring.TryPush(move(item))) {
+                        this_thread::yield();
+                    }
+                }
+            });
+            threads.emplace_back([&] {
+                int item;
+                while (popped.load() < kThreads * kPerThread) {
+                    if (ring.TryPop(item)) {
+                        sum += item;
+                        ++popped;
+                    } else {
+                        this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        const int64_t n = kThreads * kPerThread;
+        assert(popped.load() == n && sum.load() == n * (n + 1) / 2);
+    }
+    {
+        // blocking Push and Pop between threads, ended by Close
+        MpmcChannel<SimpleVector<int>> channel(2);
+        constexpr int kProducers = 2;
+        constexpr int kBatches = 500;
+        atomic<int64_t> sum{0};
+        vector<thread> consumers;
+        for (int c = 0; c < 2; ++c) {
+            consumers.emplace_back([&] {
+                SimpleVector<int> batch;
+                while (channel.Pop(batch)) {
+                    sum += accumulate(batch.begin(), batch.end(), int64_t{0});
+                }
+            });
+        }
+        vector<thread> producers;
+        for (int p = 0; p < kProducers; ++p) {
+            producers.emplace_back([&] {
+                for (int b = 0; b < kBatches; ++b) {
+                    assert(channel.Push(SimpleVector<int>{1, 2, 3}));
+                }
+            });
+        }
+        for (thread& producer : producers) {
+            producer.join();
+        }
+        channel.Close();
+        for (thread& consumer : consumers) {
+            consumer.join();
+        }
+        assert(sum.load() == kProducers * kBatches * 6);
+        SimpleVector<int> late{1};
+        assert(channel.IsClosed() && !channel.Push(move(late)) && !channel.TryPush(move(late)));
+        assert(late.GetSize() == 1);
+    }
+    {
+        // consumers drain what was pushed before Close
+        SpscChannel<int> channel(4);
+        assert(channel.TryPush(1) && channel.TryPush(2));
+        channel.Close();
+        int item = 0;
+        assert(channel.Pop(item) && item == 1 && channel.Pop(item) && item == 2 && !channel.Pop(item));
+    }
+    {
+        // drained batches come back to the producer with their storage
+        BatchChannel<int> channel(4, 16);
+        SimpleVector<int> batch = channel.TakeBatch();
+        assert(batch.IsEmpty() && batch.GetCapacity() >= 16);
+        batch.PushBack(7);
+        const int* storage = batch.begin();
+        assert(channel.Push(move(batch)));
+        SimpleVector<int> received;
+        assert(channel.Pop(received) && received.GetSize() == 1 && received.begin() == storage);
+        channel.Recycle(move(received));
+        SimpleVector<int> reused = channel.TakeBatch();
+        assert(reused.IsEmpty() && reused.begin() == storage);
+    }
+    {
+        // spare batches beyond the channel's capacity are freed, not left
+        // with the caller
+        BatchChannel<int> channel(2, 16);
+        SimpleVector<int> batches[3] = {channel.TakeBatch(), channel.TakeBatch(), channel.TakeBatch()};
+        const int* kept[2] = {batches[0].begin(), batches[1].begin()};
+        for (auto& batch : batches) {
+            channel.Recycle(move(batch));
+            assert(batch.GetCapacity() == 0);
+        }
+        SimpleVector<int> first = channel.TakeBatch();
+        SimpleVector<int> second = channel.TakeBatch();
+        assert(first.begin() == kept[0] && second.begin() == kept[1]);
+    }
+#ifdef CHANNEL_HAS_COROUTINES
+    {
+        // coroutines on one thread: each side suspends when the ring is full
+        // or empty and is resumed by the other
+        BatchChannel<int, SpscRing> channel(2, 8);
+        int64_t sum = 0;
+        int batches = 0;
+        ConsumeBatches(channel, sum, batches);
+        assert(batches == 0);
+        ProduceBatches(channel, 100, 8);
+        assert(batches == 100 && sum == 800 * 799 / 2);
+    }
+#endif
+    cout << "Done!" << endl << endl;
+}
+
+void TestVectorExpression() {
+    cout << "TestVectorExpression"s << endl;
+    using namespace vector_expression;
+    const SimpleVector<double> b{1.0, 2.0, 3.0, 4.0};
+    const SimpleVector<double> c{2.0, 2.0, 2.0, 2.0};
+    const SimpleVector<double> d{0.5, 0.5, 0.5, 0.5};
+    {
+        // a = b * c + d, into an empty destination and into one that is big enough
+        SimpleVector<double> a;
+        a = b * c + d;
+        assert((a == SimpleVector<double>{2.5, 4.5, 6.5, 8.5}));
+        const double* storage = a.begin();
+        a = (b - d) / c;
+        assert((a == SimpleVector<double>{0.25, 0.75, 1.25, 1.75}) && a.begin() == storage);
+        a = -b;
+        assert((a == SimpleVector<double>{-1.0, -2.0, -3.0, -4.0}));
+    }
+    {
+        // scalars on either side, construction and Evaluate
+        SimpleVector<double> e = 2.0 * b - 1.0;
+        assert((e == SimpleVector<double>{1.0, 3.0, 5.0, 7.0}) && e.GetCapacity() == 4);
+        auto f = Evaluate(b / 2);
+        static_assert(is_same_v<decltype(f), SimpleVector<double>>);
+        assert((f == SimpleVector<double>{0.5, 1.0, 1.5, 2.0}));
+    }
+    {
+        // the destination as an operand, and compound assignment
+        SimpleVector<double> a = b;
+        a = a * a + b;
+        assert((a == SimpleVector<double>{2.0, 6.0, 12.0, 20.0}));
+        a += c * d;
+        a -= 1.0;
+        a *= c;
+        a /= b;
+        assert((a == SimpleVector<double>{4.0, 6.0, 8.0, 10.0}));
+    }
+    {
+        // mixed element types, views and a smaller destination type
+        const SimpleVector<int> counts{1, 2, 3, 4};
+        SimpleVector<double> g = counts * 0.5 + 3;
+        assert((g == SimpleVector<double>{3.5, 4.0, 4.5, 5.0}));
+        SimpleVector<int> h;
+        h = b * c;
+        assert((h == SimpleVector<int>{2, 4, 6, 8}));
+        SimpleVector<double> i = b.Slice(0, 2) + c.Slice(2, 2);
+        assert((i == SimpleVector<double>{3.0, 4.0}));
+    }
+    {
+        // operands must have the same size
+        const SimpleVector<double> shorter{1.0};
+        SimpleVector<double> a{9.0, 9.0};
+        try {
+            a = b + shorter;
+            assert(false);
+        } catch (const length_error&) {
+        }
+        assert((a == SimpleVector<double>{9.0, 9.0}));
+    }
+    cout << "Done!" << endl << endl;
+}
+
 int main() {
     TestTemporaryObjConstructor();
     TestTemporaryObjOperator();
@@ -158,5 +2753,38 @@ int main() {
     TestNoncopiablePushBack();
     TestNoncopiableInsert();
     TestNoncopiableErase();
+    TestReserveDoesNotConstruct();
+    TestNoDefaultConstructible();
+    TestCustomAllocator();
+    TestRangeInsert();
+    TestEmplace();
+    TestTriviallyCopyableFastPaths();
+    TestSmallSimpleVector();
+    TestGrowthPolicies();
+    TestShrink();
+    TestEraseRange();
+    TestSwapRemove();
+    TestComparisonKernels();
+    TestParallelAlgorithms();
+    TestConcurrentSimpleVector();
+    TestChunkedSimpleVector();
+#ifdef MAPPED_SIMPLE_VECTOR_AVAILABLE
+    TestMappedSimpleVector();
+#endif
+    TestSerialization();
+    TestSimpleVectorView();
+    TestMoveCounts();
+    TestTriviallyRelocatable();
+    TestStrongExceptionSafety();
+    TestInstrumentation();
+    TestAlignedSimpleVector();
+    TestSoaSimpleVector();
+    TestCowSimpleVector();
+    TestPoolAllocator();
+    TestStaticSimpleVector();
+    TestHugePageAllocator();
+    TestSortedSimpleVector();
+    TestChannel();
+    TestVectorExpression();
     return 0;
 }
\ No newline at end of file
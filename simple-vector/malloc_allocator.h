@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <new>
+
+// Allocator on top of malloc/realloc/free. ArrayPtr detects reallocate() and
+// grows buffers of trivially copyable elements with realloc, which can
+// extend a block in place or remap large blocks without copying them.
+template <typename Type>
+class MallocAllocator {
+public:
+    using value_type = Type;
+
+    static_assert(alignof(Type) <= alignof(std::max_align_t), "malloc does not guarantee this alignment");
+
+    MallocAllocator() noexcept = default;
+
+    template <typename Other>
+    MallocAllocator(const MallocAllocator<Other>&) noexcept {}
+
+    Type* allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(Type)) {
+            throw std::bad_array_new_length();
+        }
+        void* ptr = std::malloc(n * sizeof(Type));
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<Type*>(ptr);
+    }
+
+    void deallocate(Type* ptr, size_t) noexcept {
+        std::free(ptr);
+    }
+
+    // The contents are carried over bytewise, so only trivially copyable
+    // elements may live in a reallocated buffer
+    Type* reallocate(Type* ptr, size_t, size_t new_n) {
+        if (new_n > std::numeric_limits<size_t>::max() / sizeof(Type)) {
+            throw std::bad_array_new_length();
+        }
+        void* new_ptr = std::realloc(ptr, new_n * sizeof(Type));
+        if (!new_ptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<Type*>(new_ptr);
+    }
+
+    template <typename Other>
+    bool operator==(const MallocAllocator<Other>&) const noexcept {
+        return true;
+    }
+
+    template <typename Other>
+    bool operator!=(const MallocAllocator<Other>&) const noexcept {
+        return false;
+    }
+};
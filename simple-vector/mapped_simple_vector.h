@@ -0,0 +1,413 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include "growth_policy.h"
+
+#if __has_include(<sys/mman.h>) && __has_include(<sys/stat.h>) && __has_include(<fcntl.h>) && \
+    __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_SIMPLE_VECTOR_AVAILABLE 1
+#endif
+
+#ifdef MAPPED_SIMPLE_VECTOR_AVAILABLE
+
+// Access pattern hints for MappedSimpleVector::Advise
+enum class MappedAccess {
+    kNormal,
+    kSequential,
+    kRandom,
+    kWillNeed,
+};
+
+// SimpleVector of trivially copyable records whose buffer is a shared
+// mapping of a file. The file starts with a small header holding the element
+// count, so Open() gets a vector back without reading or copying anything:
+// pages are loaded on first access. Growth extends the file and the mapping
+// (mremap where available), which may move the mapping and, as with
+// SimpleVector, invalidates pointers and iterators. Changes reach the file
+// through the page cache; Sync() waits until they are on disk.
+template <typename Type, typename Growth = DoublingGrowth>
+class MappedSimpleVector {
+    static_assert(std::is_trivially_copyable_v<Type>, "the file holds the elements' bytes as they are");
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t element_size;
+        uint64_t size;
+    };
+
+    // The elements start at this offset into the file and the mapping
+    static constexpr size_t kHeaderSize = 64;
+    static_assert(sizeof(Header) <= kHeaderSize && alignof(Type) <= kHeaderSize);
+
+public:
+    using Iterator = Type*;
+    using ConstIterator = const Type*;
+    using GrowthPolicy = Growth;
+
+    static constexpr uint64_t kMagic = 0x5356'4d41'5050'4544;  // "SVMAPPED"
+    static constexpr uint32_t kVersion = 1;
+
+    // Not backed by a file; use Create or Open
+    MappedSimpleVector() noexcept = default;
+
+    // Creates (or truncates) the file at path, holding an empty vector
+    static MappedSimpleVector Create(const std::string& path, size_t capacity = 0) {
+        MappedSimpleVector vector;
+        vector.fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (vector.fd_ < 0) {
+            ThrowSystemError("open");
+        }
+        if (::ftruncate(vector.fd_, static_cast<off_t>(BytesFor(capacity))) != 0) {
+            ThrowSystemError("ftruncate");
+        }
+        vector.Map(capacity);
+        *vector.header_ = Header{kMagic, kVersion, sizeof(Type), 0};
+        return vector;
+    }
+
+    // Maps an existing file written by Create; nothing is read up front
+    static MappedSimpleVector Open(const std::string& path) {
+        MappedSimpleVector vector;
+        vector.fd_ = ::open(path.c_str(), O_RDWR);
+        if (vector.fd_ < 0) {
+            ThrowSystemError("open");
+        }
+        struct stat file_stat;
+        if (::fstat(vector.fd_, &file_stat) != 0) {
+            ThrowSystemError("fstat");
+        }
+        const size_t file_size = static_cast<size_t>(file_stat.st_size);
+        if (file_size < kHeaderSize) {
+            throw std::runtime_error("not a MappedSimpleVector file: " + path);
+        }
+        vector.Map((file_size - kHeaderSize) / sizeof(Type));
+        const Header& header = *vector.header_;
+        if (header.magic != kMagic || header.version != kVersion) {
+            throw std::runtime_error("not a MappedSimpleVector file: " + path);
+        }
+        if (header.element_size != sizeof(Type) || header.size > vector.capacity_) {
+            throw std::runtime_error("MappedSimpleVector file does not match the element type: " + path);
+        }
+        return vector;
+    }
+
+    MappedSimpleVector(const MappedSimpleVector&) = delete;
+    MappedSimpleVector& operator=(const MappedSimpleVector&) = delete;
+
+    MappedSimpleVector(MappedSimpleVector&& other) noexcept
+        : fd_(std::exchange(other.fd_, -1)),
+          header_(std::exchange(other.header_, nullptr)),
+          capacity_(std::exchange(other.capacity_, 0)) {}
+
+    MappedSimpleVector& operator=(MappedSimpleVector&& rhs) noexcept {
+        if (this != &rhs) {
+            Close();
+            fd_ = std::exchange(rhs.fd_, -1);
+            header_ = std::exchange(rhs.header_, nullptr);
+            capacity_ = std::exchange(rhs.capacity_, 0);
+        }
+        return *this;
+    }
+
+    ~MappedSimpleVector() {
+        Close();
+    }
+
+    bool IsOpen() const noexcept {
+        return header_ != nullptr;
+    }
+
+    // Unmaps the file; the data stays in it
+    void Close() noexcept {
+        if (header_) {
+            ::munmap(header_, BytesFor(capacity_));
+            header_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        capacity_ = 0;
+    }
+
+    // Writes the dirty pages back and waits for the disk
+    void Sync() {
+        assert(IsOpen());
+        if (::msync(header_, BytesFor(capacity_), MS_SYNC) != 0) {
+            ThrowSystemError("msync");
+        }
+    }
+
+    void Advise(MappedAccess access) {
+        assert(IsOpen());
+        int advice = MADV_NORMAL;
+        switch (access) {
+            case MappedAccess::kNormal:
+                advice = MADV_NORMAL;
+                break;
+            case MappedAccess::kSequential:
+                advice = MADV_SEQUENTIAL;
+                break;
+            case MappedAccess::kRandom:
+                advice = MADV_RANDOM;
+                break;
+            case MappedAccess::kWillNeed:
+                advice = MADV_WILLNEED;
+                break;
+        }
+        if (::madvise(header_, BytesFor(capacity_), advice) != 0) {
+            ThrowSystemError("madvise");
+        }
+    }
+
+    // Extends the file (and the mapping) to new_capacity elements
+    void Reserve(size_t new_capacity) {
+        assert(IsOpen());
+        if (new_capacity > capacity_) {
+            Remap(new_capacity);
+        }
+    }
+
+    // Truncates the file down to the elements in use
+    void ShrinkToFit() {
+        assert(IsOpen());
+        if (capacity_ > GetSize()) {
+            Remap(GetSize());
+        }
+    }
+
+    size_t GetSize() const noexcept {
+        return header_ ? static_cast<size_t>(header_->size) : 0;
+    }
+
+    size_t GetCapacity() const noexcept {
+        return capacity_;
+    }
+
+    bool IsEmpty() const noexcept {
+        return GetSize() == 0;
+    }
+
+    Type& operator[](size_t index) noexcept {
+        assert(index < GetSize());
+        return Data()[index];
+    }
+
+    const Type& operator[](size_t index) const noexcept {
+        assert(index < GetSize());
+        return Data()[index];
+    }
+
+    Type& At(size_t index) {
+        if (index >= GetSize()) {
+            throw std::out_of_range("Index out of range");
+        }
+        return Data()[index];
+    }
+
+    const Type& At(size_t index) const {
+        if (index >= GetSize()) {
+            throw std::out_of_range("Index out of range");
+        }
+        return Data()[index];
+    }
+
+    void Clear() noexcept {
+        if (header_) {
+            header_->size = 0;
+        }
+    }
+
+    // New elements are value-initialized, i.e. zeroed
+    void Resize(size_t new_size) {
+        assert(IsOpen());
+        const size_t size = GetSize();
+        if (new_size > size) {
+            if (new_size > capacity_) {
+                Remap(NextCapacity(new_size));
+            }
+            std::memset(static_cast<void*>(Elements() + size), 0, (new_size - size) * sizeof(Type));
+        }
+        header_->size = new_size;
+    }
+
+    void PushBack(const Type& item) {
+        EmplaceBack(item);
+    }
+
+    template <typename... Args>
+    Type& EmplaceBack(Args&&... args) {
+        assert(IsOpen());
+        // args may refer to an element the growth is about to move
+        Type value(std::forward<Args>(args)...);
+        const size_t size = GetSize();
+        if (size == capacity_) {
+            Remap(NextCapacity(size + 1));
+        }
+        Type* slot = new (Elements() + size) Type(value);
+        ++header_->size;
+        return *slot;
+    }
+
+    Iterator Insert(ConstIterator pos, const Type& value) {
+        assert(IsOpen());
+        const size_t offset = pos - begin();
+        const Type copy = value;
+        const size_t size = GetSize();
+        if (size == capacity_) {
+            Remap(NextCapacity(size + 1));
+        }
+        Type* slot = Elements() + offset;
+        std::memmove(static_cast<void*>(slot + 1), slot, (size - offset) * sizeof(Type));
+        std::memcpy(static_cast<void*>(slot), &copy, sizeof(Type));
+        ++header_->size;
+        return slot;
+    }
+
+    void PopBack() noexcept {
+        assert(IsOpen() && !IsEmpty());
+        --header_->size;
+    }
+
+    Iterator Erase(ConstIterator pos) {
+        return Erase(pos, pos + 1);
+    }
+
+    // Removes [first, last) with a single shift of the tail
+    Iterator Erase(ConstIterator first, ConstIterator last) {
+        assert(IsOpen());
+        const size_t offset = first - begin();
+        const size_t count = last - first;
+        if (count > 0) {
+            Type* hole = Elements() + offset;
+            std::memmove(static_cast<void*>(hole), hole + count, (GetSize() - offset - count) * sizeof(Type));
+            header_->size -= count;
+        }
+        return Data() + offset;
+    }
+
+    void swap(MappedSimpleVector& other) noexcept {
+        std::swap(fd_, other.fd_);
+        std::swap(header_, other.header_);
+        std::swap(capacity_, other.capacity_);
+    }
+
+    Iterator begin() noexcept {
+        return Data();
+    }
+
+    Iterator end() noexcept {
+        return Data() + GetSize();
+    }
+
+    ConstIterator begin() const noexcept {
+        return Data();
+    }
+
+    ConstIterator end() const noexcept {
+        return Data() + GetSize();
+    }
+
+    ConstIterator cbegin() const noexcept {
+        return begin();
+    }
+
+    ConstIterator cend() const noexcept {
+        return end();
+    }
+
+private:
+    [[noreturn]] static void ThrowSystemError(const char* what) {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    static size_t MaxSize() noexcept {
+        return (std::numeric_limits<off_t>::max() - kHeaderSize) / sizeof(Type);
+    }
+
+    static size_t BytesFor(size_t capacity) noexcept {
+        return kHeaderSize + capacity * sizeof(Type);
+    }
+
+    Type* Data() const noexcept {
+        return header_ ? Elements() : nullptr;
+    }
+
+    // Data() of an open vector. The mutators use it so that the compiler
+    // sees no null path: after a Remap it can't tell header_ is still set.
+    Type* Elements() const noexcept {
+        assert(IsOpen());
+        return reinterpret_cast<Type*>(reinterpret_cast<unsigned char*>(header_) + kHeaderSize);
+    }
+
+    size_t NextCapacity(size_t required) const {
+        if (required > MaxSize()) {
+            throw std::length_error("MappedSimpleVector is too long");
+        }
+        return std::clamp(Growth::Capacity(capacity_, required, sizeof(Type)), required, MaxSize());
+    }
+
+    void Map(size_t capacity) {
+        void* mapping = ::mmap(nullptr, BytesFor(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (mapping == MAP_FAILED) {
+            ThrowSystemError("mmap");
+        }
+        header_ = static_cast<Header*>(mapping);
+        capacity_ = capacity;
+    }
+
+    // Resizes the file and the mapping to new_capacity elements. The file is
+    // extended before the mapping grows and cut after it shrinks, so no page
+    // of the mapping is ever past the end of the file.
+    void Remap(size_t new_capacity) {
+        assert(IsOpen() && new_capacity >= GetSize());
+        if (new_capacity > MaxSize()) {
+            throw std::length_error("MappedSimpleVector is too long");
+        }
+        const size_t old_bytes = BytesFor(capacity_);
+        const size_t new_bytes = BytesFor(new_capacity);
+        if (new_bytes > old_bytes && ::ftruncate(fd_, static_cast<off_t>(new_bytes)) != 0) {
+            ThrowSystemError("ftruncate");
+        }
+#ifdef MREMAP_MAYMOVE
+        void* mapping = ::mremap(header_, old_bytes, new_bytes, MREMAP_MAYMOVE);
+        if (mapping == MAP_FAILED) {
+            ThrowSystemError("mremap");
+        }
+#else
+        void* mapping = ::mmap(nullptr, new_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (mapping == MAP_FAILED) {
+            ThrowSystemError("mmap");
+        }
+        ::munmap(header_, old_bytes);
+#endif
+        header_ = static_cast<Header*>(mapping);
+        capacity_ = new_capacity;
+        if (new_bytes < old_bytes && ::ftruncate(fd_, static_cast<off_t>(new_bytes)) != 0) {
+            ThrowSystemError("ftruncate");
+        }
+    }
+
+    int fd_ = -1;
+    // The mapping starts with the header; the elements follow at kHeaderSize
+    Header* header_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+#endif  // MAPPED_SIMPLE_VECTOR_AVAILABLE
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<pthread.h>) && __has_include(<sched.h>)
+#include <pthread.h>
+#include <sched.h>
+#define PARALLEL_HAS_AFFINITY 1
+#endif
+
+// Parallel bulk algorithms over random access ranges (SimpleVector iterators
+// included). Every algorithm splits the range into the same contiguous
+// chunks for the same size and thread count, and chunk i always runs on
+// worker i of one persistent ParallelPool. By default the workers are pinned
+// to the process's CPUs, worker i to the i-th one, so a vector built with
+// Parallel(n) is first-touched chunk by chunk and later passes with n
+// threads find each chunk on the NUMA node of the worker that handles it.
+
+// Where the pool's workers may run
+enum class WorkerPlacement {
+    // worker i stays on the i-th CPU the process may use (modulo their number)
+    kPinned,
+    // the OS scheduler moves the workers freely
+    kUnpinned,
+};
+
+// Process-wide set of worker threads shared by all the parallel helpers.
+// Workers are started on first need and live until the process exits; the
+// pool is never destroyed, so static destructors may still use it. One job
+// runs at a time: callers on other threads wait for it, and a task that
+// itself runs a parallel helper runs that one inline.
+class ParallelPool {
+public:
+    static ParallelPool& Global() {
+        static ParallelPool* pool = new ParallelPool();
+        return *pool;
+    }
+
+    ParallelPool(const ParallelPool&) = delete;
+    ParallelPool& operator=(const ParallelPool&) = delete;
+
+    // Runs task(index) for every index in [0, tasks) on worker index and
+    // waits for all of them. If a worker can't be started, its task and the
+    // ones after it run on the calling thread. The first exception thrown by
+    // a task is rethrown after every task has finished.
+    template <typename Task>
+    void Run(size_t tasks, Task& task) {
+        auto invoke = [](void* context, size_t index) {
+            (*static_cast<Task*>(context))(index);
+        };
+        if (tasks == 1 || InJob()) {
+            RunInline(tasks, invoke, &task);
+            return;
+        }
+        std::vector<std::exception_ptr> errors(tasks);
+        std::lock_guard<std::mutex> job_lock(job_mutex_);
+        const size_t started = StartWorkers(tasks);
+        const Job job{invoke, &task, errors.data(), started};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = job;
+            pending_ = started;
+            ++generation_;
+        }
+        wake_.notify_all();
+        InJob() = true;
+        for (size_t index = started; index < tasks; ++index) {
+            RunTask(job, index);
+        }
+        InJob() = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this] { return pending_ == 0; });
+        }
+        Rethrow(errors);
+    }
+
+    // Pins or unpins the running workers and the ones started later
+    void SetPlacement(WorkerPlacement placement) {
+        std::lock_guard<std::mutex> job_lock(job_mutex_);
+        placement_ = placement;
+        for (size_t index = 0; index < workers_.size(); ++index) {
+            Place(workers_[index], index);
+        }
+    }
+
+    WorkerPlacement GetPlacement() const {
+        std::lock_guard<std::mutex> job_lock(job_mutex_);
+        return placement_;
+    }
+
+    // Number of workers started so far
+    size_t GetWorkerCount() const {
+        std::lock_guard<std::mutex> job_lock(job_mutex_);
+        return workers_.size();
+    }
+
+    // The CPU worker index is pinned to, or -1 where pinning is unsupported
+    int GetWorkerCpu(size_t index) const noexcept {
+        return cpus_.empty() ? -1 : cpus_[index % cpus_.size()];
+    }
+
+private:
+    struct Job {
+        void (*invoke)(void*, size_t) = nullptr;
+        void* context = nullptr;
+        std::exception_ptr* errors = nullptr;
+        // tasks [0, workers) run on the workers
+        size_t workers = 0;
+    };
+
+    ParallelPool() {
+#ifdef PARALLEL_HAS_AFFINITY
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (::sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &allowed)) {
+                    cpus_.push_back(cpu);
+                }
+            }
+        }
+#endif
+    }
+
+    // Set on the thread running a job, worker or caller, so that nested
+    // parallel calls don't wait for themselves
+    static bool& InJob() noexcept {
+        thread_local bool in_job = false;
+        return in_job;
+    }
+
+    static void RunTask(const Job& job, size_t index) noexcept {
+        try {
+            job.invoke(job.context, index);
+        } catch (...) {
+            job.errors[index] = std::current_exception();
+        }
+    }
+
+    static void RunInline(size_t tasks, void (*invoke)(void*, size_t), void* context) {
+        std::vector<std::exception_ptr> errors(tasks);
+        const Job job{invoke, context, errors.data(), 0};
+        for (size_t index = 0; index < tasks; ++index) {
+            RunTask(job, index);
+        }
+        Rethrow(errors);
+    }
+
+    static void Rethrow(const std::vector<std::exception_ptr>& errors) {
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    // Starts workers up to count; returns how many there are, which is less
+    // than count only if a thread could not be started
+    size_t StartWorkers(size_t count) noexcept {
+        try {
+            workers_.reserve(count);
+            while (workers_.size() < count) {
+                const size_t index = workers_.size();
+                workers_.emplace_back(&ParallelPool::WorkerLoop, this, index);
+                Place(workers_.back(), index);
+            }
+        } catch (...) {
+        }
+        return std::min(workers_.size(), count);
+    }
+
+    void Place([[maybe_unused]] std::thread& worker, [[maybe_unused]] size_t index) noexcept {
+#ifdef PARALLEL_HAS_AFFINITY
+        if (cpus_.empty()) {
+            return;
+        }
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        if (placement_ == WorkerPlacement::kPinned) {
+            CPU_SET(GetWorkerCpu(index), &mask);
+        } else {
+            for (int cpu : cpus_) {
+                CPU_SET(cpu, &mask);
+            }
+        }
+        // placement is a hint: a worker that can't be pinned still works
+        ::pthread_setaffinity_np(worker.native_handle(), sizeof(mask), &mask);
+#endif
+    }
+
+    void WorkerLoop(size_t index) {
+        InJob() = true;
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [&] { return generation_ != seen; });
+            seen = generation_;
+            if (index >= job_.workers) {
+                continue;
+            }
+            const Job job = job_;
+            lock.unlock();
+            RunTask(job, index);
+            lock.lock();
+            if (--pending_ == 0) {
+                done_.notify_all();
+            }
+        }
+    }
+
+    // held by the caller for the whole of a job
+    mutable std::mutex job_mutex_;
+    std::vector<std::thread> workers_;
+    std::vector<int> cpus_;
+    WorkerPlacement placement_ = WorkerPlacement::kPinned;
+
+    // guards the job hand-off below
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    Job job_;
+    size_t generation_ = 0;
+    size_t pending_ = 0;
+};
+
+// Ranges shorter than this per thread are not worth a thread of their own
+inline constexpr size_t kMinParallelChunk = 1 << 14;
+
+inline size_t ParallelChunkCount(size_t count, size_t threads) noexcept {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::max<size_t>(1, std::min(threads, count / kMinParallelChunk));
+}
+
+// Half-open index range of chunk `index` out of `chunks` over [0, count)
+inline std::pair<size_t, size_t> ParallelChunkBounds(size_t count, size_t chunks, size_t index) noexcept {
+    const size_t base = count / chunks;
+    const size_t extra = count % chunks;
+    const size_t first = index * base + std::min(index, extra);
+    return {first, first + base + (index < extra ? 1 : 0)};
+}
+
+// Runs task(index) for every index in [0, tasks) on the global pool, task i
+// on worker i; see ParallelPool::Run
+template <typename Task>
+void ParallelForTasks(size_t tasks, Task task) {
+    ParallelPool::Global().Run(tasks, task);
+}
+
+// Runs body(chunk_index, first, last) for every chunk of [0, count), chunk i
+// on worker i
+template <typename Body>
+void ParallelForChunks(size_t count, size_t threads, Body body) {
+    const size_t chunks = ParallelChunkCount(count, threads);
+    ParallelForTasks(chunks, [&](size_t index) {
+        auto [first, last] = ParallelChunkBounds(count, chunks, index);
+        body(index, first, last);
+    });
+}
+
+// Tag for the parallel SimpleVector constructors, which simple_vector.h
+// declares but only this header makes usable
+struct ParallelProxy {
+    explicit ParallelProxy(size_t thread_count)
+        : threads(thread_count) {}
+
+    size_t ChunkCount(size_t count) const noexcept {
+        return ParallelChunkCount(count, threads);
+    }
+
+    template <typename Body>
+    void ForEachChunk(size_t count, Body body) const {
+        ParallelForChunks(count, threads, body);
+    }
+
+    size_t threads;
+};
+
+// threads == 0 means one per hardware thread
+inline ParallelProxy Parallel(size_t threads = 0) {
+    return ParallelProxy(threads);
+}
+
+template <typename RandomIt, typename Type>
+void ParallelFill(RandomIt first, RandomIt last, const Type& value, size_t threads = 0) {
+    ParallelForChunks(last - first, threads, [&](size_t, size_t chunk_first, size_t chunk_last) {
+        std::fill(first + chunk_first, first + chunk_last, value);
+    });
+}
+
+template <typename RandomIt, typename OutputIt, typename UnaryOp>
+OutputIt ParallelTransform(RandomIt first, RandomIt last, OutputIt d_first, UnaryOp op, size_t threads = 0) {
+    ParallelForChunks(last - first, threads, [&](size_t, size_t chunk_first, size_t chunk_last) {
+        std::transform(first + chunk_first, first + chunk_last, d_first + chunk_first, op);
+    });
+    return d_first + (last - first);
+}
+
+// op must be associative: chunks are reduced independently and the partial
+// results are then combined left to right after init
+template <typename RandomIt, typename Type, typename BinaryOp = std::plus<>>
+Type ParallelReduce(RandomIt first, RandomIt last, Type init, BinaryOp op = {}, size_t threads = 0) {
+    const size_t count = last - first;
+    std::vector<Type> partial(ParallelChunkCount(count, threads), init);
+    std::vector<char> has_partial(partial.size(), false);
+    ParallelForChunks(count, threads, [&](size_t index, size_t chunk_first, size_t chunk_last) {
+        if (chunk_first == chunk_last) {
+            return;
+        }
+        partial[index] = std::accumulate(first + chunk_first + 1, first + chunk_last, Type(first[chunk_first]), op);
+        has_partial[index] = true;
+    });
+    for (size_t index = 0; index < partial.size(); ++index) {
+        if (has_partial[index]) {
+            init = op(std::move(init), std::move(partial[index]));
+        }
+    }
+    return init;
+}
+
+// Sorts the chunks in parallel, then merges neighbouring runs pairwise, also in parallel
+template <typename RandomIt, typename Compare = std::less<>>
+void ParallelSort(RandomIt first, RandomIt last, Compare comp = {}, size_t threads = 0) {
+    const size_t count = last - first;
+    const size_t chunks = ParallelChunkCount(count, threads);
+    ParallelForChunks(count, chunks, [&](size_t, size_t chunk_first, size_t chunk_last) {
+        std::sort(first + chunk_first, first + chunk_last, comp);
+    });
+
+    std::vector<size_t> bounds;
+    for (size_t index = 0; index < chunks; ++index) {
+        bounds.push_back(ParallelChunkBounds(count, chunks, index).first);
+    }
+    bounds.push_back(count);
+    while (bounds.size() > 2) {
+        const size_t merges = (bounds.size() - 1) / 2;
+        ParallelForTasks(merges, [&](size_t merge) {
+            std::inplace_merge(first + bounds[2 * merge], first + bounds[2 * merge + 1],
+                               first + bounds[2 * merge + 2], comp);
+        });
+        std::vector<size_t> merged;
+        for (size_t index = 0; index < bounds.size(); index += 2) {
+            merged.push_back(bounds[index]);
+        }
+        if (merged.back() != count) {
+            merged.push_back(count);
+        }
+        bounds = std::move(merged);
+    }
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include "growth_policy.h"
+#include "simple_vector.h"
+
+// Counters of one thread's BufferPool
+struct PoolStats {
+    // allocations served from the cache
+    uint64_t hits = 0;
+    // allocations that went to the global allocator
+    uint64_t misses = 0;
+    // freed buffers kept in the cache
+    uint64_t recycled = 0;
+    // freed buffers handed back to the global allocator (cache full or
+    // oversized)
+    uint64_t released = 0;
+    size_t cached_bytes = 0;
+};
+
+// Per-thread cache of freed buffers in power-of-two size classes from 64 B to
+// 1 MiB, at most kCacheDepth buffers per class. Short-lived vectors that keep
+// asking for similar capacities get their buffers back from the cache instead
+// of the global allocator. Larger requests go straight to operator new.
+//
+// A buffer may be freed on another thread than the one that allocated it; it
+// then lands in the freeing thread's cache. Each thread's cache is emptied
+// when the thread exits, and buffers freed after that (say by a static
+// vector) go back to operator delete.
+class BufferPool {
+public:
+    static constexpr size_t kMinClassBytes = 64;
+    static constexpr size_t kClassCount = 15;
+    static constexpr size_t kMaxClassBytes = kMinClassBytes << (kClassCount - 1);
+    static constexpr size_t kCacheDepth = 8;
+
+    // The calling thread's pool
+    static BufferPool& Local() noexcept {
+        // The pool itself is trivially destructible, so it can still be
+        // reached once the reaper has emptied it at thread exit
+        thread_local BufferPool pool;
+        thread_local Reaper reaper{pool};
+        return pool;
+    }
+
+    // Bytes actually reserved for a request of bytes
+    static size_t ClassBytes(size_t bytes) noexcept {
+        return bytes > kMaxClassBytes ? bytes : kMinClassBytes << ClassOf(bytes);
+    }
+
+    void* Allocate(size_t bytes) {
+        if (bytes > kMaxClassBytes || closed_) {
+            // still a whole class: the buffer may be freed into, and reused
+            // from, another thread's cache
+            ++stats_.misses;
+            return ::operator new(ClassBytes(bytes));
+        }
+        const size_t size_class = ClassOf(bytes);
+        if (counts_[size_class] > 0) {
+            ++stats_.hits;
+            stats_.cached_bytes -= kMinClassBytes << size_class;
+            return free_[size_class][--counts_[size_class]];
+        }
+        ++stats_.misses;
+        return ::operator new(kMinClassBytes << size_class);
+    }
+
+    // bytes must be the size passed to Allocate
+    void Deallocate(void* ptr, size_t bytes) noexcept {
+        if (bytes > kMaxClassBytes) {
+            ++stats_.released;
+            ::operator delete(ptr, bytes);
+            return;
+        }
+        const size_t size_class = ClassOf(bytes);
+        if (closed_ || counts_[size_class] == kCacheDepth) {
+            ++stats_.released;
+            ::operator delete(ptr, kMinClassBytes << size_class);
+            return;
+        }
+        ++stats_.recycled;
+        stats_.cached_bytes += kMinClassBytes << size_class;
+        free_[size_class][counts_[size_class]++] = ptr;
+    }
+
+    // Frees every cached buffer
+    void Trim() noexcept {
+        for (size_t size_class = 0; size_class < kClassCount; ++size_class) {
+            while (counts_[size_class] > 0) {
+                ::operator delete(free_[size_class][--counts_[size_class]], kMinClassBytes << size_class);
+            }
+        }
+        stats_.cached_bytes = 0;
+    }
+
+    const PoolStats& GetStats() const noexcept {
+        return stats_;
+    }
+
+    // Zeroes the counters; cached_bytes keeps describing the cache
+    void ResetStats() noexcept {
+        stats_ = PoolStats{0, 0, 0, 0, stats_.cached_bytes};
+    }
+
+private:
+    struct Reaper {
+        ~Reaper() {
+            pool.Trim();
+            pool.closed_ = true;
+        }
+
+        BufferPool& pool;
+    };
+
+    // ceil(log2(bytes / kMinClassBytes)), for bytes <= kMaxClassBytes
+    static size_t ClassOf(size_t bytes) noexcept {
+        size_t size_class = 0;
+        while ((kMinClassBytes << size_class) < bytes) {
+            ++size_class;
+        }
+        return size_class;
+    }
+
+    void* free_[kClassCount][kCacheDepth] = {};
+    uint32_t counts_[kClassCount] = {};
+    PoolStats stats_;
+    bool closed_ = false;
+};
+
+// Allocator drawing from the calling thread's BufferPool, so ArrayPtr, and
+// with it SimpleVector, recycles buffers across vector lifetimes
+template <typename Type>
+class PoolAllocator {
+    static_assert(alignof(Type) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                  "pooled buffers only have the default operator new alignment");
+
+public:
+    using value_type = Type;
+
+    PoolAllocator() noexcept = default;
+
+    template <typename Other>
+    PoolAllocator(const PoolAllocator<Other>&) noexcept {}
+
+    Type* allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(Type)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<Type*>(BufferPool::Local().Allocate(n * sizeof(Type)));
+    }
+
+    void deallocate(Type* ptr, size_t n) noexcept {
+        BufferPool::Local().Deallocate(ptr, n * sizeof(Type));
+    }
+
+    template <typename Other>
+    bool operator==(const PoolAllocator<Other>&) const noexcept {
+        return true;
+    }
+
+    template <typename Other>
+    bool operator!=(const PoolAllocator<Other>&) const noexcept {
+        return false;
+    }
+};
+
+template <typename Type, typename Growth = DoublingGrowth>
+using PooledSimpleVector = SimpleVector<Type, PoolAllocator<Type>, Growth>;
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include "simple_vector.h"
+
+#if __has_include(<sys/stat.h>) && __has_include(<sys/uio.h>) && __has_include(<unistd.h>)
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define SERIALIZATION_HAS_FD_IO 1
+#endif
+
+// Binary format for SimpleVector of trivially copyable elements: a fixed
+// 32-byte header followed by the elements' bytes exactly as they are in
+// memory. Nothing is converted, so a buffer is only readable on a machine
+// with the same byte order, element size and alignment, which the header
+// records and the readers check.
+
+struct SerializedHeader {
+    static constexpr uint32_t kMagic = 0x43455653;  // "SVEC" in little endian
+    // kMagic as read on a machine of the opposite byte order
+    static constexpr uint32_t kSwappedMagic = 0x53564543;
+    static constexpr uint32_t kByteOrderMark = 0x01020304;
+    static constexpr uint16_t kVersion = 1;
+
+    uint32_t magic;
+    // kByteOrderMark as written by the producer
+    uint32_t byte_order;
+    uint16_t version;
+    uint16_t alignment;
+    uint32_t element_size;
+    uint64_t count;
+    uint64_t reserved;
+};
+
+// The elements start 32 bytes in, so an aligned buffer keeps them aligned
+inline constexpr size_t kSerializedHeaderSize = 32;
+static_assert(sizeof(SerializedHeader) == kSerializedHeaderSize);
+
+template <typename Type>
+SerializedHeader MakeSerializedHeader(size_t count) noexcept {
+    return SerializedHeader{SerializedHeader::kMagic, SerializedHeader::kByteOrderMark, SerializedHeader::kVersion,
+                            static_cast<uint16_t>(alignof(Type)), static_cast<uint32_t>(sizeof(Type)),
+                            static_cast<uint64_t>(count), 0};
+}
+
+// Throws std::runtime_error unless header describes elements of Type. The
+// magic is accepted in either byte order, so that a buffer from a machine of
+// the other byte order is reported as such; every later field would be
+// byte-swapped in it, starting with the version.
+template <typename Type>
+void CheckSerializedHeader(const SerializedHeader& header) {
+    if (header.magic != SerializedHeader::kMagic && header.magic != SerializedHeader::kSwappedMagic) {
+        throw std::runtime_error("not a serialized SimpleVector");
+    }
+    if (header.byte_order != SerializedHeader::kByteOrderMark) {
+        throw std::runtime_error("serialized SimpleVector has a different byte order");
+    }
+    if (header.version != SerializedHeader::kVersion) {
+        throw std::runtime_error("unsupported serialized SimpleVector version");
+    }
+    if (header.element_size != sizeof(Type) || header.alignment != alignof(Type)) {
+        throw std::runtime_error("serialized SimpleVector holds a different element type");
+    }
+}
+
+// The header's count as a size_t. Throws std::runtime_error if that many
+// elements could not be held by vector, whatever the input actually holds.
+template <typename Type, typename Alloc, typename Growth>
+size_t SerializedCount(const SimpleVector<Type, Alloc, Growth>& vector, const SerializedHeader& header) {
+    // the byte count must fit a streamsize as well as a size_t
+    constexpr uint64_t kMaxBytes = static_cast<uint64_t>(
+        std::min<uintmax_t>(std::numeric_limits<size_t>::max(), std::numeric_limits<std::streamsize>::max()));
+    const uint64_t max_count = std::min<uint64_t>(
+        kMaxBytes / sizeof(Type), std::allocator_traits<Alloc>::max_size(vector.GetAllocator()));
+    if (header.count > max_count) {
+        throw std::runtime_error("serialized SimpleVector is too long");
+    }
+    return static_cast<size_t>(header.count);
+}
+
+// Elements read per step while the input has not been shown to hold them
+// all, so a forged count costs at most one step's worth of storage (and
+// then geometric growth over what really arrives)
+inline constexpr size_t kSerializedReadChunkBytes = size_t{1} << 20;
+
+// Clears vector and appends count elements whose bytes read_bytes(dest,
+// bytes) fills, at most chunk elements at a time. On failure the vector is
+// left empty.
+template <typename Type, typename Alloc, typename Growth, typename ReadBytes>
+void ReadElements(SimpleVector<Type, Alloc, Growth>& vector, size_t count, size_t chunk, ReadBytes read_bytes) {
+    vector.Clear();
+    try {
+        vector.Reserve(std::min(count, chunk));
+        while (count > 0) {
+            const size_t step = std::min(count, chunk);
+            vector.AppendRaw(step, [&](Type* dest) {
+                read_bytes(dest, step * sizeof(Type));
+            });
+            count -= step;
+        }
+    } catch (...) {
+        vector.Clear();
+        throw;
+    }
+}
+
+template <typename Type, typename Alloc, typename Growth>
+void WriteTo(const SimpleVector<Type, Alloc, Growth>& vector, std::ostream& out) {
+    static_assert(std::is_trivially_copyable_v<Type>, "the elements are written as raw bytes");
+    const SerializedHeader header = MakeSerializedHeader<Type>(vector.GetSize());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(vector.begin()),
+              static_cast<std::streamsize>(vector.GetSize() * sizeof(Type)));
+    if (!out) {
+        throw std::runtime_error("failed to write a serialized SimpleVector");
+    }
+}
+
+// Replaces the contents of vector with the elements read from in. The bytes
+// are read straight into the storage, which is reserved once unless the
+// count is over kSerializedReadChunkBytes. On failure the vector is left
+// empty.
+template <typename Type, typename Alloc, typename Growth>
+void ReadFrom(SimpleVector<Type, Alloc, Growth>& vector, std::istream& in) {
+    static_assert(std::is_trivially_copyable_v<Type>, "the elements are read as raw bytes");
+    SerializedHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        throw std::runtime_error("truncated serialized SimpleVector");
+    }
+    CheckSerializedHeader<Type>(header);
+    const size_t chunk = std::max<size_t>(kSerializedReadChunkBytes / sizeof(Type), 1);
+    ReadElements(vector, SerializedCount(vector, header), chunk, [&](Type* dest, size_t bytes) {
+        if (!in.read(reinterpret_cast<char*>(dest), static_cast<std::streamsize>(bytes))) {
+            throw std::runtime_error("truncated serialized SimpleVector");
+        }
+    });
+}
+
+#ifdef SERIALIZATION_HAS_FD_IO
+// Header and elements go out in a single writev, repeated only if the
+// kernel takes less than everything at once
+template <typename Type, typename Alloc, typename Growth>
+void WriteTo(const SimpleVector<Type, Alloc, Growth>& vector, int fd) {
+    static_assert(std::is_trivially_copyable_v<Type>, "the elements are written as raw bytes");
+    SerializedHeader header = MakeSerializedHeader<Type>(vector.GetSize());
+    iovec parts[2] = {
+        {&header, sizeof(header)},
+        {const_cast<Type*>(vector.begin()), vector.GetSize() * sizeof(Type)},
+    };
+    iovec* part = parts;
+    int part_count = parts[1].iov_len > 0 ? 2 : 1;
+    while (part_count > 0) {
+        ssize_t written = ::writev(fd, part, part_count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "writev");
+        }
+        size_t left = static_cast<size_t>(written);
+        while (part_count > 0 && left >= part->iov_len) {
+            left -= part->iov_len;
+            ++part;
+            --part_count;
+        }
+        if (part_count > 0) {
+            // a partial write stopped inside *part
+            part->iov_base = static_cast<char*>(part->iov_base) + left;
+            part->iov_len -= left;
+        }
+    }
+}
+
+// Reads exactly size bytes; throws on end of file or error
+inline void ReadAll(int fd, void* dest, size_t size) {
+    char* cursor = static_cast<char*>(dest);
+    while (size > 0) {
+        ssize_t received = ::read(fd, cursor, size);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "read");
+        }
+        if (received == 0) {
+            throw std::runtime_error("truncated serialized SimpleVector");
+        }
+        cursor += received;
+        size -= static_cast<size_t>(received);
+    }
+}
+
+// Bytes left to read in a regular file, or -1 if fd is a pipe, socket or
+// the like that can't tell
+inline off_t RemainingBytes(int fd) noexcept {
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        return -1;
+    }
+    const off_t position = ::lseek(fd, 0, SEEK_CUR);
+    return position < 0 ? -1 : std::max<off_t>(info.st_size - position, 0);
+}
+
+// A regular file is checked against its size up front and read in one go;
+// anything else is read in chunks
+template <typename Type, typename Alloc, typename Growth>
+void ReadFrom(SimpleVector<Type, Alloc, Growth>& vector, int fd) {
+    static_assert(std::is_trivially_copyable_v<Type>, "the elements are read as raw bytes");
+    SerializedHeader header;
+    ReadAll(fd, &header, sizeof(header));
+    CheckSerializedHeader<Type>(header);
+    const size_t count = SerializedCount(vector, header);
+    size_t chunk = std::max<size_t>(kSerializedReadChunkBytes / sizeof(Type), 1);
+    const off_t remaining = RemainingBytes(fd);
+    if (remaining >= 0) {
+        if (count > static_cast<uint64_t>(remaining) / sizeof(Type)) {
+            vector.Clear();
+            throw std::runtime_error("truncated serialized SimpleVector");
+        }
+        chunk = std::max<size_t>(count, 1);
+    }
+    ReadElements(vector, count, chunk, [&](Type* dest, size_t bytes) {
+        ReadAll(fd, dest, bytes);
+    });
+}
+#endif
+
+// Read-only view of a serialized vector inside a buffer someone else owns,
+// e.g. one just received from the network. Nothing is copied: the elements
+// are read in place, so the buffer must outlive the view and be aligned for
+// Type.
+template <typename Type>
+class SerializedView {
+    static_assert(std::is_trivially_copyable_v<Type>, "the elements are read as raw bytes");
+
+public:
+    using ConstIterator = const Type*;
+
+    SerializedView() noexcept = default;
+
+    // Throws std::runtime_error if the buffer does not hold a whole
+    // serialized vector of Type
+    SerializedView(const void* buffer, size_t size) {
+        SerializedHeader header;
+        if (size < sizeof(header)) {
+            throw std::runtime_error("truncated serialized SimpleVector");
+        }
+        std::memcpy(&header, buffer, sizeof(header));
+        CheckSerializedHeader<Type>(header);
+        if (header.count > (size - sizeof(header)) / sizeof(Type)) {
+            throw std::runtime_error("truncated serialized SimpleVector");
+        }
+        const unsigned char* data = static_cast<const unsigned char*>(buffer) + sizeof(header);
+        if (reinterpret_cast<uintptr_t>(data) % alignof(Type) != 0) {
+            throw std::runtime_error("serialized SimpleVector buffer is misaligned");
+        }
+        data_ = reinterpret_cast<const Type*>(data);
+        size_ = header.count;
+    }
+
+    size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    bool IsEmpty() const noexcept {
+        return size_ == 0;
+    }
+
+    // Bytes of the buffer taken by the header and the elements
+    size_t GetBytes() const noexcept {
+        return sizeof(SerializedHeader) + size_ * sizeof(Type);
+    }
+
+    const Type& operator[](size_t index) const noexcept {
+        assert(index < size_);
+        return data_[index];
+    }
+
+    const Type& At(size_t index) const {
+        if (index >= size_) {
+            throw std::out_of_range("Index out of range");
+        }
+        return data_[index];
+    }
+
+    ConstIterator begin() const noexcept {
+        return data_;
+    }
+
+    ConstIterator end() const noexcept {
+        return data_ + size_;
+    }
+
+    ConstIterator cbegin() const noexcept {
+        return begin();
+    }
+
+    ConstIterator cend() const noexcept {
+        return end();
+    }
+
+private:
+    const Type* data_ = nullptr;
+    size_t size_ = 0;
+};
@@ -4,9 +4,15 @@
 #include <initializer_list>
 #include <stdexcept>
 #include <algorithm>
+#include <functional>
 #include <iterator>
+#include <memory>
+#include <type_traits>
 #include <utility>
 #include "array_ptr.h"
+#include "compare_kernels.h"
+#include "growth_policy.h"
+#include "simple_vector_view.h"
 
 struct ReserveProxy {
     explicit ReserveProxy(size_t capacity_to_reserve)
@@ -19,79 +25,190 @@ inline ReserveProxy Reserve(size_t capacity_to_reserve) {
     return ReserveProxy(capacity_to_reserve);
 }
 
-template <typename Type>
+// Defined in parallel_algorithms.h. The parallel constructors are templates
+// over it, so only code that includes that header, and with it <thread>,
+// can call them.
+struct ParallelProxy;
+
+template <typename It, typename = void>
+struct IsIterator : std::false_type {};
+
+template <typename It>
+struct IsIterator<It, std::void_t<typename std::iterator_traits<It>::iterator_category>> : std::true_type {};
+
+template <typename Type, typename Alloc = std::allocator<Type>, typename Growth = DoublingGrowth>
 class SimpleVector {
 public:
     using Iterator = Type*;
     using ConstIterator = const Type*;
+    using AllocatorType = Alloc;
+    using GrowthPolicy = Growth;
+
+    SimpleVector() noexcept(noexcept(Alloc())) = default;
+
+    explicit SimpleVector(const Alloc& alloc) noexcept
+        : data_(alloc) {}
 
-    SimpleVector() noexcept = default;
+    explicit SimpleVector(ReserveProxy proxy, const Alloc& alloc = Alloc())
+        : data_(proxy.capacity, alloc) {}
 
-    explicit SimpleVector(ReserveProxy proxy)
-        : capacity_(proxy.capacity), data_(proxy.capacity) {}
+    explicit SimpleVector(size_t size, const Alloc& alloc = Alloc()) : data_(size, alloc) {
+        data_.UninitializedValueConstruct(data_.Get(), size);
+        size_ = size;
+    }
 
+    SimpleVector(size_t size, const Type& value, const Alloc& alloc = Alloc()) : data_(size, alloc) {
+        data_.UninitializedFill(data_.Get(), size, value);
+        size_ = size;
+    }
 
-    explicit SimpleVector(size_t size) : size_(size), capacity_(size), data_(size) {
-        std::fill(begin(), end(), Type());
+    // Constructs the elements on proxy.threads workers of the parallel pool,
+    // each first-touching its own chunk of the buffer (see
+    // parallel_algorithms.h)
+    template <typename Proxy, typename = std::enable_if_t<std::is_same_v<Proxy, ParallelProxy>>>
+    SimpleVector(size_t size, Proxy proxy, const Alloc& alloc = Alloc()) : data_(size, alloc) {
+        ConstructInParallel(proxy, [this](Type* dest, size_t count) {
+            data_.UninitializedValueConstruct(dest, count);
+        });
     }
 
-    SimpleVector(size_t size, const Type& value) : size_(size), capacity_(size), data_(size) {
-        std::fill(begin(), end(), value);
+    template <typename Proxy, typename = std::enable_if_t<std::is_same_v<Proxy, ParallelProxy>>>
+    SimpleVector(size_t size, const Type& value, Proxy proxy, const Alloc& alloc = Alloc())
+        : data_(size, alloc) {
+        ConstructInParallel(proxy, [this, &value](Type* dest, size_t count) {
+            data_.UninitializedFill(dest, count, value);
+        });
     }
 
-    SimpleVector(std::initializer_list<Type> init) 
-        : size_(init.size()), capacity_(init.size()), data_(init.size()) {
-        std::copy(init.begin(), init.end(), begin());
+    SimpleVector(std::initializer_list<Type> init, const Alloc& alloc = Alloc())
+        : data_(init.size(), alloc) {
+        data_.UninitializedCopy(init.begin(), init.end(), data_.Get());
+        size_ = init.size();
     }
 
-    SimpleVector(const SimpleVector& other) : size_(other.size_), capacity_(other.size_), data_(other.size_) {
-         std::copy(other.begin(), other.end(), begin());
+    SimpleVector(const SimpleVector& other)
+        : SimpleVector(other, AllocTraits::select_on_container_copy_construction(other.GetAllocator())) {}
+
+    SimpleVector(const SimpleVector& other, const Alloc& alloc) : data_(other.size_, alloc) {
+        data_.UninitializedCopy(other.begin(), other.end(), data_.Get());
+        size_ = other.size_;
     }
 
     SimpleVector(SimpleVector&& other) noexcept 
         : size_(std::exchange(other.size_, 0)),
-          capacity_(std::exchange(other.capacity_, 0)),
-          data_(other.data_.Release()) {}
+          data_(std::move(other.data_)) {}
+
+    // Lazy element-wise expressions (vector_expression.h) are evaluated in
+    // one pass straight into the new buffer
+    template <typename Expr, typename = typename Expr::IsVectorExpression>
+    SimpleVector(const Expr& expr, const Alloc& alloc = Alloc()) : data_(expr.GetSize(), alloc) {
+        static_assert(ArrayPtr<Type, Alloc>::kMovesAsBytes, "expressions are evaluated into raw storage");
+        expr.EvaluateInto(Data());
+        size_ = data_.GetSize();
+    }
 
     SimpleVector& operator=(const SimpleVector& rhs) {
         if (this != &rhs) {
-            SimpleVector temp(rhs);
-            swap(temp);
+            SimpleVector temp(rhs, AllocTraits::propagate_on_container_copy_assignment::value
+                                       ? rhs.GetAllocator()
+                                       : GetAllocator());
+            SwapStorage(temp);
         }
         return *this;
     }
 
-    SimpleVector& operator=(SimpleVector&& rhs) noexcept {
+    SimpleVector& operator=(SimpleVector&& rhs) noexcept(kMoveAssignNoexcept) {
         if (this != &rhs) {
-            swap(rhs);
+            if (kMoveAssignNoexcept || GetAllocator() == rhs.GetAllocator()) {
+                SwapStorage(rhs);
+            } else {
+                // storage of rhs can't be freed by our allocator, so move element-wise
+                SimpleVector temp(ReserveProxy(rhs.size_), GetAllocator());
+                temp.data_.UninitializedMove(rhs.begin(), rhs.end(), temp.data_.Get());
+                temp.size_ = rhs.size_;
+                SwapStorage(temp);
+            }
             rhs.Clear();
         }
         return *this;
     }
 
-    ~SimpleVector() = default;
+    // Reuses the buffer when it is large enough (an operand may be this very
+    // vector: every element only depends on the operands' elements at the
+    // same index), otherwise evaluates into a single new one
+    template <typename Expr, typename = typename Expr::IsVectorExpression>
+    SimpleVector& operator=(const Expr& expr) {
+        static_assert(ArrayPtr<Type, Alloc>::kMovesAsBytes, "expressions are evaluated into raw storage");
+        const size_t size = expr.GetSize();
+        if (size > GetCapacity()) {
+            SimpleVector result(expr, GetAllocator());
+            SwapStorage(result);
+        } else {
+            expr.EvaluateInto(Data());
+            size_ = size;
+        }
+        return *this;
+    }
+
+    ~SimpleVector() {
+        data_.Destroy(begin(), end());
+    }
 
+    // Growth here and in Resize, PushBack and Insert moves the elements when
+    // that can't throw and copies them otherwise, so that an exception leaves
+    // the vector as it was (move-only types with throwing moves excepted)
     void Reserve(size_t new_capacity) {
-        if (new_capacity > capacity_) {
-            ArrayPtr<Type> new_data(new_capacity);
-            std::move(begin(), end(), new_data.Get());
-            data_.swap(new_data);
-            capacity_ = new_capacity;
+        if (new_capacity > GetCapacity()) {
+            Reallocate(new_capacity);
+        }
+    }
+
+    // Reduces the capacity to max(new_capacity, GetSize()); never grows
+    void ShrinkTo(size_t new_capacity) {
+        new_capacity = std::max(new_capacity, size_);
+        if (new_capacity >= GetCapacity()) {
+            return;
+        }
+        if (new_capacity == 0) {
+            data_.Reset();
+        } else {
+            Reallocate(new_capacity);
         }
     }
 
+    void ShrinkToFit() {
+        ShrinkTo(size_);
+    }
+
+    // Destroys the elements and frees the storage
+    void ClearAndRelease() noexcept {
+        Clear();
+        data_.Reset();
+    }
+
+    // Returns the pages of the unused capacity to the OS while keeping the
+    // capacity itself, so a huge buffer can be reused later without
+    // reallocation. Returns the number of bytes released.
+    size_t ReleaseUnusedPages() noexcept {
+        return data_.ReleasePages(size_);
+    }
+
     size_t GetSize() const noexcept {
         return size_;
     }
 
     size_t GetCapacity() const noexcept {
-        return capacity_;
+        return data_.GetSize();
     }
 
     bool IsEmpty() const noexcept {
         return size_ == 0;
     }
 
+    Alloc GetAllocator() const noexcept {
+        return data_.GetAllocator();
+    }
+
     Type& operator[](size_t index) noexcept {
         return data_[index];
     }
@@ -115,76 +232,251 @@ public:
     }
 
     void Clear() noexcept {
+        data_.Destroy(begin(), end());
         size_ = 0;
     }
 
     void Resize(size_t new_size) {
         if (new_size <= size_) {
+            data_.Destroy(begin() + new_size, end());
             size_ = new_size;
             return;
         }
 
-        if (new_size <= capacity_) {
-            for (size_t i = size_; i < new_size; ++i) {
-                data_[i] = Type();
+        const size_t count = new_size - size_;
+        if (new_size > GetCapacity()) {
+            if constexpr (std::is_nothrow_default_constructible_v<Type>) {
+                Reallocate(NextCapacity(new_size));
+            } else {
+                // the new tail is built in the new buffer before anything is
+                // moved, so a throwing constructor leaves the old one in use
+                ReallocateWithGap(NextCapacity(new_size), size_, count, [&](Type* gap) {
+                    data_.UninitializedValueConstruct(gap, count);
+                });
+                return;
             }
-            size_ = new_size;
-            return;
         }
-
-        size_t new_capacity = std::max(new_size, capacity_ * 2);
-        ArrayPtr<Type> new_data(new_capacity);
-        
-        std::move(begin(), end(), new_data.Get());
-        for (size_t i = size_; i < new_size; ++i) {
-            new_data[i] = Type();
-        }
-
-        data_.swap(new_data);
+        data_.UninitializedValueConstruct(end(), count);
         size_ = new_size;
-        capacity_ = new_capacity;
     }
 
     void PushBack(const Type& item) {
-        if (size_ >= capacity_) {
-            Reserve(capacity_ == 0 ? 1 : capacity_ * 2);
-        }
-        data_[size_] = item;
-        ++size_;
+        EmplaceBack(item);
     }
 
     void PushBack(Type&& item) {
-        if (size_ >= capacity_) {
-            Reserve(capacity_ == 0 ? 1 : capacity_ * 2);
+        EmplaceBack(std::move(item));
+    }
+
+    // Constructs the element directly in the vector's storage
+    template <typename... Args>
+    Type& EmplaceBack(Args&&... args) {
+        if (size_ < GetCapacity()) {
+            data_.Construct(end(), std::forward<Args>(args)...);
+            ++size_;
+        } else {
+            ReallocateAndEmplace(size_, std::forward<Args>(args)...);
         }
-        data_[size_] = std::move(item);
-        ++size_;
+        return data_[size_ - 1];
+    }
+
+    template <typename... Args>
+    Iterator Emplace(ConstIterator pos, Args&&... args) {
+        size_t offset = pos - begin();
+        if (size_ == GetCapacity()) {
+            ReallocateAndEmplace(offset, std::forward<Args>(args)...);
+        } else if (offset == size_) {
+            data_.Construct(end(), std::forward<Args>(args)...);
+            ++size_;
+        } else if (!kShiftsInPlace) {
+            ReallocateWithGap(GetCapacity(), offset, 1, [&](Type* slot) {
+                data_.Construct(slot, std::forward<Args>(args)...);
+            });
+        } else {
+            // args may refer to an element that is about to be shifted
+            ShiftAndAssign(offset, Type(std::forward<Args>(args)...));
+        }
+        return begin() + offset;
     }
 
     Iterator Insert(ConstIterator pos, const Type& value) {
-        return InsertImpl(pos, value);
+        return Emplace(pos, value);
     }
 
     Iterator Insert(ConstIterator pos, Type&& value) {
-        return InsertImpl(pos, std::move(value));
+        size_t offset = pos - begin();
+        if (size_ == GetCapacity() || offset == size_ || !kShiftsInPlace) {
+            return Emplace(pos, std::move(value));
+        }
+        ShiftAndAssign(offset, std::move(value));
+        return begin() + offset;
+    }
+
+    Iterator Insert(ConstIterator pos, size_t count, const Type& value) {
+        size_t offset = pos - begin();
+        const Type copy(value);
+        InsertGap(
+            offset, count,
+            [&copy](Type* dest, size_t, size_t n) {
+                std::fill_n(dest, n, copy);
+            },
+            [this, &copy](Type* dest, size_t, size_t n) {
+                data_.UninitializedFill(dest, n, copy);
+            });
+        return begin() + offset;
+    }
+
+    template <typename InputIt, typename = std::enable_if_t<IsIterator<InputIt>::value>>
+    Iterator Insert(ConstIterator pos, InputIt first, InputIt last) {
+        size_t offset = pos - begin();
+        using Category = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+            InsertGap(
+                offset, static_cast<size_t>(std::distance(first, last)),
+                [first](Type* dest, size_t from, size_t n) {
+                    std::copy_n(std::next(first, from), n, dest);
+                },
+                [this, first](Type* dest, size_t from, size_t n) {
+                    InputIt range_first = std::next(first, from);
+                    data_.UninitializedCopy(range_first, std::next(range_first, n), dest);
+                });
+        } else {
+            // single pass input: append, then rotate the new elements into place
+            size_t old_size = size_;
+            for (; first != last; ++first) {
+                EmplaceBack(*first);
+            }
+            std::rotate(begin() + offset, begin() + old_size, end());
+            SIMPLE_VECTOR_COUNT(elements_shifted, old_size - offset);
+        }
+        return begin() + offset;
+    }
+
+    template <typename InputIt, typename = std::enable_if_t<IsIterator<InputIt>::value>>
+    void Append(InputIt first, InputIt last) {
+        Insert(cend(), first, last);
+    }
+
+    // Appends count trivially copyable elements whose bytes fill(dest)
+    // writes straight into the storage, without constructing them first. If
+    // fill throws, the size stays as it was.
+    template <typename Fill>
+    void AppendRaw(size_t count, Fill fill) {
+        static_assert(std::is_trivially_copyable_v<Type>, "the elements are written as raw bytes");
+        if (count > GetCapacity() - size_) {
+            if (count > AllocTraits::max_size(data_.GetAllocator()) - size_) {
+                throw std::length_error("SimpleVector: size exceeds max_size");
+            }
+            Reallocate(NextCapacity(size_ + count));
+        }
+        fill(end());
+        size_ += count;
     }
 
     void PopBack() noexcept {
         assert(size_ > 0);
         --size_;
+        data_.Destroy(end());
     }
 
     Iterator Erase(ConstIterator pos) {
-        size_t offset = pos - begin();
-        std::move(begin() + offset + 1, end(), begin() + offset);
-        --size_;
+        return Erase(pos, pos + 1);
+    }
+
+    // Removes [first, last) with a single shift of the tail. Returns the
+    // iterator to the element after the removed ones, as Erase(pos) and
+    // std::vector::erase do, rather than the count: that is last - first,
+    // which the caller already has. EraseIf, where it is not, returns it.
+    Iterator Erase(ConstIterator first, ConstIterator last) {
+        size_t offset = first - begin();
+        size_t count = last - first;
+        if (count > 0) {
+            SIMPLE_VECTOR_COUNT(elements_shifted, size_ - offset - count);
+            Iterator hole = begin() + offset;
+            if constexpr (Storage::kRelocatesAsBytes) {
+                data_.Destroy(hole, hole + count);
+                Storage::MoveBytes(hole, hole + count, size_ - offset - count);
+            } else {
+                Iterator new_end = std::move(hole + count, end(), hole);
+                data_.Destroy(new_end, end());
+            }
+            size_ -= count;
+        }
         return begin() + offset;
     }
 
+    // Unordered O(1) erase: the last element is moved into the hole. Returns
+    // an iterator to the element that now occupies pos.
+    Iterator SwapRemove(ConstIterator pos) {
+        size_t index = pos - begin();
+        SwapRemove(index);
+        return begin() + index;
+    }
+
+    // A template, so that SwapRemove(0) picks the index overload over the
+    // null-pointer conversion to ConstIterator
+    template <typename Index, typename = std::enable_if_t<std::is_integral_v<Index>>>
+    void SwapRemove(Index index) {
+        assert(static_cast<size_t>(index) < size_);
+        if constexpr (Storage::kRelocatesAsBytes) {
+            data_.Destroy(begin() + index);
+            --size_;
+            Storage::MoveBytes(begin() + index, end(), static_cast<size_t>(index) != size_ ? 1 : 0);
+            return;
+        }
+        if (static_cast<size_t>(index) + 1 != size_) {
+            data_[index] = std::move(data_[size_ - 1]);
+        }
+        PopBack();
+    }
+
+    // Removes the elements at the given strictly ascending indices, filling
+    // each hole with at most one move from the end of the vector
+    template <typename BidirIt>
+    void SwapRemoveIndices(BidirIt first, BidirIt last) {
+        assert(std::adjacent_find(first, last, std::greater_equal<>()) == last);
+        while (first != last) {
+            SwapRemove(*--last);
+        }
+    }
+
     void swap(SimpleVector& other) noexcept {
-        data_.swap(other.data_);
-        std::swap(size_, other.size_);
-        std::swap(capacity_, other.capacity_);
+        if constexpr (!AllocTraits::propagate_on_container_swap::value) {
+            assert(GetAllocator() == other.GetAllocator());
+        }
+        SwapStorage(other);
+    }
+
+    // Alignment of Data(), taken from the allocator
+    static constexpr size_t kAlignment = AllocatorAlignment<Alloc, Type>::value;
+
+    // The buffer, with a hint to the compiler that it is kAlignment aligned
+    // (nullptr while there is no buffer)
+    Type* Data() noexcept {
+        return AssumeAligned<kAlignment>(data_.Get());
+    }
+
+    const Type* Data() const noexcept {
+        return AssumeAligned<kAlignment>(static_cast<const Type*>(data_.Get()));
+    }
+
+    // Non-owning views of the elements; see simple_vector_view.h
+    SimpleVectorView<Type> View() noexcept {
+        return SimpleVectorView<Type>(begin(), GetSize());
+    }
+
+    SimpleVectorView<const Type> View() const noexcept {
+        return SimpleVectorView<const Type>(begin(), GetSize());
+    }
+
+    // The count elements starting at offset; throws std::out_of_range if
+    // they are not all in the vector
+    SimpleVectorView<Type> Slice(size_t offset, size_t count) {
+        return View().Slice(offset, count);
+    }
+
+    SimpleVectorView<const Type> Slice(size_t offset, size_t count) const {
+        return View().Slice(offset, count);
     }
 
     Iterator begin() noexcept { 
@@ -212,51 +504,250 @@ public:
     }
 
 private:
+    using AllocTraits = std::allocator_traits<Alloc>;
+    using Storage = ArrayPtr<Type, Alloc>;
+
+    static constexpr bool kMoveAssignNoexcept = AllocTraits::propagate_on_container_move_assignment::value ||
+                                                AllocTraits::is_always_equal::value;
+
     size_t size_ = 0;
-    size_t capacity_ = 0;
-    ArrayPtr<Type> data_;
+    Storage data_;
 
-    template <typename ValueType>
-    Iterator InsertImpl(ConstIterator pos, ValueType&& value) {
-        size_t offset = pos - begin();
-        if (size_ >= capacity_) {
-            Reserve(capacity_ == 0 ? 1 : capacity_ * 2);
+    // Exchanges buffers together with the allocators that own them
+    void SwapStorage(SimpleVector& other) noexcept {
+        data_.swap(other.data_);
+        std::swap(size_, other.size_);
+    }
+
+    // Fills the whole (empty) buffer, one chunk per worker. If any chunk
+    // throws, the chunks that were built are destroyed again.
+    template <typename Proxy, typename ConstructChunk>
+    void ConstructInParallel(const Proxy& proxy, ConstructChunk construct_chunk) {
+        const size_t count = GetCapacity();
+        // [first, last) of every chunk that was fully built
+        std::unique_ptr<std::pair<size_t, size_t>[]> built(new std::pair<size_t, size_t>[proxy.ChunkCount(count)]());
+        try {
+            proxy.ForEachChunk(count, [&](size_t index, size_t first, size_t last) {
+                construct_chunk(begin() + first, last - first);
+                built[index] = {first, last};
+            });
+        } catch (...) {
+            for (size_t index = 0; index < proxy.ChunkCount(count); ++index) {
+                data_.Destroy(begin() + built[index].first, begin() + built[index].second);
+            }
+            throw;
+        }
+        size_ = count;
+    }
+
+    // Single-element inserts shift the tail in place only when that cannot
+    // throw halfway through (or the type can only be moved anyway). Other
+    // types are inserted into a fresh buffer, at the cost of an allocation,
+    // so that a throwing copy leaves the vector as it was.
+    static constexpr bool kShiftsInPlace =
+        Storage::kRelocatesAsBytes ||
+        (std::is_nothrow_move_constructible_v<Type> && std::is_nothrow_move_assignable_v<Type>) ||
+        !std::is_copy_constructible_v<Type>;
+
+    size_t NextCapacity(size_t required) const {
+        size_t max_size = AllocTraits::max_size(data_.GetAllocator());
+        if (required > max_size) {
+            throw std::length_error("SimpleVector: size exceeds max_size");
+        }
+        return std::clamp(Growth::Capacity(GetCapacity(), required, sizeof(Type)), required, max_size);
+    }
+
+    // Moves the elements into a new buffer leaving `count` raw slots at
+    // `offset`, which construct_gap(gap) fills. The new elements are built
+    // before the old ones are moved, so they may be constructed from elements
+    // of this vector.
+    template <typename ConstructGap>
+    void ReallocateWithGap(size_t new_capacity, size_t offset, size_t count, ConstructGap construct_gap) {
+        CountReallocation();
+        Storage new_data(new_capacity, data_.GetAllocator());
+        Type* gap = new_data.Get() + offset;
+        construct_gap(gap);
+        if constexpr (Storage::kRelocatesAsBytes) {
+            Storage::MoveBytes(new_data.Get(), begin(), offset);
+            Storage::MoveBytes(gap + count, begin() + offset, size_ - offset);
+            data_.swap(new_data);
+            size_ += count;
+            return;
+        }
+        try {
+            new_data.UninitializedMoveIfNoexcept(begin(), begin() + offset, new_data.Get());
+            try {
+                new_data.UninitializedMoveIfNoexcept(begin() + offset, end(), gap + count);
+            } catch (...) {
+                new_data.Destroy(new_data.Get(), gap);
+                throw;
+            }
+        } catch (...) {
+            new_data.Destroy(gap, gap + count);
+            throw;
         }
-        std::move_backward(begin() + offset, end(), end() + 1);
-        data_[offset] = std::forward<ValueType>(value);
+        data_.Destroy(begin(), end());
+        data_.swap(new_data);
+        size_ += count;
+    }
+
+    void Reallocate(size_t new_capacity) {
+        CountReallocation();
+        if constexpr (Storage::kCanRealloc) {
+            data_.Realloc(new_capacity);
+            return;
+        }
+        Storage new_data(new_capacity, data_.GetAllocator());
+        new_data.UninitializedRelocate(begin(), end(), new_data.Get());
+        data_.swap(new_data);
+    }
+
+    // Growth of an existing buffer; the elements are counted as moved even
+    // when realloc manages to extend the buffer in place
+    void CountReallocation() {
+        if (GetCapacity() > 0) {
+            SIMPLE_VECTOR_COUNT(reallocations, 1);
+            SIMPLE_VECTOR_COUNT(elements_moved, size_);
+        }
+    }
+
+    // Opens room for `count` elements at `offset` with at most one reallocation
+    // and a single shift of the tail. assign(dest, from, n) and
+    // construct(dest, from, n) store source elements [from, from + n) into live
+    // and raw slots respectively. On reallocation the new elements are built
+    // first, so the source may refer to elements of this vector.
+    template <typename Assign, typename Construct>
+    void InsertGap(size_t offset, size_t count, Assign assign, Construct construct) {
+        if (count == 0) {
+            return;
+        }
+        if (count > AllocTraits::max_size(data_.GetAllocator()) - size_) {
+            throw std::length_error("SimpleVector: size exceeds max_size");
+        }
+        size_t new_size = size_ + count;
+
+        if (new_size > GetCapacity()) {
+            ReallocateWithGap(NextCapacity(new_size), offset, count, [&construct, count](Type* gap) {
+                construct(gap, 0, count);
+            });
+            return;
+        }
+
+        Type* pos = begin() + offset;
+        Type* old_end = end();
+        size_t tail = size_ - offset;
+        SIMPLE_VECTOR_COUNT(elements_shifted, tail);
+        if constexpr (Storage::kRelocatesAsBytes) {
+            Storage::MoveBytes(pos + count, pos, tail);
+            try {
+                construct(pos, 0, count);
+            } catch (...) {
+                Storage::MoveBytes(pos, pos + count, tail);
+                throw;
+            }
+            size_ = new_size;
+            return;
+        }
+        if (tail > count) {
+            data_.UninitializedMove(old_end - count, old_end, old_end);
+            size_ = new_size;
+            std::move_backward(pos, old_end - count, old_end);
+            assign(pos, 0, count);
+        } else {
+            construct(old_end, tail, count - tail);
+            size_ += count - tail;
+            data_.UninitializedMove(pos, old_end, pos + count);
+            size_ = new_size;
+            assign(pos, 0, tail);
+        }
+    }
+
+    // Moves the tail one slot to the right and assigns value into the hole.
+    // Requires free capacity and offset < size_.
+    void ShiftAndAssign(size_t offset, Type&& value) {
+        SIMPLE_VECTOR_COUNT(elements_shifted, size_ - offset);
+        if constexpr (Storage::kRelocatesAsBytes) {
+            // the hole is raw storage now, so value is constructed into it
+            Storage::MoveBytes(begin() + offset + 1, begin() + offset, size_ - offset);
+            try {
+                data_.Construct(begin() + offset, std::move(value));
+            } catch (...) {
+                Storage::MoveBytes(begin() + offset, begin() + offset + 1, size_ - offset);
+                throw;
+            }
+            ++size_;
+            return;
+        }
+        // the bounds are taken once, before the allocator's construct, which
+        // the compiler can't prove leaves size_ alone
+        Type* const pos = begin() + offset;
+        Type* const old_end = end();
+        data_.Construct(old_end, std::move(*(old_end - 1)));
         ++size_;
-        return begin() + offset;
+        // a one-element tail is shifted by the construct alone
+        if (old_end - pos > 1) {
+            std::move_backward(pos, old_end - 1, old_end);
+        }
+        *pos = std::move(value);
+    }
+
+    template <typename... Args>
+    void ReallocateAndEmplace(size_t offset, Args&&... args) {
+        if constexpr (Storage::kCanRealloc) {
+            // args may point into the buffer that realloc is about to release
+            Type value(std::forward<Args>(args)...);
+            Reallocate(NextCapacity(size_ + 1));
+            SIMPLE_VECTOR_COUNT(elements_shifted, size_ - offset);
+            Storage::MoveBytes(begin() + offset + 1, begin() + offset, size_ - offset);
+            data_.Construct(begin() + offset, std::move(value));
+            ++size_;
+            return;
+        }
+        ReallocateWithGap(NextCapacity(size_ + 1), offset, 1, [&](Type* slot) {
+            data_.Construct(slot, std::forward<Args>(args)...);
+        });
     }
 };
 
-template <typename Type>
-inline bool operator==(const SimpleVector<Type>& lhs, const SimpleVector<Type>& rhs) {
-    return lhs.GetSize() == rhs.GetSize() && 
-           std::equal(lhs.begin(), lhs.end(), rhs.begin());
+// A SimpleVector only holds its allocator and a pointer to its buffer
+template <typename Type, typename Alloc, typename Growth>
+struct IsTriviallyRelocatable<SimpleVector<Type, Alloc, Growth>> : IsTriviallyRelocatable<Alloc> {};
+
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator==(const SimpleVector<Type, Alloc, Growth>& lhs, const SimpleVector<Type, Alloc, Growth>& rhs) {
+    return lhs.GetSize() == rhs.GetSize() && RangesEqual(lhs.begin(), rhs.begin(), lhs.GetSize());
 }
 
-template <typename Type>
-inline bool operator!=(const SimpleVector<Type>& lhs, const SimpleVector<Type>& rhs) {
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator!=(const SimpleVector<Type, Alloc, Growth>& lhs, const SimpleVector<Type, Alloc, Growth>& rhs) {
     return !(lhs == rhs);
 }
 
-template <typename Type>
-inline bool operator<(const SimpleVector<Type>& lhs, const SimpleVector<Type>& rhs) {
-    return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator<(const SimpleVector<Type, Alloc, Growth>& lhs, const SimpleVector<Type, Alloc, Growth>& rhs) {
+    return RangesLess(lhs.begin(), lhs.GetSize(), rhs.begin(), rhs.GetSize());
 }
 
-template <typename Type>
-inline bool operator<=(const SimpleVector<Type>& lhs, const SimpleVector<Type>& rhs) {
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator<=(const SimpleVector<Type, Alloc, Growth>& lhs, const SimpleVector<Type, Alloc, Growth>& rhs) {
     return !(rhs < lhs);
 }
 
-template <typename Type>
-inline bool operator>(const SimpleVector<Type>& lhs, const SimpleVector<Type>& rhs) {
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator>(const SimpleVector<Type, Alloc, Growth>& lhs, const SimpleVector<Type, Alloc, Growth>& rhs) {
     return rhs < lhs;
 }
 
-template <typename Type>
-inline bool operator>=(const SimpleVector<Type>& lhs, const SimpleVector<Type>& rhs) {
+template <typename Type, typename Alloc, typename Growth>
+inline bool operator>=(const SimpleVector<Type, Alloc, Growth>& lhs, const SimpleVector<Type, Alloc, Growth>& rhs) {
     return !(lhs < rhs);
 }
 
+// Removes the elements satisfying pred in one compaction pass and returns how many were removed
+template <typename Type, typename Alloc, typename Growth, typename Predicate>
+size_t EraseIf(SimpleVector<Type, Alloc, Growth>& vector, Predicate pred) {
+    auto new_end = std::remove_if(vector.begin(), vector.end(), pred);
+    size_t removed = vector.end() - new_end;
+    vector.Erase(new_end, vector.end());
+    return removed;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "compare_kernels.h"
+
+// Non-owning view of count contiguous elements, for passing a vector or a
+// part of one around without copying it. SimpleVectorView<const Type> is the
+// read-only flavour; the view itself is two words and is passed by value.
+// The elements must outlive the view, and growing the vector it came from
+// invalidates it, just like an iterator.
+template <typename Type>
+class SimpleVectorView {
+    template <typename Container>
+    using EnableIfContiguous = std::enable_if_t<
+        !std::is_same_v<std::remove_const_t<Container>, SimpleVectorView> &&
+        std::is_convertible_v<decltype(std::declval<Container&>().begin()), Type*>>;
+
+public:
+    using Iterator = Type*;
+    using ConstIterator = const Type*;
+    using ValueType = std::remove_const_t<Type>;
+
+    SimpleVectorView() noexcept = default;
+
+    SimpleVectorView(Type* data, size_t size) noexcept
+        : data_(data), size_(size) {}
+
+    // Views any container with pointer iterators and GetSize(): SimpleVector,
+    // SmallSimpleVector, MappedSimpleVector, SerializedView. Temporaries are
+    // rejected, as the view would dangle.
+    template <typename Container, typename = EnableIfContiguous<Container>>
+    SimpleVectorView(Container& container) noexcept
+        : data_(container.begin()), size_(container.GetSize()) {}
+
+    // A mutable view converts to a read-only one
+    template <typename Other, typename = std::enable_if_t<std::is_same_v<Type, const Other>>>
+    SimpleVectorView(SimpleVectorView<Other> other) noexcept
+        : data_(other.begin()), size_(other.GetSize()) {}
+
+    size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    bool IsEmpty() const noexcept {
+        return size_ == 0;
+    }
+
+    Type* Data() const noexcept {
+        return data_;
+    }
+
+    Type& operator[](size_t index) const noexcept {
+        assert(index < size_);
+        return data_[index];
+    }
+
+    Type& At(size_t index) const {
+        if (index >= size_) {
+            throw std::out_of_range("Index out of range");
+        }
+        return data_[index];
+    }
+
+    // The count elements starting at offset; throws std::out_of_range if
+    // they are not all inside this view
+    SimpleVectorView Slice(size_t offset, size_t count) const {
+        if (offset > size_ || count > size_ - offset) {
+            throw std::out_of_range("Slice out of range");
+        }
+        return SimpleVectorView(data_ + offset, count);
+    }
+
+    // Everything from offset on
+    SimpleVectorView Slice(size_t offset) const {
+        if (offset > size_) {
+            throw std::out_of_range("Slice out of range");
+        }
+        return SimpleVectorView(data_ + offset, size_ - offset);
+    }
+
+    Iterator begin() const noexcept {
+        return data_;
+    }
+
+    Iterator end() const noexcept {
+        return data_ + size_;
+    }
+
+    ConstIterator cbegin() const noexcept {
+        return data_;
+    }
+
+    ConstIterator cend() const noexcept {
+        return data_ + size_;
+    }
+
+private:
+    Type* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+template <typename Container>
+SimpleVectorView(Container&) -> SimpleVectorView<std::remove_pointer_t<decltype(std::declval<Container&>().begin())>>;
+
+// The comparisons take any mix of const and mutable views of the same
+// element type and go through the comparison kernels
+template <typename Lhs, typename Rhs,
+          typename = std::enable_if_t<std::is_same_v<std::remove_const_t<Lhs>, std::remove_const_t<Rhs>>>>
+inline bool operator==(SimpleVectorView<Lhs> lhs, SimpleVectorView<Rhs> rhs) {
+    return lhs.GetSize() == rhs.GetSize() &&
+           RangesEqual<std::remove_const_t<Lhs>>(lhs.begin(), rhs.begin(), lhs.GetSize());
+}
+
+template <typename Lhs, typename Rhs,
+          typename = std::enable_if_t<std::is_same_v<std::remove_const_t<Lhs>, std::remove_const_t<Rhs>>>>
+inline bool operator!=(SimpleVectorView<Lhs> lhs, SimpleVectorView<Rhs> rhs) {
+    return !(lhs == rhs);
+}
+
+template <typename Lhs, typename Rhs,
+          typename = std::enable_if_t<std::is_same_v<std::remove_const_t<Lhs>, std::remove_const_t<Rhs>>>>
+inline bool operator<(SimpleVectorView<Lhs> lhs, SimpleVectorView<Rhs> rhs) {
+    return RangesLess<std::remove_const_t<Lhs>>(lhs.begin(), lhs.GetSize(), rhs.begin(), rhs.GetSize());
+}
+
+template <typename Lhs, typename Rhs,
+          typename = std::enable_if_t<std::is_same_v<std::remove_const_t<Lhs>, std::remove_const_t<Rhs>>>>
+inline bool operator<=(SimpleVectorView<Lhs> lhs, SimpleVectorView<Rhs> rhs) {
+    return !(rhs < lhs);
+}
+
+template <typename Lhs, typename Rhs,
+          typename = std::enable_if_t<std::is_same_v<std::remove_const_t<Lhs>, std::remove_const_t<Rhs>>>>
+inline bool operator>(SimpleVectorView<Lhs> lhs, SimpleVectorView<Rhs> rhs) {
+    return rhs < lhs;
+}
+
+template <typename Lhs, typename Rhs,
+          typename = std::enable_if_t<std::is_same_v<std::remove_const_t<Lhs>, std::remove_const_t<Rhs>>>>
+inline bool operator>=(SimpleVectorView<Lhs> lhs, SimpleVectorView<Rhs> rhs) {
+    return !(lhs < rhs);
+}
@@ -0,0 +1,507 @@
+#pragma once
+
+#include <cassert>
+#include <initializer_list>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "array_ptr.h"
+#include "compare_kernels.h"
+#include "simple_vector.h"
+#include "simple_vector_view.h"
+
+// SimpleVector with room for N elements inside the object itself. The heap is
+// used only once the vector outgrows the inline buffer; moving an inline
+// vector moves its elements one by one, a heap vector just hands the buffer over.
+template <typename Type, size_t N, typename Alloc = std::allocator<Type>>
+class SmallSimpleVector {
+    static_assert(N > 0, "inline capacity must be positive");
+
+public:
+    using Iterator = Type*;
+    using ConstIterator = const Type*;
+    using AllocatorType = Alloc;
+
+    static constexpr size_t kInlineCapacity = N;
+
+    SmallSimpleVector() noexcept(noexcept(Alloc())) = default;
+
+    explicit SmallSimpleVector(const Alloc& alloc) noexcept
+        : heap_(alloc) {}
+
+    explicit SmallSimpleVector(ReserveProxy proxy, const Alloc& alloc = Alloc())
+        : heap_(alloc) {
+        Reserve(proxy.capacity);
+    }
+
+    explicit SmallSimpleVector(size_t size, const Alloc& alloc = Alloc())
+        : heap_(alloc) {
+        Reserve(size);
+        heap_.UninitializedValueConstruct(data_, size);
+        size_ = size;
+    }
+
+    SmallSimpleVector(size_t size, const Type& value, const Alloc& alloc = Alloc())
+        : heap_(alloc) {
+        Reserve(size);
+        heap_.UninitializedFill(data_, size, value);
+        size_ = size;
+    }
+
+    SmallSimpleVector(std::initializer_list<Type> init, const Alloc& alloc = Alloc())
+        : heap_(alloc) {
+        Reserve(init.size());
+        heap_.UninitializedCopy(init.begin(), init.end(), data_);
+        size_ = init.size();
+    }
+
+    SmallSimpleVector(const SmallSimpleVector& other)
+        : SmallSimpleVector(other, AllocTraits::select_on_container_copy_construction(other.GetAllocator())) {}
+
+    SmallSimpleVector(const SmallSimpleVector& other, const Alloc& alloc)
+        : heap_(alloc) {
+        Reserve(other.size_);
+        heap_.UninitializedCopy(other.begin(), other.end(), data_);
+        size_ = other.size_;
+    }
+
+    SmallSimpleVector(SmallSimpleVector&& other) noexcept(std::is_nothrow_move_constructible_v<Type>)
+        : heap_(other.heap_.GetAllocator()) {
+        if (other.IsInline()) {
+            heap_.UninitializedMove(other.begin(), other.end(), data_);
+            size_ = other.size_;
+            other.Clear();
+        } else {
+            heap_ = std::move(other.heap_);
+            data_ = heap_.Get();
+            size_ = std::exchange(other.size_, 0);
+            other.data_ = other.InlineData();
+        }
+    }
+
+    SmallSimpleVector& operator=(const SmallSimpleVector& rhs) {
+        if (this != &rhs) {
+            if constexpr (AllocTraits::propagate_on_container_copy_assignment::value) {
+                if (GetAllocator() != rhs.GetAllocator()) {
+                    // our heap buffer belongs to the allocator we are about to drop
+                    Clear();
+                    heap_ = Storage(rhs.heap_.GetAllocator());
+                    data_ = InlineData();
+                }
+            }
+            SmallSimpleVector temp(rhs, GetAllocator());
+            *this = std::move(temp);
+        }
+        return *this;
+    }
+
+    SmallSimpleVector& operator=(SmallSimpleVector&& rhs) noexcept(kMoveAssignNoexcept &&
+                                                                   std::is_nothrow_move_constructible_v<Type>) {
+        if (this != &rhs) {
+            Clear();
+            if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+                if (rhs.IsInline() && GetAllocator() != rhs.GetAllocator()) {
+                    // the elements move one by one, but the allocator still
+                    // comes along, as it does with a heap buffer; ours owns
+                    // our buffer, so that goes first
+                    heap_ = Storage(rhs.heap_.GetAllocator());
+                    data_ = InlineData();
+                }
+            }
+            if (!rhs.IsInline() && (kMoveAssignNoexcept || GetAllocator() == rhs.GetAllocator())) {
+                heap_ = std::move(rhs.heap_);
+                data_ = heap_.Get();
+                size_ = std::exchange(rhs.size_, 0);
+                rhs.data_ = rhs.InlineData();
+            } else {
+                Reserve(rhs.size_);
+                heap_.UninitializedMove(rhs.begin(), rhs.end(), data_);
+                size_ = rhs.size_;
+                rhs.Clear();
+            }
+        }
+        return *this;
+    }
+
+    ~SmallSimpleVector() {
+        heap_.Destroy(begin(), end());
+    }
+
+    void Reserve(size_t new_capacity) {
+        if (new_capacity > GetCapacity()) {
+            Reallocate(new_capacity);
+        }
+    }
+
+    size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    size_t GetCapacity() const noexcept {
+        return IsInline() ? N : heap_.GetSize();
+    }
+
+    bool IsEmpty() const noexcept {
+        return size_ == 0;
+    }
+
+    // True while the elements live in the object itself
+    bool IsInline() const noexcept {
+        return !heap_;
+    }
+
+    Alloc GetAllocator() const noexcept {
+        return heap_.GetAllocator();
+    }
+
+    Type& operator[](size_t index) noexcept {
+        return data_[index];
+    }
+
+    const Type& operator[](size_t index) const noexcept {
+        return data_[index];
+    }
+
+    Type& At(size_t index) {
+        if (index >= size_) {
+            throw std::out_of_range("Index out of range");
+        }
+        return data_[index];
+    }
+
+    const Type& At(size_t index) const {
+        if (index >= size_) {
+            throw std::out_of_range("Index out of range");
+        }
+        return data_[index];
+    }
+
+    void Clear() noexcept {
+        heap_.Destroy(begin(), end());
+        size_ = 0;
+    }
+
+    void Resize(size_t new_size) {
+        if (new_size <= size_) {
+            heap_.Destroy(begin() + new_size, end());
+            size_ = new_size;
+            return;
+        }
+        if (new_size > GetCapacity()) {
+            Reallocate(NextCapacity(new_size));
+        }
+        heap_.UninitializedValueConstruct(end(), new_size - size_);
+        size_ = new_size;
+    }
+
+    void PushBack(const Type& item) {
+        EmplaceBack(item);
+    }
+
+    void PushBack(Type&& item) {
+        EmplaceBack(std::move(item));
+    }
+
+    template <typename... Args>
+    Type& EmplaceBack(Args&&... args) {
+        if (size_ < GetCapacity()) {
+            heap_.Construct(end(), std::forward<Args>(args)...);
+        } else {
+            // args may refer to an element that the reallocation moves away
+            Type value(std::forward<Args>(args)...);
+            Reallocate(NextCapacity(size_ + 1));
+            heap_.Construct(end(), std::move(value));
+        }
+        ++size_;
+        return data_[size_ - 1];
+    }
+
+    template <typename... Args>
+    Iterator Emplace(ConstIterator pos, Args&&... args) {
+        size_t offset = pos - begin();
+        if (offset == size_) {
+            EmplaceBack(std::forward<Args>(args)...);
+        } else {
+            // args may refer to an element that is about to be shifted
+            Type value(std::forward<Args>(args)...);
+            if (size_ == GetCapacity()) {
+                ReallocateWithGap(NextCapacity(size_ + 1), offset, std::move(value));
+            } else {
+                Type* const pos = data_ + offset;
+                Type* const old_end = data_ + size_;
+                heap_.Construct(old_end, std::move(*(old_end - 1)));
+                ++size_;
+                // a one-element tail is shifted by the construct alone
+                if (old_end - pos > 1) {
+                    std::move_backward(pos, old_end - 1, old_end);
+                }
+                *pos = std::move(value);
+            }
+        }
+        return begin() + offset;
+    }
+
+    Iterator Insert(ConstIterator pos, const Type& value) {
+        return Emplace(pos, value);
+    }
+
+    Iterator Insert(ConstIterator pos, Type&& value) {
+        return Emplace(pos, std::move(value));
+    }
+
+    Iterator Insert(ConstIterator pos, size_t count, const Type& value) {
+        size_t offset = pos - begin();
+        const Type copy(value);
+        InsertGap(
+            offset, count,
+            [&copy](Type* dest, size_t, size_t n) {
+                std::fill_n(dest, n, copy);
+            },
+            [this, &copy](Type* dest, size_t, size_t n) {
+                heap_.UninitializedFill(dest, n, copy);
+            });
+        return begin() + offset;
+    }
+
+    template <typename InputIt, typename = std::enable_if_t<IsIterator<InputIt>::value>>
+    Iterator Insert(ConstIterator pos, InputIt first, InputIt last) {
+        size_t offset = pos - begin();
+        using Category = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+            InsertGap(
+                offset, static_cast<size_t>(std::distance(first, last)),
+                [first](Type* dest, size_t from, size_t n) {
+                    std::copy_n(std::next(first, from), n, dest);
+                },
+                [this, first](Type* dest, size_t from, size_t n) {
+                    InputIt range_first = std::next(first, from);
+                    heap_.UninitializedCopy(range_first, std::next(range_first, n), dest);
+                });
+        } else {
+            size_t old_size = size_;
+            for (; first != last; ++first) {
+                EmplaceBack(*first);
+            }
+            std::rotate(begin() + offset, begin() + old_size, end());
+        }
+        return begin() + offset;
+    }
+
+    template <typename InputIt, typename = std::enable_if_t<IsIterator<InputIt>::value>>
+    void Append(InputIt first, InputIt last) {
+        Insert(cend(), first, last);
+    }
+
+    void PopBack() noexcept {
+        assert(size_ > 0);
+        --size_;
+        heap_.Destroy(end());
+    }
+
+    Iterator Erase(ConstIterator pos) {
+        return Erase(pos, pos + 1);
+    }
+
+    Iterator Erase(ConstIterator first, ConstIterator last) {
+        size_t offset = first - begin();
+        size_t count = last - first;
+        if (count > 0) {
+            Iterator new_end = std::move(begin() + offset + count, end(), begin() + offset);
+            heap_.Destroy(new_end, end());
+            size_ -= count;
+        }
+        return begin() + offset;
+    }
+
+    void swap(SmallSimpleVector& other) noexcept(std::is_nothrow_move_constructible_v<Type>&& kMoveAssignNoexcept) {
+        if (!IsInline() && !other.IsInline()) {
+            if constexpr (!AllocTraits::propagate_on_container_swap::value) {
+                assert(GetAllocator() == other.GetAllocator());
+            }
+            heap_.swap(other.heap_);
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+            return;
+        }
+        SmallSimpleVector temp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temp);
+    }
+
+    // Non-owning views of the elements; see simple_vector_view.h
+    SimpleVectorView<Type> View() noexcept {
+        return SimpleVectorView<Type>(begin(), GetSize());
+    }
+
+    SimpleVectorView<const Type> View() const noexcept {
+        return SimpleVectorView<const Type>(begin(), GetSize());
+    }
+
+    // The count elements starting at offset; throws std::out_of_range if
+    // they are not all in the vector
+    SimpleVectorView<Type> Slice(size_t offset, size_t count) {
+        return View().Slice(offset, count);
+    }
+
+    SimpleVectorView<const Type> Slice(size_t offset, size_t count) const {
+        return View().Slice(offset, count);
+    }
+
+    Iterator begin() noexcept {
+        return data_;
+    }
+
+    Iterator end() noexcept {
+        return data_ + size_;
+    }
+
+    ConstIterator begin() const noexcept {
+        return data_;
+    }
+
+    ConstIterator end() const noexcept {
+        return data_ + size_;
+    }
+
+    ConstIterator cbegin() const noexcept {
+        return data_;
+    }
+
+    ConstIterator cend() const noexcept {
+        return data_ + size_;
+    }
+
+private:
+    using AllocTraits = std::allocator_traits<Alloc>;
+    using Storage = ArrayPtr<Type, Alloc>;
+
+    static constexpr bool kMoveAssignNoexcept = AllocTraits::propagate_on_container_move_assignment::value ||
+                                                AllocTraits::is_always_equal::value;
+
+    Type* InlineData() noexcept {
+        return reinterpret_cast<Type*>(inline_);
+    }
+
+    // Doubles, as SimpleVector does by default, without wrapping past the
+    // allocator's max_size
+    size_t NextCapacity(size_t required) const {
+        const size_t max_size = AllocTraits::max_size(heap_.GetAllocator());
+        if (required > max_size) {
+            throw std::length_error("SmallSimpleVector: size exceeds max_size");
+        }
+        return std::clamp(DoublingGrowth::Capacity(GetCapacity(), required, sizeof(Type)), required, max_size);
+    }
+
+    // Moves the elements to a heap buffer of new_capacity elements. heap_ also
+    // carries the allocator, so it is reassigned rather than swapped.
+    void Reallocate(size_t new_capacity) {
+        Storage new_data(new_capacity, heap_.GetAllocator());
+        const size_t count = size_;
+        if (count > 0) {
+            new_data.UninitializedMove(data_, data_ + count, new_data.Get());
+            heap_.Destroy(data_, data_ + count);
+        }
+        heap_ = std::move(new_data);
+        data_ = heap_.Get();
+    }
+
+    // Moves the elements to a heap buffer of new_capacity elements, leaving
+    // out the slot at offset, into which value goes; one pass, where growing
+    // first would move the tail twice
+    void ReallocateWithGap(size_t new_capacity, size_t offset, Type&& value) {
+        Storage new_data(new_capacity, heap_.GetAllocator());
+        Type* gap = new_data.Get() + offset;
+        new_data.Construct(gap, std::move(value));
+        try {
+            new_data.UninitializedMove(data_, data_ + offset, new_data.Get());
+            try {
+                new_data.UninitializedMove(data_ + offset, data_ + size_, gap + 1);
+            } catch (...) {
+                new_data.Destroy(new_data.Get(), gap);
+                throw;
+            }
+        } catch (...) {
+            new_data.Destroy(gap);
+            throw;
+        }
+        heap_.Destroy(data_, data_ + size_);
+        heap_ = std::move(new_data);
+        data_ = heap_.Get();
+        ++size_;
+    }
+
+    // Grows if needed and shifts [offset, size_) right by count with a single
+    // pass. assign(dest, from, n) and construct(dest, from, n) store source
+    // elements [from, from + n) into live and raw slots of the gap respectively.
+    template <typename Assign, typename Construct>
+    void InsertGap(size_t offset, size_t count, Assign assign, Construct construct) {
+        if (count == 0) {
+            return;
+        }
+        if (count > GetCapacity() - size_) {
+            Reallocate(NextCapacity(SaturatingAdd(size_, count)));
+        }
+        Type* pos = begin() + offset;
+        Type* old_end = end();
+        size_t tail = size_ - offset;
+        if (tail > count) {
+            heap_.UninitializedMove(old_end - count, old_end, old_end);
+            size_ += count;
+            std::move_backward(pos, old_end - count, old_end);
+            assign(pos, 0, count);
+        } else {
+            construct(old_end, tail, count - tail);
+            size_ += count - tail;
+            heap_.UninitializedMove(pos, old_end, pos + count);
+            size_ += tail;
+            assign(pos, 0, tail);
+        }
+    }
+
+    alignas(Type) unsigned char inline_[sizeof(Type) * N];
+    Type* data_ = InlineData();
+    size_t size_ = 0;
+    // empty while the elements are inline; always holds the allocator
+    Storage heap_;
+};
+
+template <typename Type, size_t N, typename Alloc>
+inline bool operator==(const SmallSimpleVector<Type, N, Alloc>& lhs, const SmallSimpleVector<Type, N, Alloc>& rhs) {
+    return lhs.GetSize() == rhs.GetSize() && RangesEqual(lhs.begin(), rhs.begin(), lhs.GetSize());
+}
+
+template <typename Type, size_t N, typename Alloc>
+inline bool operator!=(const SmallSimpleVector<Type, N, Alloc>& lhs, const SmallSimpleVector<Type, N, Alloc>& rhs) {
+    return !(lhs == rhs);
+}
+
+template <typename Type, size_t N, typename Alloc>
+inline bool operator<(const SmallSimpleVector<Type, N, Alloc>& lhs, const SmallSimpleVector<Type, N, Alloc>& rhs) {
+    return RangesLess(lhs.begin(), lhs.GetSize(), rhs.begin(), rhs.GetSize());
+}
+
+template <typename Type, size_t N, typename Alloc>
+inline bool operator<=(const SmallSimpleVector<Type, N, Alloc>& lhs, const SmallSimpleVector<Type, N, Alloc>& rhs) {
+    return !(rhs < lhs);
+}
+
+template <typename Type, size_t N, typename Alloc>
+inline bool operator>(const SmallSimpleVector<Type, N, Alloc>& lhs, const SmallSimpleVector<Type, N, Alloc>& rhs) {
+    return rhs < lhs;
+}
+
+template <typename Type, size_t N, typename Alloc>
+inline bool operator>=(const SmallSimpleVector<Type, N, Alloc>& lhs, const SmallSimpleVector<Type, N, Alloc>& rhs) {
+    return !(lhs < rhs);
+}
+
+template <typename Type, size_t N, typename Alloc, typename Predicate>
+size_t EraseIf(SmallSimpleVector<Type, N, Alloc>& vector, Predicate pred) {
+    auto new_end = std::remove_if(vector.begin(), vector.end(), pred);
+    size_t removed = vector.end() - new_end;
+    vector.Erase(new_end, vector.end());
+    return removed;
+}
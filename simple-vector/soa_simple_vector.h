@@ -0,0 +1,526 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "array_ptr.h"
+#include "compare_kernels.h"
+#include "growth_policy.h"
+#include "instrumentation.h"
+#include "simple_vector_view.h"
+
+// Structure of arrays: row i is (Column<0>()[i], Column<1>()[i], ...), and
+// every field lives in its own contiguous ArrayPtr, so a loop over two
+// fields of a wide record only pulls those two columns into the cache. All
+// columns share one size and capacity and grow together with DoublingGrowth.
+//
+// A row is handed out as a tuple of references (Reference), which is what
+// the iterators yield too:
+//     for (auto [x, vx] : particles) { x += vx; }
+// writes through to the columns. Column<I>() is a SimpleVectorView of one
+// field for vectorized kernels.
+//
+// The fields must be nothrow move constructible, so growing never has to
+// undo a half-moved set of columns.
+template <typename... Fields>
+class SoaSimpleVector {
+    static_assert(sizeof...(Fields) > 0, "SoaSimpleVector needs at least one field");
+    static_assert((std::is_nothrow_move_constructible_v<Fields> && ...),
+                  "columns are moved on growth and must not throw");
+
+    using Columns = std::tuple<ArrayPtr<Fields>...>;
+    using Indices = std::index_sequence_for<Fields...>;
+
+    template <bool Const>
+    class BasicIterator;
+
+public:
+    template <size_t I>
+    using FieldType = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+    using ValueType = std::tuple<Fields...>;
+    using Reference = std::tuple<Fields&...>;
+    using ConstReference = std::tuple<const Fields&...>;
+    using Iterator = BasicIterator<false>;
+    using ConstIterator = BasicIterator<true>;
+
+    static constexpr size_t kFieldCount = sizeof...(Fields);
+
+    SoaSimpleVector() noexcept = default;
+
+    explicit SoaSimpleVector(ReserveProxy proxy) {
+        Reserve(proxy.capacity);
+    }
+
+    explicit SoaSimpleVector(size_t size) {
+        Resize(size);
+    }
+
+    SoaSimpleVector(std::initializer_list<ValueType> init) {
+        Reserve(init.size());
+        for (const ValueType& row : init) {
+            PushBack(row);
+        }
+    }
+
+    SoaSimpleVector(const SoaSimpleVector& other)
+        : columns_{ArrayPtr<Fields>(other.size_)...} {
+        BuildColumns(
+            [&](auto i) {
+                auto& column = std::get<decltype(i)::value>(columns_);
+                const auto& source = std::get<decltype(i)::value>(other.columns_);
+                column.UninitializedCopy(source.Get(), source.Get() + other.size_, column.Get());
+            },
+            [&](auto i) {
+                auto& column = std::get<decltype(i)::value>(columns_);
+                column.Destroy(column.Get(), column.Get() + other.size_);
+            });
+        size_ = other.size_;
+    }
+
+    SoaSimpleVector(SoaSimpleVector&& other) noexcept
+        : columns_(std::move(other.columns_)), size_(std::exchange(other.size_, 0)) {}
+
+    SoaSimpleVector& operator=(const SoaSimpleVector& rhs) {
+        if (this != &rhs) {
+            SoaSimpleVector copy(rhs);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    SoaSimpleVector& operator=(SoaSimpleVector&& rhs) noexcept {
+        if (this != &rhs) {
+            Clear();
+            columns_ = std::move(rhs.columns_);
+            size_ = std::exchange(rhs.size_, 0);
+        }
+        return *this;
+    }
+
+    ~SoaSimpleVector() {
+        Clear();
+    }
+
+    void Reserve(size_t new_capacity) {
+        if (new_capacity > GetCapacity()) {
+            Reallocate(new_capacity, [](Columns&) {});
+        }
+    }
+
+    void ShrinkToFit() {
+        if (size_ == GetCapacity()) {
+            return;
+        }
+        if (size_ == 0) {
+            ForEachColumn([](auto& column) { column.Reset(); });
+        } else {
+            Reallocate(size_, [](Columns&) {});
+        }
+    }
+
+    size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    size_t GetCapacity() const noexcept {
+        return std::get<0>(columns_).GetSize();
+    }
+
+    bool IsEmpty() const noexcept {
+        return size_ == 0;
+    }
+
+    // The elements of field I, contiguous
+    template <size_t I>
+    SimpleVectorView<FieldType<I>> Column() noexcept {
+        return SimpleVectorView<FieldType<I>>(std::get<I>(columns_).Get(), size_);
+    }
+
+    template <size_t I>
+    SimpleVectorView<const FieldType<I>> Column() const noexcept {
+        return SimpleVectorView<const FieldType<I>>(std::get<I>(columns_).Get(), size_);
+    }
+
+    template <size_t I>
+    FieldType<I>* Data() noexcept {
+        return std::get<I>(columns_).Get();
+    }
+
+    template <size_t I>
+    const FieldType<I>* Data() const noexcept {
+        return std::get<I>(columns_).Get();
+    }
+
+    Reference operator[](size_t index) noexcept {
+        assert(index < size_);
+        return Row(index, Indices{});
+    }
+
+    ConstReference operator[](size_t index) const noexcept {
+        assert(index < size_);
+        return Row(index, Indices{});
+    }
+
+    Reference At(size_t index) {
+        if (index >= size_) {
+            throw std::out_of_range("Index out of range");
+        }
+        return Row(index, Indices{});
+    }
+
+    ConstReference At(size_t index) const {
+        if (index >= size_) {
+            throw std::out_of_range("Index out of range");
+        }
+        return Row(index, Indices{});
+    }
+
+    void Clear() noexcept {
+        DestroyTail(0);
+    }
+
+    // New rows are value-initialized
+    void Resize(size_t new_size) {
+        if (new_size <= size_) {
+            DestroyTail(new_size);
+            return;
+        }
+        if (new_size > GetCapacity()) {
+            Reallocate(NextCapacity(new_size), [](Columns&) {});
+        }
+        const size_t count = new_size - size_;
+        BuildColumns(
+            [&](auto i) {
+                auto& column = std::get<decltype(i)::value>(columns_);
+                column.UninitializedValueConstruct(column.Get() + size_, count);
+            },
+            [&](auto i) {
+                auto& column = std::get<decltype(i)::value>(columns_);
+                column.Destroy(column.Get() + size_, column.Get() + new_size);
+            });
+        size_ = new_size;
+    }
+
+    void PushBack(const Fields&... fields) {
+        EmplaceBack(fields...);
+    }
+
+    void PushBack(Fields&&... fields) {
+        EmplaceBack(std::move(fields)...);
+    }
+
+    void PushBack(const ValueType& row) {
+        std::apply([this](const Fields&... fields) { EmplaceBack(fields...); }, row);
+    }
+
+    void PushBack(ValueType&& row) {
+        std::apply([this](Fields&... fields) { EmplaceBack(std::move(fields)...); }, row);
+    }
+
+    // Constructs field i of the new row from args[i]. If one of them
+    // throws, the fields already built are destroyed and the vector is
+    // unchanged. The arguments may refer to rows of this vector.
+    template <typename... Args>
+    Reference EmplaceBack(Args&&... args) {
+        static_assert(sizeof...(Args) == kFieldCount, "EmplaceBack takes one argument per field");
+        if (size_ < GetCapacity()) {
+            ConstructRow(columns_, size_, std::forward<Args>(args)...);
+        } else {
+            Reallocate(NextCapacity(size_ + 1), [&](Columns& columns) {
+                ConstructRow(columns, size_, std::forward<Args>(args)...);
+            });
+        }
+        ++size_;
+        return Row(size_ - 1, Indices{});
+    }
+
+    void PopBack() noexcept {
+        assert(size_ > 0);
+        DestroyTail(size_ - 1);
+    }
+
+    Iterator Erase(ConstIterator pos) {
+        return Erase(pos, pos + 1);
+    }
+
+    // Removes [first, last) with a single shift of the tail of every column
+    Iterator Erase(ConstIterator first, ConstIterator last) {
+        const size_t offset = first - cbegin();
+        const size_t count = last - first;
+        if (count > 0) {
+            SIMPLE_VECTOR_COUNT(elements_shifted, (size_ - offset - count) * kFieldCount);
+            ForEachColumn([&](auto& column) {
+                auto* hole = column.Get() + offset;
+                std::move(hole + count, column.Get() + size_, hole);
+            });
+            DestroyTail(size_ - count);
+        }
+        return begin() + offset;
+    }
+
+    void swap(SoaSimpleVector& other) noexcept {
+        columns_.swap(other.columns_);
+        std::swap(size_, other.size_);
+    }
+
+    Iterator begin() noexcept {
+        return Iterator(this, 0);
+    }
+
+    Iterator end() noexcept {
+        return Iterator(this, size_);
+    }
+
+    ConstIterator begin() const noexcept {
+        return ConstIterator(this, 0);
+    }
+
+    ConstIterator end() const noexcept {
+        return ConstIterator(this, size_);
+    }
+
+    ConstIterator cbegin() const noexcept {
+        return begin();
+    }
+
+    ConstIterator cend() const noexcept {
+        return end();
+    }
+
+    // Column by column, through the comparison kernels
+    friend bool operator==(const SoaSimpleVector& lhs, const SoaSimpleVector& rhs) {
+        if (lhs.size_ != rhs.size_) {
+            return false;
+        }
+        bool equal = true;
+        ForEachIndex([&](auto i) {
+            constexpr size_t kField = decltype(i)::value;
+            equal = equal && RangesEqual(lhs.template Data<kField>(), rhs.template Data<kField>(), lhs.size_);
+        });
+        return equal;
+    }
+
+    friend bool operator!=(const SoaSimpleVector& lhs, const SoaSimpleVector& rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    static size_t MaxSize() noexcept {
+        return std::min({std::allocator_traits<std::allocator<Fields>>::max_size(std::allocator<Fields>())...});
+    }
+
+    size_t NextCapacity(size_t required) const {
+        const size_t max_size = MaxSize();
+        if (required > max_size) {
+            throw std::length_error("SoaSimpleVector: size exceeds max_size");
+        }
+        return std::clamp(DoublingGrowth::Capacity(GetCapacity(), required, (sizeof(Fields) + ...)), required,
+                          max_size);
+    }
+
+    // Calls function(index) with std::integral_constant index 0, 1, ...
+    template <typename Function>
+    static void ForEachIndex(Function function) {
+        ForEachIndex(function, Indices{});
+    }
+
+    template <typename Function, size_t... I>
+    static void ForEachIndex(Function& function, std::index_sequence<I...>) {
+        (function(std::integral_constant<size_t, I>{}), ...);
+    }
+
+    template <typename Function>
+    void ForEachColumn(Function function) {
+        std::apply([&function](auto&... columns) { (function(columns), ...); }, columns_);
+    }
+
+    // Like ForEachIndex, but if build(index) throws, unbuild(index) undoes
+    // the columns that were already built
+    template <typename Build, typename Unbuild>
+    static void BuildColumns(Build build, Unbuild unbuild) {
+        BuildColumns(build, unbuild, Indices{});
+    }
+
+    template <typename Build, typename Unbuild, size_t... I>
+    static void BuildColumns(Build& build, Unbuild& unbuild, std::index_sequence<I...>) {
+        size_t built = 0;
+        try {
+            ((build(std::integral_constant<size_t, I>{}), ++built), ...);
+        } catch (...) {
+            ((I < built ? unbuild(std::integral_constant<size_t, I>{}) : void()), ...);
+            throw;
+        }
+    }
+
+    template <typename... Args>
+    static void ConstructRow(Columns& columns, size_t index, Args&&... args) {
+        auto fields = std::forward_as_tuple(std::forward<Args>(args)...);
+        BuildColumns(
+            [&](auto i) {
+                auto& column = std::get<decltype(i)::value>(columns);
+                column.Construct(column.Get() + index, std::get<decltype(i)::value>(std::move(fields)));
+            },
+            [&](auto i) {
+                auto& column = std::get<decltype(i)::value>(columns);
+                column.Destroy(column.Get() + index);
+            });
+    }
+
+    template <size_t... I>
+    Reference Row(size_t index, std::index_sequence<I...>) noexcept {
+        return Reference(std::get<I>(columns_)[index]...);
+    }
+
+    template <size_t... I>
+    ConstReference Row(size_t index, std::index_sequence<I...>) const noexcept {
+        return ConstReference(std::get<I>(columns_)[index]...);
+    }
+
+    // Moves every column into new buffers of new_capacity. construct_extra
+    // gets the new columns first, so the rows it builds there may be
+    // constructed from rows of this vector.
+    template <typename ConstructExtra>
+    void Reallocate(size_t new_capacity, ConstructExtra construct_extra) {
+        Columns new_columns{ArrayPtr<Fields>(new_capacity)...};
+        construct_extra(new_columns);
+        if (GetCapacity() > 0) {
+            SIMPLE_VECTOR_COUNT(reallocations, 1);
+            SIMPLE_VECTOR_COUNT(elements_moved, size_ * kFieldCount);
+        }
+        ForEachIndex([&](auto i) {
+            auto& column = std::get<decltype(i)::value>(columns_);
+            auto& new_column = std::get<decltype(i)::value>(new_columns);
+            new_column.UninitializedMove(column.Get(), column.Get() + size_, new_column.Get());
+            column.Destroy(column.Get(), column.Get() + size_);
+        });
+        columns_.swap(new_columns);
+    }
+
+    void DestroyTail(size_t new_size) noexcept {
+        ForEachColumn([&](auto& column) { column.Destroy(column.Get() + new_size, column.Get() + size_); });
+        size_ = new_size;
+    }
+
+    Columns columns_;
+    size_t size_ = 0;
+};
+
+// Random access over row indices; dereferencing yields a tuple of references
+// into the columns, so there is no operator->
+template <typename... Fields>
+template <bool Const>
+class SoaSimpleVector<Fields...>::BasicIterator {
+    using Owner = std::conditional_t<Const, const SoaSimpleVector, SoaSimpleVector>;
+
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::tuple<Fields...>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::conditional_t<Const, ConstReference, Reference>;
+
+    BasicIterator() noexcept = default;
+
+    BasicIterator(Owner* owner, size_t index) noexcept
+        : owner_(owner), index_(index) {}
+
+    // Iterator converts to ConstIterator
+    template <bool OtherConst, typename = std::enable_if_t<Const && !OtherConst>>
+    BasicIterator(const BasicIterator<OtherConst>& other) noexcept
+        : owner_(other.owner_), index_(other.index_) {}
+
+    reference operator*() const noexcept {
+        return (*owner_)[index_];
+    }
+
+    reference operator[](difference_type offset) const noexcept {
+        return (*owner_)[index_ + offset];
+    }
+
+    BasicIterator& operator++() noexcept {
+        ++index_;
+        return *this;
+    }
+
+    BasicIterator operator++(int) noexcept {
+        BasicIterator copy = *this;
+        ++index_;
+        return copy;
+    }
+
+    BasicIterator& operator--() noexcept {
+        --index_;
+        return *this;
+    }
+
+    BasicIterator operator--(int) noexcept {
+        BasicIterator copy = *this;
+        --index_;
+        return copy;
+    }
+
+    BasicIterator& operator+=(difference_type offset) noexcept {
+        index_ += offset;
+        return *this;
+    }
+
+    BasicIterator& operator-=(difference_type offset) noexcept {
+        index_ -= offset;
+        return *this;
+    }
+
+    friend BasicIterator operator+(BasicIterator it, difference_type offset) noexcept {
+        return it += offset;
+    }
+
+    friend BasicIterator operator+(difference_type offset, BasicIterator it) noexcept {
+        return it += offset;
+    }
+
+    friend BasicIterator operator-(BasicIterator it, difference_type offset) noexcept {
+        return it -= offset;
+    }
+
+    friend difference_type operator-(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+        return static_cast<difference_type>(lhs.index_) - static_cast<difference_type>(rhs.index_);
+    }
+
+    friend bool operator==(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+        return lhs.index_ == rhs.index_;
+    }
+
+    friend bool operator!=(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+        return lhs.index_ != rhs.index_;
+    }
+
+    friend bool operator<(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+        return lhs.index_ < rhs.index_;
+    }
+
+    friend bool operator>(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+        return lhs.index_ > rhs.index_;
+    }
+
+    friend bool operator<=(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+        return lhs.index_ <= rhs.index_;
+    }
+
+    friend bool operator>=(const BasicIterator& lhs, const BasicIterator& rhs) noexcept {
+        return lhs.index_ >= rhs.index_;
+    }
+
+private:
+    template <bool>
+    friend class BasicIterator;
+
+    Owner* owner_ = nullptr;
+    size_t index_ = 0;
+};
@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "simple_vector.h"
+#include "simple_vector_view.h"
+
+// The key of an element of SortedSimpleVector: the element itself
+struct IdentityKey {
+    template <typename Type>
+    const Type& operator()(const Type& item) const noexcept {
+        return item;
+    }
+};
+
+// The key of an element of FlatSimpleMap: pair::first
+struct PairFirstKey {
+    template <typename Pair>
+    const typename Pair::first_type& operator()(const Pair& item) const noexcept {
+        return item.first;
+    }
+};
+
+// Elements with unique keys kept sorted by Compare in one SimpleVector
+// buffer, for lookup tables that are read much more often than changed.
+// Lookups are binary searches over contiguous memory, or over an Eytzinger
+// (breadth-first) copy of the keys once BuildSearchIndex() has been called.
+//
+// Single insertions still shift the tail; batches should go through
+// MergeBulk, which sorts the batch and merges it in one pass.
+template <typename Type, typename KeyOf, typename Compare, typename Alloc>
+class BasicSortedVector {
+public:
+    using Key = std::decay_t<decltype(std::declval<KeyOf>()(std::declval<const Type&>()))>;
+    using Vector = SimpleVector<Type, Alloc>;
+    using ConstIterator = const Type*;
+
+    BasicSortedVector() = default;
+
+    explicit BasicSortedVector(const Compare& compare, const Alloc& alloc = Alloc())
+        : items_(alloc), compare_(compare) {}
+
+    BasicSortedVector(std::initializer_list<Type> init, const Compare& compare = Compare(), const Alloc& alloc = Alloc())
+        : items_(alloc), compare_(compare) {
+        MergeBulk(init.begin(), init.end());
+    }
+
+    template <typename InputIt>
+    BasicSortedVector(InputIt first, InputIt last, const Compare& compare = Compare(), const Alloc& alloc = Alloc())
+        : items_(alloc), compare_(compare) {
+        MergeBulk(first, last);
+    }
+
+    size_t GetSize() const noexcept {
+        return items_.GetSize();
+    }
+
+    size_t GetCapacity() const noexcept {
+        return items_.GetCapacity();
+    }
+
+    bool IsEmpty() const noexcept {
+        return items_.IsEmpty();
+    }
+
+    void Reserve(size_t new_capacity) {
+        items_.Reserve(new_capacity);
+    }
+
+    void Clear() noexcept {
+        items_.Clear();
+        DropSearchIndex();
+    }
+
+    // The sorted elements
+    const Vector& Get() const noexcept {
+        return items_;
+    }
+
+    SimpleVectorView<const Type> View() const noexcept {
+        return items_.View();
+    }
+
+    // The first element whose key is not less than key
+    ConstIterator LowerBound(const Key& key) const {
+        return begin() + LowerBoundIndex(key);
+    }
+
+    // The first element whose key is greater than key
+    ConstIterator UpperBound(const Key& key) const {
+        ConstIterator it = LowerBound(key);
+        return it != end() && !Less(key, KeyOf()(*it)) ? it + 1 : it;
+    }
+
+    // end() when there is no element with key
+    ConstIterator Find(const Key& key) const {
+        ConstIterator it = LowerBound(key);
+        return it != end() && !Less(key, KeyOf()(*it)) ? it : end();
+    }
+
+    bool Contains(const Key& key) const {
+        return Find(key) != end();
+    }
+
+    // Inserts item unless its key is already present and returns the element
+    // with that key and whether it was inserted. The position is found by
+    // galloping back from the end, so appending in nearly sorted order costs
+    // O(log distance) comparisons.
+    std::pair<ConstIterator, bool> InsertSorted(const Type& item) {
+        return InsertAt(GallopIndex(KeyOf()(item)), item);
+    }
+
+    std::pair<ConstIterator, bool> InsertSorted(Type&& item) {
+        return InsertAt(GallopIndex(KeyOf()(item)), std::move(item));
+    }
+
+    // Adds the elements of [first, last) whose keys are new: the batch is
+    // sorted, stripped of duplicate keys (the first one wins) and merged with
+    // the elements in a single pass into one new buffer
+    template <typename InputIt>
+    void MergeBulk(InputIt first, InputIt last) {
+        Vector batch(items_.GetAllocator());
+        batch.Append(first, last);
+        if (batch.IsEmpty()) {
+            return;
+        }
+        auto less = [this](const Type& lhs, const Type& rhs) { return Less(KeyOf()(lhs), KeyOf()(rhs)); };
+        std::stable_sort(batch.begin(), batch.end(), less);
+        auto equal = [&less](const Type& lhs, const Type& rhs) { return !less(lhs, rhs) && !less(rhs, lhs); };
+        batch.Erase(std::unique(batch.begin(), batch.end(), equal), batch.end());
+        DropSearchIndex();
+
+        if (items_.IsEmpty() || less(items_[items_.GetSize() - 1], batch[0])) {
+            // the batch goes after everything already here
+            items_.Append(std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+            return;
+        }
+        Vector merged(ReserveProxy(items_.GetSize() + batch.GetSize()), items_.GetAllocator());
+        Type* old_item = items_.begin();
+        Type* new_item = batch.begin();
+        while (old_item != items_.end() && new_item != batch.end()) {
+            if (less(*new_item, *old_item)) {
+                merged.PushBack(std::move(*new_item++));
+            } else {
+                if (!less(*old_item, *new_item)) {
+                    ++new_item;
+                }
+                merged.PushBack(std::move(*old_item++));
+            }
+        }
+        merged.Append(std::make_move_iterator(old_item), std::make_move_iterator(items_.end()));
+        merged.Append(std::make_move_iterator(new_item), std::make_move_iterator(batch.end()));
+        items_ = std::move(merged);
+    }
+
+    void MergeBulk(std::initializer_list<Type> batch) {
+        MergeBulk(batch.begin(), batch.end());
+    }
+
+    // Removes the element with key; returns the number removed (0 or 1)
+    size_t EraseKey(const Key& key) {
+        ConstIterator it = Find(key);
+        if (it == end()) {
+            return 0;
+        }
+        Erase(it);
+        return 1;
+    }
+
+    ConstIterator Erase(ConstIterator pos) {
+        return Erase(pos, pos + 1);
+    }
+
+    ConstIterator Erase(ConstIterator first, ConstIterator last) {
+        DropSearchIndex();
+        return items_.Erase(first, last);
+    }
+
+    // Lays a copy of the keys out in Eytzinger order, so each step of a
+    // lookup goes to a child of the previous node and the top of the tree
+    // stays in cache. Worth it for large tables that are searched much more
+    // than they change: every modification drops the index again.
+    void BuildSearchIndex() {
+        const size_t size = items_.GetSize();
+        SimpleVector<Key> keys(size + 1);
+        SimpleVector<size_t> positions(size + 1);
+        // slot 0 is where a search ends when every key is smaller
+        positions[0] = size;
+        FillSearchIndex(keys, positions, 0, 1);
+        index_keys_ = std::move(keys);
+        index_positions_ = std::move(positions);
+    }
+
+    bool HasSearchIndex() const noexcept {
+        return !index_positions_.IsEmpty();
+    }
+
+    void swap(BasicSortedVector& other) noexcept {
+        items_.swap(other.items_);
+        std::swap(compare_, other.compare_);
+        index_keys_.swap(other.index_keys_);
+        index_positions_.swap(other.index_positions_);
+    }
+
+    ConstIterator begin() const noexcept {
+        return items_.begin();
+    }
+
+    ConstIterator end() const noexcept {
+        return items_.end();
+    }
+
+    ConstIterator cbegin() const noexcept {
+        return begin();
+    }
+
+    ConstIterator cend() const noexcept {
+        return end();
+    }
+
+    friend bool operator==(const BasicSortedVector& lhs, const BasicSortedVector& rhs) {
+        return lhs.items_ == rhs.items_;
+    }
+
+    friend bool operator!=(const BasicSortedVector& lhs, const BasicSortedVector& rhs) {
+        return !(lhs == rhs);
+    }
+
+protected:
+    bool Less(const Key& lhs, const Key& rhs) const {
+        return compare_(lhs, rhs);
+    }
+
+    size_t LowerBoundIndex(const Key& key) const {
+        if (HasSearchIndex()) {
+            return EytzingerLowerBound(key);
+        }
+        auto it = std::lower_bound(items_.begin(), items_.end(), key,
+                                   [this](const Type& item, const Key& value) { return Less(KeyOf()(item), value); });
+        return it - items_.begin();
+    }
+
+    template <typename Item>
+    std::pair<ConstIterator, bool> InsertAt(size_t index, Item&& item) {
+        if (index < items_.GetSize() && !Less(KeyOf()(item), KeyOf()(items_[index]))) {
+            return {items_.begin() + index, false};
+        }
+        DropSearchIndex();
+        return {items_.Insert(items_.begin() + index, std::forward<Item>(item)), true};
+    }
+
+    void DropSearchIndex() noexcept {
+        index_keys_.ClearAndRelease();
+        index_positions_.ClearAndRelease();
+    }
+
+    Vector items_;
+    Compare compare_;
+
+private:
+    // Lower bound found by probing 1, 2, 4, ... elements back from the end,
+    // then a binary search inside the last step
+    size_t GallopIndex(const Key& key) const {
+        size_t low = 0;
+        size_t high = items_.GetSize();
+        for (size_t step = 1; step <= high; step *= 2) {
+            size_t probe = high - step;
+            if (Less(KeyOf()(items_[probe]), key)) {
+                low = probe + 1;
+                break;
+            }
+            high = probe;
+        }
+        auto it = std::lower_bound(items_.begin() + low, items_.begin() + high, key,
+                                   [this](const Type& item, const Key& value) { return Less(KeyOf()(item), value); });
+        return it - items_.begin();
+    }
+
+    // In-order walk of the implicit tree rooted at node: node k has the
+    // children 2k and 2k + 1
+    size_t FillSearchIndex(SimpleVector<Key>& keys, SimpleVector<size_t>& positions, size_t sorted, size_t node) {
+        if (node < keys.GetSize()) {
+            sorted = FillSearchIndex(keys, positions, sorted, 2 * node);
+            keys[node] = KeyOf()(items_[sorted]);
+            positions[node] = sorted++;
+            sorted = FillSearchIndex(keys, positions, sorted, 2 * node + 1);
+        }
+        return sorted;
+    }
+
+    size_t EytzingerLowerBound(const Key& key) const {
+        const size_t nodes = index_keys_.GetSize();
+        size_t node = 1;
+        while (node < nodes) {
+#if defined(__GNUC__) || defined(__clang__)
+            // the 16 descendants four levels down share a few cache lines
+            if (16 * node < nodes) {
+                __builtin_prefetch(index_keys_.begin() + 16 * node);
+            }
+#endif
+            node = 2 * node + Less(index_keys_[node], key);
+        }
+        // climb back past the right turns to the last node that was not less
+        while (node & 1) {
+            node >>= 1;
+        }
+        return index_positions_[node >> 1];
+    }
+
+    SimpleVector<Key> index_keys_;
+    SimpleVector<size_t> index_positions_;
+};
+
+template <typename Type, typename Compare = std::less<Type>, typename Alloc = std::allocator<Type>>
+using SortedSimpleVector = BasicSortedVector<Type, IdentityKey, Compare, Alloc>;
+
+// Flat map over BasicSortedVector: the (key, value) pairs are stored sorted
+// by key in one buffer. The values may be changed in place through
+// operator[], At, FindValue and the mutable iterators; changing a key
+// through them breaks the ordering.
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename Alloc = std::allocator<std::pair<Key, Value>>>
+class FlatSimpleMap : public BasicSortedVector<std::pair<Key, Value>, PairFirstKey, Compare, Alloc> {
+    using Base = BasicSortedVector<std::pair<Key, Value>, PairFirstKey, Compare, Alloc>;
+
+public:
+    using ValueType = std::pair<Key, Value>;
+    using Iterator = ValueType*;
+    using typename Base::ConstIterator;
+
+    using Base::Base;
+    using Base::begin;
+    using Base::end;
+
+    // The value for key, default-constructed and inserted if missing
+    Value& operator[](const Key& key) {
+        ConstIterator it = this->LowerBound(key);
+        if (it == this->cend() || this->Less(key, it->first)) {
+            it = this->InsertAt(it - this->cbegin(), ValueType(key, Value())).first;
+        }
+        return Mutable(it)->second;
+    }
+
+    Value& At(const Key& key) {
+        return const_cast<Value&>(static_cast<const FlatSimpleMap&>(*this).At(key));
+    }
+
+    const Value& At(const Key& key) const {
+        ConstIterator it = this->Find(key);
+        if (it == end()) {
+            throw std::out_of_range("Key not found");
+        }
+        return it->second;
+    }
+
+    // nullptr when key is missing
+    Value* FindValue(const Key& key) {
+        ConstIterator it = this->Find(key);
+        return it == end() ? nullptr : &Mutable(it)->second;
+    }
+
+    const Value* FindValue(const Key& key) const {
+        ConstIterator it = this->Find(key);
+        return it == end() ? nullptr : &it->second;
+    }
+
+    // Inserts or overwrites the value for key
+    template <typename V>
+    Iterator InsertOrAssign(const Key& key, V&& value) {
+        ConstIterator it = this->LowerBound(key);
+        if (it != this->cend() && !this->Less(key, it->first)) {
+            Mutable(it)->second = std::forward<V>(value);
+            return Mutable(it);
+        }
+        return Mutable(this->InsertAt(it - this->cbegin(), ValueType(key, std::forward<V>(value))).first);
+    }
+
+    Iterator begin() noexcept {
+        return this->items_.begin();
+    }
+
+    Iterator end() noexcept {
+        return this->items_.end();
+    }
+
+private:
+    Iterator Mutable(ConstIterator it) noexcept {
+        return this->items_.begin() + (it - this->items_.cbegin());
+    }
+};
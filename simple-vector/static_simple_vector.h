@@ -0,0 +1,418 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "simple_vector_view.h"
+
+// Storage for StaticSimpleVector. Trivial element types live in a plain
+// array that is zero-initialized up front, which is what lets the whole
+// vector be used in constant expressions under C++17; other types get raw
+// aligned bytes and placement new.
+template <typename Type, size_t N,
+          bool = std::is_trivially_copyable_v<Type> && std::is_trivially_default_constructible_v<Type>>
+class StaticStorage {
+public:
+    constexpr Type* Get() noexcept {
+        return items_;
+    }
+
+    constexpr const Type* Get() const noexcept {
+        return items_;
+    }
+
+    template <typename... Args>
+    constexpr void Construct(size_t index, Args&&... args) {
+        items_[index] = Type(std::forward<Args>(args)...);
+    }
+
+    constexpr void Destroy(size_t, size_t) noexcept {}
+
+    constexpr size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    constexpr void SetSize(size_t size) noexcept {
+        size_ = size;
+    }
+
+private:
+    Type items_[N]{};
+    size_t size_ = 0;
+};
+
+template <typename Type, size_t N>
+class StaticStorage<Type, N, false> {
+public:
+    StaticStorage() noexcept = default;
+
+    StaticStorage(const StaticStorage& other) {
+        ConstructFrom(other.Get(), other.size_, [](const Type& item) -> const Type& { return item; });
+    }
+
+    StaticStorage(StaticStorage&& other) noexcept(std::is_nothrow_move_constructible_v<Type>) {
+        ConstructFrom(other.Get(), other.size_, [](Type& item) -> Type&& { return std::move(item); });
+    }
+
+    StaticStorage& operator=(const StaticStorage& rhs) {
+        if (this != &rhs) {
+            Assign(rhs.Get(), rhs.size_, [](const Type& item) -> const Type& { return item; });
+        }
+        return *this;
+    }
+
+    StaticStorage& operator=(StaticStorage&& rhs) noexcept(std::is_nothrow_move_constructible_v<Type> &&
+                                                          std::is_nothrow_move_assignable_v<Type>) {
+        if (this != &rhs) {
+            Assign(rhs.Get(), rhs.size_, [](Type& item) -> Type&& { return std::move(item); });
+        }
+        return *this;
+    }
+
+    ~StaticStorage() {
+        Destroy(0, size_);
+    }
+
+    Type* Get() noexcept {
+        return std::launder(reinterpret_cast<Type*>(raw_));
+    }
+
+    const Type* Get() const noexcept {
+        return std::launder(reinterpret_cast<const Type*>(raw_));
+    }
+
+    template <typename... Args>
+    void Construct(size_t index, Args&&... args) {
+        ::new (static_cast<void*>(raw_ + index * sizeof(Type))) Type(std::forward<Args>(args)...);
+    }
+
+    void Destroy(size_t first, size_t last) noexcept {
+        for (; first != last; ++first) {
+            Get()[first].~Type();
+        }
+    }
+
+    size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    void SetSize(size_t size) noexcept {
+        size_ = size;
+    }
+
+private:
+    // Builds the first count elements in empty storage. The destructor does
+    // not run for a constructor that throws, so a failure destroys the
+    // elements built so far.
+    template <typename Source, typename Forward>
+    void ConstructFrom(Source* source, size_t count, Forward forward) {
+        try {
+            for (; size_ < count; ++size_) {
+                Construct(size_, forward(source[size_]));
+            }
+        } catch (...) {
+            Destroy(0, size_);
+            size_ = 0;
+            throw;
+        }
+    }
+
+    template <typename Source, typename Forward>
+    void Assign(Source* source, size_t count, Forward forward) {
+        size_t common = std::min(size_, count);
+        for (size_t i = 0; i < common; ++i) {
+            Get()[i] = forward(source[i]);
+        }
+        if (count < size_) {
+            Destroy(count, size_);
+            size_ = count;
+        }
+        for (; size_ < count; ++size_) {
+            Construct(size_, forward(source[size_]));
+        }
+    }
+
+    alignas(Type) unsigned char raw_[N * sizeof(Type)];
+    size_t size_ = 0;
+};
+
+// SimpleVector with a fixed capacity of N elements stored inside the object:
+// it never allocates. Going over the capacity throws std::length_error, which
+// in a constant expression is a compile error.
+//
+// For trivially copyable, trivially default constructible element types
+// every member is constexpr, so tables can be built at compile time:
+//     constexpr auto kTable = [] {
+//         StaticSimpleVector<int, 16> table;
+//         for (int i = 0; i < 16; ++i) table.PushBack(i * i);
+//         return table;
+//     }();
+// The price is that such a vector zeroes its N slots on construction. Other
+// element types work at run time only. A throwing element constructor
+// leaves the elements built before it in place.
+template <typename Type, size_t N>
+class StaticSimpleVector {
+    static_assert(N > 0, "capacity must be positive");
+
+public:
+    using Iterator = Type*;
+    using ConstIterator = const Type*;
+
+    static constexpr size_t kCapacity = N;
+
+    constexpr StaticSimpleVector() noexcept = default;
+
+    constexpr explicit StaticSimpleVector(size_t size) {
+        Resize(size);
+    }
+
+    constexpr StaticSimpleVector(size_t size, const Type& value) {
+        CheckCapacity(size);
+        while (GetSize() < size) {
+            EmplaceBack(value);
+        }
+    }
+
+    constexpr StaticSimpleVector(std::initializer_list<Type> init) {
+        CheckCapacity(init.size());
+        for (const Type& item : init) {
+            EmplaceBack(item);
+        }
+    }
+
+    constexpr size_t GetSize() const noexcept {
+        return storage_.GetSize();
+    }
+
+    static constexpr size_t GetCapacity() noexcept {
+        return N;
+    }
+
+    constexpr bool IsEmpty() const noexcept {
+        return GetSize() == 0;
+    }
+
+    constexpr bool IsFull() const noexcept {
+        return GetSize() == N;
+    }
+
+    constexpr Type* Data() noexcept {
+        return storage_.Get();
+    }
+
+    constexpr const Type* Data() const noexcept {
+        return storage_.Get();
+    }
+
+    constexpr Type& operator[](size_t index) noexcept {
+        assert(index < GetSize());
+        return Data()[index];
+    }
+
+    constexpr const Type& operator[](size_t index) const noexcept {
+        assert(index < GetSize());
+        return Data()[index];
+    }
+
+    constexpr Type& At(size_t index) {
+        if (index >= GetSize()) {
+            throw std::out_of_range("Index out of range");
+        }
+        return Data()[index];
+    }
+
+    constexpr const Type& At(size_t index) const {
+        if (index >= GetSize()) {
+            throw std::out_of_range("Index out of range");
+        }
+        return Data()[index];
+    }
+
+    constexpr void Clear() noexcept {
+        DestroyTail(0);
+    }
+
+    // New elements are value-initialized
+    constexpr void Resize(size_t new_size) {
+        CheckCapacity(new_size);
+        DestroyTail(std::min(new_size, GetSize()));
+        while (GetSize() < new_size) {
+            EmplaceBack();
+        }
+    }
+
+    constexpr void PushBack(const Type& item) {
+        EmplaceBack(item);
+    }
+
+    constexpr void PushBack(Type&& item) {
+        EmplaceBack(std::move(item));
+    }
+
+    template <typename... Args>
+    constexpr Type& EmplaceBack(Args&&... args) {
+        CheckCapacity(GetSize() + 1);
+        const size_t index = GetSize();
+        storage_.Construct(index, std::forward<Args>(args)...);
+        storage_.SetSize(index + 1);
+        return Data()[index];
+    }
+
+    // value may be an element of this vector
+    constexpr Iterator Insert(ConstIterator pos, const Type& value) {
+        const size_t offset = pos - cbegin();
+        CheckCapacity(GetSize() + 1);
+        Type copy(value);
+        return InsertMoved(offset, std::move(copy));
+    }
+
+    constexpr Iterator Insert(ConstIterator pos, Type&& value) {
+        const size_t offset = pos - cbegin();
+        CheckCapacity(GetSize() + 1);
+        return InsertMoved(offset, std::move(value));
+    }
+
+    constexpr void PopBack() noexcept {
+        assert(!IsEmpty());
+        DestroyTail(GetSize() - 1);
+    }
+
+    constexpr Iterator Erase(ConstIterator pos) {
+        return Erase(pos, pos + 1);
+    }
+
+    // Removes [first, last) with a single shift of the tail
+    constexpr Iterator Erase(ConstIterator first, ConstIterator last) {
+        const size_t offset = first - cbegin();
+        const size_t count = last - first;
+        if (count > 0) {
+            Type* data = Data();
+            for (size_t i = offset; i + count < GetSize(); ++i) {
+                data[i] = std::move(data[i + count]);
+            }
+            DestroyTail(GetSize() - count);
+        }
+        return begin() + offset;
+    }
+
+    constexpr void swap(StaticSimpleVector& other) noexcept(std::is_nothrow_move_constructible_v<Type> &&
+                                                           std::is_nothrow_move_assignable_v<Type>) {
+        StaticSimpleVector temp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temp);
+    }
+
+    SimpleVectorView<Type> View() noexcept {
+        return SimpleVectorView<Type>(Data(), GetSize());
+    }
+
+    SimpleVectorView<const Type> View() const noexcept {
+        return SimpleVectorView<const Type>(Data(), GetSize());
+    }
+
+    constexpr Iterator begin() noexcept {
+        return Data();
+    }
+
+    constexpr Iterator end() noexcept {
+        return Data() + GetSize();
+    }
+
+    constexpr ConstIterator begin() const noexcept {
+        return Data();
+    }
+
+    constexpr ConstIterator end() const noexcept {
+        return Data() + GetSize();
+    }
+
+    constexpr ConstIterator cbegin() const noexcept {
+        return begin();
+    }
+
+    constexpr ConstIterator cend() const noexcept {
+        return end();
+    }
+
+private:
+    static constexpr void CheckCapacity(size_t size) {
+        if (size > N) {
+            throw std::length_error("StaticSimpleVector: capacity exceeded");
+        }
+    }
+
+    constexpr Iterator InsertMoved(size_t offset, Type&& value) {
+        const size_t size = GetSize();
+        if (offset == size) {
+            EmplaceBack(std::move(value));
+            return begin() + offset;
+        }
+        Type* data = Data();
+        storage_.Construct(size, std::move(data[size - 1]));
+        storage_.SetSize(size + 1);
+        for (size_t i = size - 1; i > offset; --i) {
+            data[i] = std::move(data[i - 1]);
+        }
+        data[offset] = std::move(value);
+        return begin() + offset;
+    }
+
+    constexpr void DestroyTail(size_t new_size) noexcept {
+        storage_.Destroy(new_size, GetSize());
+        storage_.SetSize(new_size);
+    }
+
+    StaticStorage<Type, N> storage_;
+};
+
+// Comparisons are plain loops so that they stay usable in constant expressions
+template <typename Type, size_t N>
+constexpr bool operator==(const StaticSimpleVector<Type, N>& lhs, const StaticSimpleVector<Type, N>& rhs) {
+    if (lhs.GetSize() != rhs.GetSize()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.GetSize(); ++i) {
+        if (!(lhs[i] == rhs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Type, size_t N>
+constexpr bool operator!=(const StaticSimpleVector<Type, N>& lhs, const StaticSimpleVector<Type, N>& rhs) {
+    return !(lhs == rhs);
+}
+
+template <typename Type, size_t N>
+constexpr bool operator<(const StaticSimpleVector<Type, N>& lhs, const StaticSimpleVector<Type, N>& rhs) {
+    for (size_t i = 0; i < lhs.GetSize() && i < rhs.GetSize(); ++i) {
+        if (lhs[i] < rhs[i]) {
+            return true;
+        }
+        if (rhs[i] < lhs[i]) {
+            return false;
+        }
+    }
+    return lhs.GetSize() < rhs.GetSize();
+}
+
+template <typename Type, size_t N>
+constexpr bool operator<=(const StaticSimpleVector<Type, N>& lhs, const StaticSimpleVector<Type, N>& rhs) {
+    return !(rhs < lhs);
+}
+
+template <typename Type, size_t N>
+constexpr bool operator>(const StaticSimpleVector<Type, N>& lhs, const StaticSimpleVector<Type, N>& rhs) {
+    return rhs < lhs;
+}
+
+template <typename Type, size_t N>
+constexpr bool operator>=(const StaticSimpleVector<Type, N>& lhs, const StaticSimpleVector<Type, N>& rhs) {
+    return !(lhs < rhs);
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include "simple_vector.h"
+#include "simple_vector_view.h"
+
+// Opt-in element-wise arithmetic on SimpleVector of arithmetic types:
+//     using namespace vector_expression;
+//     a = b * c + d;
+//     SimpleVector<double> e = 2.0 * (a - b) / c;
+//     a += b * c;
+// The operators only build small expression objects that refer to their
+// operands. Assigning one to a SimpleVector sizes the destination once and
+// evaluates every element in a single loop the compiler can vectorize, with
+// no temporary vectors. Operands are SimpleVectors, SimpleVectorViews,
+// other expressions and scalars; vector operands must all have the same
+// size, or std::length_error is thrown.
+//
+// An expression holds pointers into its operands, so it must be evaluated
+// before they change or go away: don't keep one in an auto variable past
+// the statement it was built in.
+namespace vector_expression {
+
+// Base of all expression types: Derived provides GetSize() and operator[]
+template <typename Derived>
+class Expression {
+public:
+    // Marks the type for SimpleVector's expression constructor and assignment
+    using IsVectorExpression = void;
+
+    // Writes the GetSize() elements to out, which may be an operand's storage.
+    // Works on a local copy of the expression, so that the compiler can keep
+    // the operand pointers in registers and vectorize the loop.
+    template <typename Type>
+    void EvaluateInto(Type* out) const {
+        const Derived self = static_cast<const Derived&>(*this);
+        const size_t size = self.GetSize();
+#if defined(__GNUC__) && !defined(__clang__)
+        // out can only alias an operand at the same index (or read ahead of
+        // it, for a view into the destination), which carries no dependency
+        // between iterations
+#pragma GCC ivdep
+#endif
+        for (size_t i = 0; i < size; ++i) {
+            out[i] = static_cast<Type>(self[i]);
+        }
+    }
+};
+
+// The elements of a SimpleVector or SimpleVectorView
+template <typename Type>
+class Terminal : public Expression<Terminal<Type>> {
+public:
+    Terminal(const Type* data, size_t size) noexcept
+        : data_(data), size_(size) {}
+
+    size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    Type operator[](size_t index) const noexcept {
+        return data_[index];
+    }
+
+private:
+    const Type* data_;
+    size_t size_;
+};
+
+// A scalar operand, the same for every element
+template <typename Type>
+class Scalar {
+public:
+    explicit Scalar(Type value) noexcept
+        : value_(value) {}
+
+    Type operator[](size_t) const noexcept {
+        return value_;
+    }
+
+private:
+    Type value_;
+};
+
+template <typename Type>
+struct IsScalar : std::false_type {};
+
+template <typename Type>
+struct IsScalar<Scalar<Type>> : std::true_type {};
+
+template <typename Op, typename Arg>
+class Unary : public Expression<Unary<Op, Arg>> {
+public:
+    explicit Unary(const Arg& arg) noexcept
+        : arg_(arg) {}
+
+    size_t GetSize() const noexcept {
+        return arg_.GetSize();
+    }
+
+    auto operator[](size_t index) const {
+        return Op{}(arg_[index]);
+    }
+
+private:
+    Arg arg_;
+};
+
+template <typename Op, typename Lhs, typename Rhs>
+class Binary : public Expression<Binary<Op, Lhs, Rhs>> {
+public:
+    Binary(const Lhs& lhs, const Rhs& rhs)
+        : lhs_(lhs), rhs_(rhs), size_(SizeOf(lhs, rhs)) {}
+
+    size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    auto operator[](size_t index) const {
+        return Op{}(lhs_[index], rhs_[index]);
+    }
+
+private:
+    static size_t SizeOf(const Lhs& lhs, const Rhs& rhs) {
+        if constexpr (IsScalar<Lhs>::value) {
+            return rhs.GetSize();
+        } else if constexpr (IsScalar<Rhs>::value) {
+            return lhs.GetSize();
+        } else {
+            if (lhs.GetSize() != rhs.GetSize()) {
+                throw std::length_error("vector expression: operand sizes differ");
+            }
+            return lhs.GetSize();
+        }
+    }
+
+    Lhs lhs_;
+    Rhs rhs_;
+    size_t size_;
+};
+
+// How each kind of operand is held inside an expression; only arithmetic
+// element types take part
+template <typename Type, typename = void>
+struct Operand {};
+
+template <typename Type>
+struct Operand<Type, std::enable_if_t<std::is_arithmetic_v<Type>>> {
+    using Held = Scalar<Type>;
+    static constexpr bool kIsVector = false;
+
+    static Held Hold(Type value) noexcept {
+        return Held(value);
+    }
+};
+
+template <typename Type, typename Alloc, typename Growth>
+struct Operand<SimpleVector<Type, Alloc, Growth>, std::enable_if_t<std::is_arithmetic_v<Type>>> {
+    using Held = Terminal<Type>;
+    static constexpr bool kIsVector = true;
+
+    static Held Hold(const SimpleVector<Type, Alloc, Growth>& vector) noexcept {
+        return Held(vector.Data(), vector.GetSize());
+    }
+};
+
+template <typename Type>
+struct Operand<SimpleVectorView<Type>, std::enable_if_t<std::is_arithmetic_v<std::remove_const_t<Type>>>> {
+    using Held = Terminal<std::remove_const_t<Type>>;
+    static constexpr bool kIsVector = true;
+
+    static Held Hold(const SimpleVectorView<Type>& view) noexcept {
+        return Held(view.Data(), view.GetSize());
+    }
+};
+
+template <typename Type>
+struct Operand<Type, std::enable_if_t<std::is_base_of_v<Expression<Type>, Type>>> {
+    using Held = Type;
+    static constexpr bool kIsVector = true;
+
+    static const Held& Hold(const Type& expr) noexcept {
+        return expr;
+    }
+};
+
+template <typename Type, typename = void>
+struct IsOperand : std::false_type {};
+
+template <typename Type>
+struct IsOperand<Type, std::void_t<typename Operand<Type>::Held>> : std::true_type {};
+
+template <typename Type>
+using Held = typename Operand<std::decay_t<Type>>::Held;
+
+// A binary operator applies when both sides are operands and at least one
+// of them is a vector or an expression
+template <typename Lhs, typename Rhs>
+constexpr bool kAppliesTo = IsOperand<std::decay_t<Lhs>>::value && IsOperand<std::decay_t<Rhs>>::value &&
+                            (Operand<std::decay_t<Lhs>>::kIsVector || Operand<std::decay_t<Rhs>>::kIsVector);
+
+template <typename Op, typename Lhs, typename Rhs>
+Binary<Op, Held<Lhs>, Held<Rhs>> MakeBinary(const Lhs& lhs, const Rhs& rhs) {
+    return Binary<Op, Held<Lhs>, Held<Rhs>>(Operand<Lhs>::Hold(lhs), Operand<Rhs>::Hold(rhs));
+}
+
+template <typename Lhs, typename Rhs, typename = std::enable_if_t<kAppliesTo<Lhs, Rhs>>>
+auto operator+(const Lhs& lhs, const Rhs& rhs) {
+    return MakeBinary<std::plus<>>(lhs, rhs);
+}
+
+template <typename Lhs, typename Rhs, typename = std::enable_if_t<kAppliesTo<Lhs, Rhs>>>
+auto operator-(const Lhs& lhs, const Rhs& rhs) {
+    return MakeBinary<std::minus<>>(lhs, rhs);
+}
+
+template <typename Lhs, typename Rhs, typename = std::enable_if_t<kAppliesTo<Lhs, Rhs>>>
+auto operator*(const Lhs& lhs, const Rhs& rhs) {
+    return MakeBinary<std::multiplies<>>(lhs, rhs);
+}
+
+template <typename Lhs, typename Rhs, typename = std::enable_if_t<kAppliesTo<Lhs, Rhs>>>
+auto operator/(const Lhs& lhs, const Rhs& rhs) {
+    return MakeBinary<std::divides<>>(lhs, rhs);
+}
+
+template <typename Arg, typename = std::enable_if_t<kAppliesTo<Arg, Arg>>>
+auto operator-(const Arg& arg) {
+    return Unary<std::negate<>, Held<Arg>>(Operand<Arg>::Hold(arg));
+}
+
+// Compound assignment evaluates in place, in the same single pass
+template <typename Type, typename Alloc, typename Growth, typename Rhs,
+          typename = std::enable_if_t<kAppliesTo<SimpleVector<Type, Alloc, Growth>, Rhs>>>
+SimpleVector<Type, Alloc, Growth>& operator+=(SimpleVector<Type, Alloc, Growth>& lhs, const Rhs& rhs) {
+    return lhs = lhs + rhs;
+}
+
+template <typename Type, typename Alloc, typename Growth, typename Rhs,
+          typename = std::enable_if_t<kAppliesTo<SimpleVector<Type, Alloc, Growth>, Rhs>>>
+SimpleVector<Type, Alloc, Growth>& operator-=(SimpleVector<Type, Alloc, Growth>& lhs, const Rhs& rhs) {
+    return lhs = lhs - rhs;
+}
+
+template <typename Type, typename Alloc, typename Growth, typename Rhs,
+          typename = std::enable_if_t<kAppliesTo<SimpleVector<Type, Alloc, Growth>, Rhs>>>
+SimpleVector<Type, Alloc, Growth>& operator*=(SimpleVector<Type, Alloc, Growth>& lhs, const Rhs& rhs) {
+    return lhs = lhs * rhs;
+}
+
+template <typename Type, typename Alloc, typename Growth, typename Rhs,
+          typename = std::enable_if_t<kAppliesTo<SimpleVector<Type, Alloc, Growth>, Rhs>>>
+SimpleVector<Type, Alloc, Growth>& operator/=(SimpleVector<Type, Alloc, Growth>& lhs, const Rhs& rhs) {
+    return lhs = lhs / rhs;
+}
+
+// Evaluates an expression into a new vector of its element type
+template <typename Derived>
+auto Evaluate(const Expression<Derived>& expr) {
+    const Derived& self = static_cast<const Derived&>(expr);
+    using Type = std::decay_t<decltype(self[0])>;
+    return SimpleVector<Type>(self);
+}
+
+}  // namespace vector_expression